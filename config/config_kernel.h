@@ -40,6 +40,7 @@
 /* Be careful here */
 #define KMALLOC_MAX_ALIGN                   (64 * KB)
 #define KMALLOC_MIN_HEAP_SIZE       KMALLOC_MAX_ALIGN
+#define KMALLOC_GROW_MIN_SIZE                (1 * MB)
 
 #define PROCESS_CMDLINE_BUF_SIZE                  256
 #define MAX_MOUNTPOINTS                            16
@@ -49,3 +50,4 @@
 #define WTH_MAX_PRIO_QUEUE_SIZE                    32
 #define WTH_KB_QUEUE_SIZE                          32
 #define WTH_SERIAL_QUEUE_SIZE                      32
+#define WTH_MM_REAPER_QUEUE_SIZE                   32
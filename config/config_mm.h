@@ -16,6 +16,8 @@
 
 #cmakedefine01 FORK_NO_COW
 #cmakedefine01 MMAP_NO_COW
+#cmakedefine01 BRK_NO_COW
+#cmakedefine01 MMAP_NO_HUGE_PAGES
 
 
 /*
@@ -37,6 +39,7 @@
 #define HI_VMEM_SIZE             (128ul * MB)
 
 #define USER_VDSO_VADDR       (HI_VMEM_START)
+#define USER_VDSO_DATA_VADDR  (USER_VDSO_VADDR + 4096)
 
 #define USERMODE_VADDR_END          (BASE_VA) /* biggest user vaddr + 1 */
 #define MAX_BRK                  (0x40000000) /* +1 GB (virtual memory) */
@@ -44,6 +47,25 @@
 #define USER_MMAP_MIN_SZ            (16 * MB)
 #define USER_MMAP_MAX_SZ          (1024 * MB)
 #define USERMODE_STACK_ALIGN              16u
+#define USER_STACK_GUARD_GAP        (64 * KB) /* min gap below the stack */
 
 #define USERMODE_STACK_MAX \
    ((USERMODE_VADDR_END - 1) & ALIGNED_MASK(USERMODE_STACK_ALIGN))
+
+/*
+ * Deferred teardown of the address spaces (see mm_reaper.c): the ones owning
+ * at least MM_REAPER_MIN_PTS page tables are destroyed by a worker thread, as
+ * long as the pending ones hold no more than MM_REAPER_MAX_PENDING_MEM bytes
+ * and there are at least MM_REAPER_MIN_FREE_MEM bytes of free memory.
+ */
+#define MM_REAPER_MIN_PTS                      8
+#define MM_REAPER_MAX_PENDING_MEM       (32 * MB)
+#define MM_REAPER_MIN_FREE_MEM          (16 * MB)
+#define MM_REAPER_BATCH_PTS                    4
+
+/*
+ * The first write in a 4-MB aligned region of a big anonymous mapping gets a
+ * whole 4-MB page, instead of a regular one, only when there are at least
+ * USER_HUGE_PAGE_MIN_FREE_MEM bytes of free memory.
+ */
+#define USER_HUGE_PAGE_MIN_FREE_MEM     (32 * MB)
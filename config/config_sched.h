@@ -12,6 +12,8 @@
 
 /* --------- Boolean config variables --------- */
 #cmakedefine01 KRN_RESCHED_ENABLE_PREEMPT
+#cmakedefine01 KRN_TICKLESS_IDLE
+#cmakedefine01 KRN_HIGH_RES_TIMERS
 
 /*
  * --------------------------------------------------------------------------
@@ -22,6 +22,11 @@
 
 #define EFLAGS_IOPL     0x3000
 
+#define X86_LAPIC_TIMER_INT             0xf0   /* local APIC timer vector */
+#define X86_LAPIC_SPUR_INT              0xff   /* local APIC spurious vector */
+
+#define MSR_IA32_APIC_BASE              0x01b
+
 #define MSR_IA32_SYSENTER_CS            0x174
 #define MSR_IA32_SYSENTER_ESP           0x175
 #define MSR_IA32_SYSENTER_EIP           0x176
@@ -184,6 +184,16 @@ static ALWAYS_INLINE void halt(void)
    asmVolatile("hlt");
 }
 
+/*
+ * Enable the interrupts and halt, atomically: STI delays the recognition of
+ * the interrupts until the end of the next instruction, HLT in this case.
+ */
+static ALWAYS_INLINE void enable_interrupts_and_halt(void)
+{
+   asmVolatile("sti\n\t"
+               "hlt");
+}
+
 static ALWAYS_INLINE void wrmsr(u32 msr_id, u64 msr_value)
 {
    asmVolatile( "wrmsr" : : "c" (msr_id), "A" (msr_value) );
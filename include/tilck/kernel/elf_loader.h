@@ -14,6 +14,7 @@ struct elf_program_info {
    pdir_t *pdir;           // The pdir used for the program
    void *entry;            // The address of program's entry point
    void *stack;            // The initial value of the stack pointer
+   void *stack_bottom;     // The lowest mapped vaddr of the stack
    void *brk;              // The first invalid vaddr (program break)
    struct locked_file *lf; // ELF's file lock (can be NULL)
    bool wrong_arch;        // The ELF is compiled for the wrong arch
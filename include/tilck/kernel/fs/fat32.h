@@ -9,6 +9,8 @@
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs_base.h>
 
+struct fat_clu_index;
+
 struct fat_fs_device_data {
 
    struct fat_hdr *hdr; /* vaddr of the beginning of the FAT partition */
@@ -28,6 +30,9 @@ struct fat_fs_device_data {
     * regular fat_entry.
     */
    struct fat_entry *root_dir_entries;
+
+   /* Lazily-built cluster indexes of the files, by first cluster */
+   struct fat_clu_index *clu_indexes;
 };
 
 struct fatfs_handle {
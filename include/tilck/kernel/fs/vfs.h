@@ -94,11 +94,32 @@ typedef int            (*func_on_dup_cb)    (fs_handle);
 
 typedef ssize_t        (*func_readv)        (fs_handle,
                                              const struct iovec *,
-                                             int);
+                                             int,
+                                             offt *);
 
 typedef ssize_t        (*func_writev)       (fs_handle,
                                              const struct iovec *,
-                                             int);
+                                             int,
+                                             offt *);
+
+/*
+ * A chunk of a file's data, lent in place by the file system's splice_read()
+ * func to vfs_splice(), which gives it back with splice_release().
+ */
+struct vfs_splice_buf {
+
+   void *data;       /* kernel pointer to the data */
+   size_t len;       /* size of the data, in bytes */
+   void *ref;        /* FS-specific reference, kept until splice_release() */
+};
+
+typedef int            (*func_splice_read)  (fs_handle,
+                                             offt,
+                                             size_t,
+                                             struct vfs_splice_buf *);
+
+typedef void           (*func_splice_rel)   (fs_handle,
+                                             struct vfs_splice_buf *);
 
 typedef int            (*func_fsync)        (fs_handle);
 typedef void           (*func_syncfs)       (struct mnt_fs *);
@@ -165,8 +186,41 @@ struct file_ops {
    func_fsync sync;                    /* if NULL -> -EROFS or 0 */
    func_fsync datasync;                /* if NULL -> -EROFS or 0 */
 
-   func_readv readv;                   /* if NULL, emulated in non-atomic way */
-   func_writev writev;                 /* if NULL, emulated in non-atomic way */
+   /*
+    * Optional, scatter/gather funcs: the iovec array is in kernel memory, while
+    * the buffers it points to are in the user space. Like read() and write(),
+    * they use and move `pos`, which is not necessarily the file position.
+    * When NULL, they're emulated in a non-atomic way with one read or write
+    * call per segment.
+    */
+   func_readv readv;
+   func_writev writev;
+
+   /*
+    * Optional, read/write funcs taking an user buffer.
+    *
+    * They copy the data straight from/to the user buffer with the fault
+    * resumable helpers (copy_to_user() etc.), returning the number of bytes
+    * transferred before a fault, or -EFAULT if nothing was. When they're NULL,
+    * the VFS stages the data through the per-task `io_copybuf` instead, one
+    * chunk of at most IO_COPYBUF_SIZE bytes per call.
+    */
+   func_read read_user;
+   func_write write_user;
+
+   /*
+    * Optional, splice funcs used by sendfile() and splice().
+    *
+    * splice_read() lends the data at the given offset, up to the given length,
+    * without copying it: the data is expected to stay valid until the matching
+    * splice_release() call, which is optional. It returns the number of bytes
+    * lent, which can be less than requested, or 0 at EOF. It does NOT move the
+    * file position: the VFS does that with seek(), which must be supported.
+    * When splice_read() is NULL, the VFS reads the data into the per-task
+    * `io_copybuf` instead.
+    */
+   func_splice_read splice_read;
+   func_splice_rel splice_release;
 
    func_handle_fault handle_fault;     /* if NULL -> false     */
 
@@ -222,9 +276,26 @@ ssize_t vfs_read(fs_handle h, void *buf, size_t buf_size);
 ssize_t vfs_write(fs_handle h, void *buf, size_t buf_size);
 ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt);
 ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt);
+
+ssize_t
+vfs_preadv(fs_handle h, const struct iovec *iov, int iovcnt, offt off);
+
+ssize_t
+vfs_pwritev(fs_handle h, const struct iovec *iov, int iovcnt, offt off);
 ssize_t vfs_pread(fs_handle h, void *buf, size_t buf_size, offt off);
 ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off);
 
+ssize_t vfs_read_user(fs_handle h, void *u_buf, size_t len);
+ssize_t vfs_write_user(fs_handle h, const void *u_buf, size_t len);
+ssize_t vfs_pread_user(fs_handle h, void *u_buf, size_t len, offt off);
+ssize_t vfs_pwrite_user(fs_handle h, const void *u_buf, size_t len, offt off);
+
+ssize_t vfs_splice(fs_handle in,
+                   offt *in_pos,
+                   fs_handle out,
+                   offt *out_pos,
+                   size_t len);
+
 int vfs_exlock_noblock(struct mnt_fs *fs, vfs_inode_ptr_t i);
 int vfs_exunlock(struct mnt_fs *fs, vfs_inode_ptr_t i);
 
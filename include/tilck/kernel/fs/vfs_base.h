@@ -70,6 +70,7 @@ struct vfs_path {
 
 #define VFS_FS_RW             (1 << 0)  /* struct mnt_fs mounted in RW mode */
 #define VFS_FS_RQ_DE_SKIP     (1 << 1)  /* FS requires vfs dents skip */
+#define VFS_FS_DCACHE         (1 << 2)  /* FS entries can be cached by VFS */
 
 /* This struct is Tilck's analogue of Linux's "superblock" */
 struct mnt_fs {
@@ -131,9 +132,16 @@ struct fs_handle_base {
  * VFS_MM_DONT_MMAP flag play a role. At the same way, in other exceptional
  * situations we might not want the FS to register the mapping, but to do it
  * anyway.
+ *
+ * Finally, VFS_MM_PREFAULT asks the FS to map only the pages of an already
+ * existing mapping (here, a part of it) which are not mapped yet, skipping the
+ * others. That's used by madvise(MADV_WILLNEED), together with
+ * VFS_MM_DONT_REGISTER. File-systems mapping everything in mmap() have nothing
+ * to do in that case.
  */
 #define VFS_MM_DONT_MMAP            (1 << 0)
 #define VFS_MM_DONT_REGISTER        (1 << 1)
+#define VFS_MM_PREFAULT             (1 << 2)
 
 int vfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags);
 int vfs_munmap(struct user_mapping *um, void *vaddr, size_t len);
@@ -171,6 +171,13 @@ void on_first_pdir_update(void);
 extern void (*hw_read_clock)(struct datetime *out);
 void hw_read_clock_cmos(struct datetime *out);
 u32 hw_timer_setup(u32 hz);
+u32 hw_timer_oneshot(u32 ticks);
+u32 hw_timer_oneshot_stop(bool *expired);
+u32 hw_timer_tick_elapsed_ns(void);
+bool hw_timer_hr_irq(void);
+bool hw_hrtimer_setup(void);
+void hw_hrtimer_arm(u32 ns);
+void hw_tsc_clocksource_init(u64 tsc_per_tick);
 
 bool allocate_fpu_regs(arch_task_members_t *arch_fields);
 void copy_main_tss_on_regs(regs_t *ctx);
@@ -82,6 +82,9 @@ per_heap_kmalloc(struct kmalloc_heap *h, size_t *size, u32 flags);
 void
 per_heap_kfree(struct kmalloc_heap *h, void *ptr, size_t *size, u32 flags);
 
+void *
+per_heap_kmalloc_at(struct kmalloc_heap *h, void *ptr, size_t size, u32 flags);
+
 struct kmalloc_acc {
 
    u32 elem_size;
@@ -99,6 +102,61 @@ kmalloc_accelerator_get_elem(struct kmalloc_acc *a);
 void
 kmalloc_destroy_accelerator(struct kmalloc_acc *a);
 
+/*
+ * Object caches: per-type caches of fixed-size objects, layered on top of a
+ * kmalloc accelerator. Freed objects are kept in a free list (up to a limit)
+ * and reused, avoiding the whole general_kmalloc() path for the hot objects.
+ * The optional constructor is called on every allocated object.
+ */
+
+typedef void (*kmem_cache_ctor)(void *obj);
+
+struct kmem_cache {
+
+   const char *name;
+   size_t size;                  /* size of the objects, as requested */
+   kmem_cache_ctor ctor;         /* optional */
+
+   /* Internal fields, initialized on the first allocation */
+   struct kmalloc_acc acc;
+   struct kmem_cache *next;      /* next cache, in the list of all caches */
+   void *free_list;
+   u32 free_count;
+   u32 max_free;
+
+   /* Stats */
+   u32 in_use;
+   u32 peak_in_use;
+   u32 allocs;
+   u32 refills;                  /* objects taken from the accelerator */
+};
+
+#define KMEM_CACHE_INIT(_name, _size, _ctor)                              \
+   {                                                                      \
+      .name = _name,                                                      \
+      .size = _size,                                                      \
+      .ctor = _ctor,                                                      \
+   }
+
+#define DEF_KMEM_CACHE(_var, _type, _ctor)                                \
+   static struct kmem_cache _var =                                        \
+      KMEM_CACHE_INIT(#_type, sizeof(_type), _ctor)
+
+void *
+kmem_cache_alloc(struct kmem_cache *c);
+
+void *
+kmem_cache_zalloc(struct kmem_cache *c);
+
+void
+kmem_cache_free(struct kmem_cache *c, void *obj);
+
+void
+kmem_cache_shrink(struct kmem_cache *c);
+
+void
+kmem_cache_destroy(struct kmem_cache *c);
+
 static inline void *
 kmalloc(size_t size)
 {
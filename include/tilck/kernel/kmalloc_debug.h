@@ -24,13 +24,33 @@ struct kmalloc_small_heaps_stats {
    int lifetime_created_heaps_count;
 };
 
+struct debug_kmem_cache_info {
+
+   const char *name;
+   size_t obj_size;
+   u32 in_use;
+   u32 peak_in_use;
+   u32 free_count;
+   u32 allocs;
+   u32 refills;
+};
+
 struct debug_kmalloc_chunks_ctx {
    struct bintree_walk_ctx ctx;
 };
 
+struct kmalloc_mag_stats {
+
+   u32 alloc_hits;
+   u32 alloc_misses;      /* allocs which required a refill */
+   u32 free_hits;
+   u32 drains;            /* frees which required a drain */
+};
+
 struct debug_kmalloc_stats {
 
    struct kmalloc_small_heaps_stats small_heaps;
+   struct kmalloc_mag_stats mags;
    size_t chunk_sizes_count;
 };
 
@@ -44,6 +64,12 @@ debug_kmalloc_get_heap_info_by_ptr(struct kmalloc_heap *h,
 void
 debug_kmalloc_get_stats(struct debug_kmalloc_stats *stats);
 
+bool
+debug_kmem_cache_get_info(int n, struct debug_kmem_cache_info *i);
+
+void
+debug_kmalloc_drain_magazines(void);
+
 void
 debug_kmalloc_chunks_stats_start_read(struct debug_kmalloc_chunks_ctx *ctx);
 
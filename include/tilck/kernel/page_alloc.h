@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/page_size.h>
+#include <tilck/common/string_util.h>
+
+/*
+ * Page-frame allocator
+ * -----------------------
+ *
+ * A zoned buddy allocator of physical page frames, over the AVAILABLE regions
+ * of the system memory map. All the memory it manages is linear-mapped, so
+ * the blocks are returned as (kernel) virtual addresses, like kmalloc() does.
+ * kmalloc() itself is a client of this allocator: its heaps are blocks taken
+ * from here on demand.
+ */
+
+#define PAGE_ALLOC_MAX_ORDER                   13     /* 32 MB blocks */
+#define PAGE_ALLOC_FL_DMA                 (1 << 0)
+
+enum page_zone {
+
+   PAGE_ZONE_DMA,
+   PAGE_ZONE_NORMAL,
+   PAGE_ZONES_COUNT,
+};
+
+struct page_zone_info {
+
+   const char *name;
+   ulong tot_pages;
+   ulong free_pages;
+   u32 free_blocks[PAGE_ALLOC_MAX_ORDER + 1];
+};
+
+void
+init_page_alloc(void);
+
+void *
+alloc_pages(u32 order, u32 flags);
+
+void
+free_pages(void *vaddr, u32 order);
+
+ulong
+page_alloc_get_free_pages(void);
+
+bool
+debug_page_alloc_get_zone_info(int zone, struct page_zone_info *i);
+
+static ALWAYS_INLINE void *
+alloc_page(void)
+{
+   return alloc_pages(0, 0);
+}
+
+static ALWAYS_INLINE void
+free_page(void *vaddr)
+{
+   free_pages(vaddr, 0);
+}
+
+static inline void *
+alloc_zeroed_page(void)
+{
+   void *va = alloc_page();
+
+   if (va)
+      bzero(va, PAGE_SIZE);
+
+   return va;
+}
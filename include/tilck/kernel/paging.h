@@ -53,6 +53,7 @@ extern char zero_page[PAGE_SIZE] ALIGNED_AT(PAGE_SIZE);
 
 void early_init_paging();
 bool handle_potential_cow(void *r);
+bool handle_potential_stack_growth(void *r);
 
 /*
  * Map a pageframe at `paddr` at the virtual address `vaddr` in the page
@@ -102,8 +103,19 @@ int get_mapping2(pdir_t *pdir, void *vaddrp, ulong *pa_ref);
 pdir_t *pdir_clone(pdir_t *pdir);
 pdir_t *pdir_deep_clone(pdir_t *pdir);
 void pdir_destroy(pdir_t *pdir);
+u32 pdir_get_owned_pt_count(pdir_t *pdir);
+ulong pdir_get_owned_frame_count(pdir_t *pdir);
+u32 pdir_release_user_pts(pdir_t *pdir, u32 max_pts);
 void invalidate_page(ulong vaddr);
 void set_page_rw(pdir_t *pdir, void *vaddr, bool rw);
+int swap_pages(pdir_t *pdir, void *va1, void *va2, size_t count);
+
+/*
+ * Turn into 4-MB pages the parts of the user range starting at `vaddr` mapping
+ * contiguous pageframes, 4-MB aligned both in the virtual and in the physical
+ * space, with the same flags. Returns the number of 4-MB pages made.
+ */
+size_t collapse_to_big_pages(pdir_t *pdir, void *vaddr, size_t page_count);
 void retain_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
 void release_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
 
@@ -9,3 +9,4 @@ struct pipe *create_pipe(void);
 void destroy_pipe(struct pipe *p);
 fs_handle pipe_create_read_handle(struct pipe *p);
 fs_handle pipe_create_write_handle(struct pipe *p);
+bool is_pipe(fs_handle h);
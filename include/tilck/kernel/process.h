@@ -45,6 +45,7 @@ struct process {
 
    void *brk;
    void *initial_brk;
+   void *stack_bottom;               /* lowest mapped vaddr of the stack */
    struct mappings_info *mi;
 
    struct list children;
@@ -42,7 +42,14 @@ bool user_valloc_and_map(ulong user_vaddr, size_t page_count);
 void user_vfree_and_unmap(ulong user_vaddr, size_t page_count);
 void user_unmap_zero_page(ulong user_vaddr, size_t page_count);
 bool user_map_zero_page(ulong user_vaddr, size_t page_count);
+bool user_stack_try_grow(ulong vaddr);
+bool user_is_anon_mapping(ulong vaddr, size_t len);
 int generic_fs_munmap(struct user_mapping *um, void *vaddrp, size_t len);
 
 /* Special one-time funcs */
 void set_kernel_process_pdir(pdir_t *pdir);
+void init_mm_reaper(void);
+
+/* Address-space teardown */
+void mm_reaper_destroy_pdir(pdir_t *pdir);
+bool mm_reaper_flush(void);
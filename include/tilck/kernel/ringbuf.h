@@ -40,6 +40,8 @@ bool ringbuf_read_elem(struct ringbuf *rb, void *elem_ptr /* out */);
 bool ringbuf_unwrite_elem(struct ringbuf *rb, void *elem_ptr /* out */);
 size_t ringbuf_write_bytes(struct ringbuf *rb, u8 *buf, size_t len);
 size_t ringbuf_read_bytes(struct ringbuf *rb, u8 *buf, size_t len);
+ssize_t ringbuf_write_bytes_user(struct ringbuf *rb, const void *b, size_t len);
+ssize_t ringbuf_read_bytes_user(struct ringbuf *rb, void *b, size_t len);
 
 
 inline bool ringbuf_write_elem1(struct ringbuf *rb, u8 val)
@@ -14,6 +14,25 @@
 #include <tilck_gen_headers/config_sched.h>
 
 #define TIME_SLICE_TICKS (TIMER_HZ / 25)
+#define RR_TIME_SLICE_TICKS (TIMER_HZ / 10)
+
+/*
+ * Real-time scheduling priorities, used by the SCHED_FIFO and SCHED_RR tasks.
+ * All the other tasks have priority 0 and are scheduled by the fair class.
+ */
+#define SCHED_RT_PRIO_MIN                           1
+#define SCHED_RT_PRIO_MAX                          99
+
+/*
+ * Unified scheduling priority (the higher, the more important), used to
+ * compare tasks of different classes and for the priority inheritance:
+ *
+ *      0           SCHED_OTHER tasks
+ *      1 .. 99     SCHED_FIFO and SCHED_RR tasks (their rt_prio)
+ *    100 .. 355    worker threads (from WTH_PRIO_LOWEST to WTH_PRIO_HIGHEST)
+ */
+#define SCHED_WTH_PRIO_BASE          (SCHED_RT_PRIO_MAX + 1)
+#define SCHED_PRIO_MAX               (SCHED_WTH_PRIO_BASE + WTH_PRIO_LOWEST)
 
 enum task_state {
    TASK_STATE_INVALID   = 0,
@@ -44,6 +63,46 @@ struct sched_ticks {
    u64 vruntime;        /* a brutal approx. of Linux's vruntime */
 };
 
+/*
+ * Scheduler latency stats. Each task keeps only a summary of its run delay
+ * (time spent runnable, before running) and timeslice length (time spent
+ * running, before switching), because `struct task` has a tight size limit
+ * (see TOT_PROC_AND_TASK_SIZE). The global stats have also a histogram, with
+ * power-of-two buckets in microseconds: bucket 0 counts the samples < 1 us,
+ * bucket N > 0 the samples in the range [2^(N-1), 2^N) us. The last bucket
+ * counts everything beyond that.
+ */
+#define SCHED_HIST_BUCKETS                         24
+
+struct sched_lat {
+
+   u32 count;
+   u32 max_us;
+   u64 total_ns;
+};
+
+struct sched_task_stats {
+
+   struct sched_lat run_delay;
+   struct sched_lat timeslice;
+   u32 vol_switches;              /* switches because the task blocked */
+   u32 invol_switches;            /* switches because the task was preempted */
+};
+
+struct sched_hist {
+
+   struct sched_lat lat;
+   u32 buckets[SCHED_HIST_BUCKETS];
+};
+
+struct sched_stats {
+
+   struct sched_hist run_delay;
+   struct sched_hist timeslice;
+   u32 vol_switches;
+   u32 invol_switches;
+};
+
 STATIC_ASSERT(sizeof(enum sig_state) == 1);
 
 struct task {
@@ -77,7 +136,8 @@ struct task {
    void *worker_thread;                      /* only for worker threads */
 
    struct bintree_node tree_by_tid_node;
-   struct list_node runnable_node;
+   struct bintree_node runqueue_node; /* node in the vruntime-ordered rq */
+   struct list_node runnable_node;    /* node in the timer-ready tasks list */
    struct list_node wakeup_timer_node;
    struct list_node siblings_node;    /* nodes in parent's pi's children list */
 
@@ -85,6 +145,15 @@ struct task {
 
    s32 wstatus;                       /* waitpid's wstatus  */
    struct sched_ticks ticks;          /* scheduler counters */
+   struct sched_task_stats stats;     /* scheduler latency stats */
+   u64 state_change_ns;               /* hr time of the last state change */
+   u32 runqueue_seq;                  /* insertion seq. number in the rq */
+   u8 sched_policy;                   /* SCHED_OTHER, SCHED_FIFO, SCHED_RR */
+   u8 rt_prio;                        /* 0 for SCHED_OTHER tasks */
+   u16 pi_prio;                       /* inherited priority, 0 = none */
+
+   struct kmutex *blocked_on;         /* kmutex we're waiting for, if any */
+   struct list held_mutexes;          /* kmutexes owned by this task */
 
    void *kernel_stack;
    void *args_copybuf;
@@ -95,7 +164,8 @@ struct task {
    };
 
    struct wait_obj wobj;
-   u32 ticks_before_wake_up;
+   u64 wakeup_timer_expire;           /* abs. tick of the timer, 0 = none */
+   u64 wakeup_hr_expire;              /* abs. ns of the hr timer, 0 = none */
 
    /* List of callbacks to call on exit */
    struct list on_exit;
@@ -141,7 +211,6 @@ extern struct task *kernel_process;
 extern struct process *kernel_process_pi;
 extern struct task *idle_task;
 
-extern struct list runnable_tasks_list;
 extern const char *const task_state_str[5];
 
 #define KTH_ALLOC_BUFS                       (1 << 0)
@@ -157,6 +226,7 @@ struct task *get_task(int tid);
 struct process *get_process(int pid);
 void task_change_state(struct task *ti, enum task_state new_state);
 void task_change_state_idempotent(struct task *ti, enum task_state new_state);
+void task_timer_ready(struct task *ti);
 bool save_regs_and_schedule(bool skip_disable_preempt);
 
 static ALWAYS_INLINE void sched_set_need_resched(void)
@@ -232,6 +302,28 @@ static ALWAYS_INLINE bool is_worker_thread(struct task *ti)
    return ti->worker_thread != NULL;
 }
 
+static ALWAYS_INLINE bool is_rt_task(struct task *ti)
+{
+   return ti->rt_prio != 0;
+}
+
+/* The task's own unified scheduling priority, see SCHED_PRIO_MAX */
+static ALWAYS_INLINE int sched_get_base_prio(struct task *ti)
+{
+   if (is_worker_thread(ti)) {
+      struct worker_thread *wth = (struct worker_thread *)ti->worker_thread;
+      return SCHED_WTH_PRIO_BASE + WTH_PRIO_LOWEST - wth_get_priority(wth);
+   }
+
+   return ti->rt_prio;
+}
+
+/* The task's effective priority, including the inherited one */
+static ALWAYS_INLINE int sched_get_prio(struct task *ti)
+{
+   return MAX(sched_get_base_prio(ti), (int)ti->pi_prio);
+}
+
 /*
  * Default yield function
  *
@@ -385,7 +477,10 @@ bool pending_signals(void);
 int get_curr_tid(void);
 int get_curr_pid(void);
 void save_current_task_state(regs_t *);
-void sched_account_ticks(void);
+void sched_account_ticks(u32 ticks);
+void sched_account_switch(struct task *curr);
+void sched_get_task_stats(struct task *ti, struct sched_task_stats *out);
+void sched_get_global_stats(struct sched_stats *out);
 int create_new_pid(void);
 int create_new_kernel_tid(void);
 void task_info_reset_kernel_stack(struct task *ti);
@@ -402,6 +497,8 @@ int kthread_join_all(const int *tids, size_t n, bool ignore_signals);
 void task_set_wakeup_timer(struct task *task, u32 ticks);
 void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks);
 u32 task_cancel_wakeup_timer(struct task *ti);
+void task_set_wakeup_timer_ns(struct task *ti, u64 ns);
+u64 task_cancel_wakeup_timer_ns(struct task *ti);
 
 typedef void (*kthread_func_ptr)();
 
@@ -428,3 +525,5 @@ void task_temp_kernel_free(void *ptr);
 int register_on_task_exit_cb(void (*cb)(struct task *));
 int unregister_on_task_exit_cb(void (*cb)(struct task *));
 void yield_until_last(void);
+void sched_set_task_policy(struct task *ti, int policy, int rt_prio);
+void sched_set_task_pi_prio(struct task *ti, int pi_prio);
@@ -146,6 +146,7 @@ struct kmutex {
    u32 flags;
    u32 lock_count; // Valid when the mutex is recursive
    struct list wait_list;
+   struct list_node owner_node;     /* node in owner's held_mutexes list */
 
 #if KMUTEX_STATS_ENABLED
    u32 num_waiters;
@@ -204,4 +205,5 @@ void kcond_destory(struct kcond *c);
 void kcond_signal_one(struct kcond *c);
 void kcond_signal_all(struct kcond *c);
 bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks);
+bool kcond_wait_ns(struct kcond *c, struct kmutex *m, u64 timeout_ns);
 bool kcond_is_anyone_waiting(struct kcond *c);
@@ -23,6 +23,7 @@
 #include <sys/utsname.h>  // system header
 #include <sys/stat.h>     // system header
 #include <fcntl.h>        // system header
+#include <sched.h>        // system header
 
 #define MAX_SYSCALLS 500
 
@@ -115,6 +116,14 @@ struct k_timespec64 {
    long tv_nsec;
 };
 
+/*
+ * The kernel's sched_param struct: libc's one might have extra fields.
+ */
+struct k_sched_param {
+
+   int sched_priority;
+};
+
 #ifdef BITS32
 
 /*
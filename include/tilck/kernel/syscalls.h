@@ -237,21 +237,24 @@ CREATE_STUB_SYSCALL_IMPL(sys_mlock)
 CREATE_STUB_SYSCALL_IMPL(sys_munlock)
 CREATE_STUB_SYSCALL_IMPL(sys_mlockall)
 CREATE_STUB_SYSCALL_IMPL(sys_munlockall)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_setparam)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_getparam)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_setscheduler)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_getscheduler)
 
+int sys_sched_setparam(int pid, const struct k_sched_param *u_param);
+int sys_sched_getparam(int pid, struct k_sched_param *u_param);
+int sys_sched_setscheduler(int pid,
+                           int policy,
+                           const struct k_sched_param *u_param);
+int sys_sched_getscheduler(int pid);
 int sys_sched_yield(void);
-
-CREATE_STUB_SYSCALL_IMPL(sys_sched_get_priority_max)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_set_priority_min)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval_time32)
+int sys_sched_get_priority_max(int policy);
+int sys_sched_get_priority_min(int policy);
+int sys_sched_rr_get_interval_time32(int pid, struct k_timespec32 *u_tp);
 
 int sys_nanosleep_time32(const struct k_timespec32 *req,
                          struct k_timespec32 *rem);
 
-CREATE_STUB_SYSCALL_IMPL(sys_mremap)
+long sys_mremap(void *old_addr, size_t old_size, size_t new_size,
+                int flags, void *new_addr);
+
 CREATE_STUB_SYSCALL_IMPL(sys_setresuid16)
 CREATE_STUB_SYSCALL_IMPL(sys_getresuid16)
 CREATE_STUB_SYSCALL_IMPL(sys_vm86)
@@ -292,7 +295,8 @@ int sys_getcwd(char *buf, size_t size);
 CREATE_STUB_SYSCALL_IMPL(sys_capget)
 CREATE_STUB_SYSCALL_IMPL(sys_capset)
 CREATE_STUB_SYSCALL_IMPL(sys_sigaltstack)
-CREATE_STUB_SYSCALL_IMPL(sys_sendfile)
+
+int sys_sendfile(int out_fd, int in_fd, long *u_off, size_t count);
 
 int sys_vfork(void);
 
@@ -355,7 +359,8 @@ CREATE_STUB_SYSCALL_IMPL(sys_fremovexattr)
 
 int sys_tkill(int tid, int sig);
 
-CREATE_STUB_SYSCALL_IMPL(sys_sendfile64)
+int sys_sendfile64(int out_fd, int in_fd, s64 *u_off, size_t count);
+
 CREATE_STUB_SYSCALL_IMPL(sys_futex_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_setaffinity)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_getaffinity)
@@ -440,7 +445,14 @@ CREATE_STUB_SYSCALL_IMPL(sys_ppoll)
 CREATE_STUB_SYSCALL_IMPL(sys_unshare)
 CREATE_STUB_SYSCALL_IMPL(sys_set_robust_list)
 CREATE_STUB_SYSCALL_IMPL(sys_get_robust_list)
-CREATE_STUB_SYSCALL_IMPL(sys_splice)
+
+int sys_splice(int fd_in,
+               s64 *u_off_in,
+               int fd_out,
+               s64 *u_off_out,
+               size_t len,
+               u32 flags);
+
 CREATE_STUB_SYSCALL_IMPL(sys_ia32_sync_file_range)
 CREATE_STUB_SYSCALL_IMPL(sys_tee)
 CREATE_STUB_SYSCALL_IMPL(sys_vmsplice)
@@ -465,8 +477,19 @@ CREATE_STUB_SYSCALL_IMPL(sys_dup3)
 int sys_pipe2(int u_pipefd[2], int flags);
 
 CREATE_STUB_SYSCALL_IMPL(sys_inotify_init1)
-CREATE_STUB_SYSCALL_IMPL(sys_preadv)
-CREATE_STUB_SYSCALL_IMPL(sys_pwritev)
+
+int sys_preadv(int fd,
+               const struct iovec *u_iov,
+               int u_iovcnt,
+               ulong pos_l,
+               ulong pos_h);
+
+int sys_pwritev(int fd,
+                const struct iovec *u_iov,
+                int u_iovcnt,
+                ulong pos_l,
+                ulong pos_h);
+
 CREATE_STUB_SYSCALL_IMPL(sys_rt_tgsigqueueinfo)
 CREATE_STUB_SYSCALL_IMPL(sys_perf_event_open)
 CREATE_STUB_SYSCALL_IMPL(sys_recvmmsg_time32)
@@ -513,8 +536,21 @@ CREATE_STUB_SYSCALL_IMPL(sys_userfaultfd)
 CREATE_STUB_SYSCALL_IMPL(sys_membarrier)
 CREATE_STUB_SYSCALL_IMPL(sys_mlock2)
 CREATE_STUB_SYSCALL_IMPL(sys_copy_file_range)
-CREATE_STUB_SYSCALL_IMPL(sys_preadv2)
-CREATE_STUB_SYSCALL_IMPL(sys_pwritev2)
+
+int sys_preadv2(int fd,
+                const struct iovec *u_iov,
+                int u_iovcnt,
+                ulong pos_l,
+                ulong pos_h,
+                int flags);
+
+int sys_pwritev2(int fd,
+                 const struct iovec *u_iov,
+                 int u_iovcnt,
+                 ulong pos_l,
+                 ulong pos_h,
+                 int flags);
+
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_mprotect)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_alloc)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_free)
@@ -556,7 +592,9 @@ CREATE_STUB_SYSCALL_IMPL(sys_mq_timedreceive)
 CREATE_STUB_SYSCALL_IMPL(sys_semtimedop)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigtimedwait)
 CREATE_STUB_SYSCALL_IMPL(sys_futex)
-CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval)
+
+int sys_sched_rr_get_interval(int pid, struct k_timespec64 *u_tp);
+
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_send_signal)
 CREATE_STUB_SYSCALL_IMPL(sys_io_uring_setup)
 CREATE_STUB_SYSCALL_IMPL(sys_io_uring_enter)
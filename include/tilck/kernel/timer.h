@@ -6,6 +6,7 @@
 
 void kernel_sleep(u64 ticks);  /* sleep for `ticks` timer ticks (jiffies) */
 void kernel_sleep_ms(u64 ms);  /* sleep for `ms` milliseconds */
+void kernel_sleep_ns(u64 ns);  /* sleep for `ns` nanoseconds (hr timers) */
 void delay_us(u32 us);         /* busy-wait for `us` microseconds */
 
 static ALWAYS_INLINE u64
@@ -14,5 +15,32 @@ ms_to_ticks(u64 ms)
    return ms / (1000 / TIMER_HZ);
 }
 
+/*
+ * A clocksource provides the time elapsed since the last accounted tick, with
+ * a resolution better than the tick's one. See register_clocksource().
+ */
+struct vdso_data;
+
+struct clocksource {
+
+   const char *name;
+   u32 res_ns;                        /* resolution in nanoseconds */
+   u32 (*tick_elapsed_ns)(void);      /* called with interrupts disabled */
+   void (*on_tick)(void);             /* optional, called on every tick */
+
+   /* optional, allows usermode to read the clocksource via the vDSO */
+   void (*vdso_update)(struct vdso_data *vd);
+};
+
+void register_clocksource(struct clocksource *cs);
+const struct clocksource *get_curr_clocksource(void);
+
 u64 get_ticks(void);
+u64 get_hr_time_ns(void);
 void init_timer(void);
+void hrtimer_irq_handler(void);
+
+#if KRN_TICKLESS_IDLE
+void tickless_halt(void);
+void timer_irq_enter(void);
+#endif
@@ -1,6 +1,27 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
+
+/*
+ * The vDSO time data page is mapped read-only for usermode right after the
+ * vdso page, at USER_VDSO_DATA_VADDR. The offsets below are used by the vDSO
+ * functions in assembly and must match `struct vdso_data`.
+ */
+#define VDSO_DATA_SEQ_OFF                0
+#define VDSO_DATA_CLOCK_MODE_OFF         4
+#define VDSO_DATA_SEC_OFF                8
+#define VDSO_DATA_NSEC_OFF              16
+#define VDSO_DATA_TSC_MAX_DELTA_OFF     20
+#define VDSO_DATA_TSC_LAST_OFF          24
+#define VDSO_DATA_TSC_MULT_OFF          32
+#define VDSO_DATA_MAX_NS_OFF            40
+
+/* Values for `clock_mode` */
+#define VDSO_CLOCK_NONE                  0   /* only coarse time in usermode */
+#define VDSO_CLOCK_TSC                   1   /* usermode can read the TSC */
+
+#ifndef ASM_FILE
+
 #include <tilck/common/basic_defs.h>
 
 extern const ulong vdso_begin;
@@ -8,3 +29,31 @@ extern const ulong vdso_end;
 extern const ulong sysexit_user_code_user_vaddr;
 extern const ulong post_sig_handler_user_vaddr;
 extern const ulong pause_trampoline_user_vaddr;
+extern const ulong vdso_elf_user_vaddr;
+
+/*
+ * Time data shared with usermode, protected by a seqcount: the kernel makes
+ * `seq` odd while updating the fields, and readers retry when `seq` is odd or
+ * changed while reading. `sec` and `nsec` are the real time at the last tick;
+ * the TSC fields allow usermode to add the time elapsed since then, exactly
+ * like the TSC clocksource does. The elapsed time is capped at `max_ns`, the
+ * amount the time will advance on the next tick, in order to keep the time
+ * monotonic even while the clock drift is being compensated.
+ */
+struct vdso_data {
+
+   u32 seq;
+   u32 clock_mode;
+   u64 sec;
+   u32 nsec;
+   u32 tsc_max_delta;
+   u64 tsc_last_tick;
+   u64 tsc_mult;
+   u32 max_ns;
+};
+
+extern char vdso_data_page[];
+
+void vdso_update_time(void);
+
+#endif
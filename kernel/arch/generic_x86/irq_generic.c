@@ -13,6 +13,7 @@
 #include <tilck/kernel/timer.h>
 
 #include "pic.h"
+#include "lapic.h"
 
 struct list irq_handlers_lists[16] = {
    STATIC_LIST_INIT(irq_handlers_lists[ 0]),
@@ -105,6 +106,13 @@ void arch_irq_handling(regs_t *r)
    ASSERT(!are_interrupts_enabled());
    ASSERT(!is_preemption_enabled());
 
+   if (r->int_num == X86_LAPIC_TIMER_INT) {
+
+      /* Not a PIC IRQ: handle it entirely with interrupts disabled */
+      lapic_timer_irq_handling();
+      return;
+   }
+
    if (pic_is_spur_irq(irq)) {
       spur_irq_count++;
       return;
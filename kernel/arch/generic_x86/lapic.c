@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_sched.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+
+#include "lapic.h"
+#include "pit.h"
+
+#define LAPIC_BASE_ENABLE           (1u << 11)
+#define LAPIC_BASE_ADDR_MASK        0xfffff000
+
+/* Registers (offsets from the base address) */
+#define LAPIC_REG_EOI                    0x0b0
+#define LAPIC_REG_SVR                    0x0f0
+#define LAPIC_REG_LVT_TIMER              0x320
+#define LAPIC_REG_LVT_LINT0              0x350
+#define LAPIC_REG_LVT_LINT1              0x360
+#define LAPIC_REG_TIMER_INIT             0x380
+#define LAPIC_REG_TIMER_CURR             0x390
+#define LAPIC_REG_TIMER_DIV              0x3e0
+
+#define LAPIC_SVR_ENABLE            (1u << 8)
+#define LAPIC_LVT_MASKED            (1u << 16)
+#define LAPIC_LVT_DM_NMI            (4u << 8)    /* delivery mode: NMI */
+#define LAPIC_LVT_DM_EXTINT         (7u << 8)    /* delivery mode: ExtINT */
+#define LAPIC_TIMER_DIV_16          0x3
+
+#define LAPIC_CALIBRATION_US        10000        /* 10 ms */
+
+static volatile u32 *lapic_regs;
+static u32 lapic_timer_hz;        /* LAPIC timer freq, after the divider */
+
+static ALWAYS_INLINE u32 lapic_read(u32 reg)
+{
+   return lapic_regs[reg / sizeof(u32)];
+}
+
+static ALWAYS_INLINE void lapic_write(u32 reg, u32 val)
+{
+   lapic_regs[reg / sizeof(u32)] = val;
+}
+
+static bool lapic_map(void)
+{
+   u64 base = rdmsr(MSR_IA32_APIC_BASE);
+   ulong paddr = (ulong)(base & LAPIC_BASE_ADDR_MASK);
+   void *va;
+
+   if (!(base & LAPIC_BASE_ENABLE)) {
+      printk("LAPIC: disabled in the IA32_APIC_BASE MSR\n");
+      return false;
+   }
+
+   if (!(va = hi_vmem_reserve(PAGE_SIZE))) {
+      printk("LAPIC: ERROR: hi vmem OOM\n");
+      return false;
+   }
+
+   if (map_kernel_page(va, paddr, PAGING_FL_RW) < 0) {
+      printk("LAPIC: ERROR: unable to map the registers\n");
+      hi_vmem_release(va, PAGE_SIZE);
+      return false;
+   }
+
+   lapic_regs = va;
+   return true;
+}
+
+static void lapic_calibrate_timer(void)
+{
+   u32 elapsed;
+
+   lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+   lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | X86_LAPIC_TIMER_INT);
+
+   pit_ch2_start_oneshot(LAPIC_CALIBRATION_US);
+   lapic_write(LAPIC_REG_TIMER_INIT, 0xffffffff);
+   pit_ch2_wait_oneshot();
+
+   elapsed = 0xffffffff - lapic_read(LAPIC_REG_TIMER_CURR);
+   lapic_write(LAPIC_REG_TIMER_INIT, 0);
+
+   lapic_timer_hz = elapsed * (MILLION / LAPIC_CALIBRATION_US);
+}
+
+/*
+ * Enable the local APIC, keeping the legacy PIC as the source of all the
+ * regular IRQs (virtual wire mode: the PIC is connected to LINT0), and setup
+ * its timer in one-shot mode. Returns false in case the LAPIC timer cannot
+ * be used.
+ *
+ * NOTE: interrupts must be disabled.
+ */
+bool init_lapic_timer(void)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (!x86_cpu_features.edx1.apic) {
+      printk("LAPIC: not supported by the CPU\n");
+      return false;
+   }
+
+   if (!lapic_map())
+      return false;
+
+   lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_DM_EXTINT);
+   lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_DM_NMI);
+   lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | X86_LAPIC_SPUR_INT);
+
+   lapic_calibrate_timer();
+
+   if (lapic_timer_hz < MILLION) {
+      printk("LAPIC: timer too slow (%u Hz), don't use it\n", lapic_timer_hz);
+      return false;
+   }
+
+   /* One-shot mode (bits 17-18 = 0), unmasked */
+   lapic_write(LAPIC_REG_LVT_TIMER, X86_LAPIC_TIMER_INT);
+
+   printk("LAPIC: timer freq: %u.%03u MHz\n",
+          lapic_timer_hz / MILLION, (lapic_timer_hz % MILLION) / 1000);
+
+   return true;
+}
+
+/*
+ * Program the LAPIC timer to fire once, after `ns` nanoseconds. Arming the
+ * timer again before it fires, just replaces the previous deadline.
+ */
+void lapic_timer_arm(u32 ns)
+{
+   u64 count = ((u64)ns * lapic_timer_hz) / BILLION;
+   lapic_write(LAPIC_REG_TIMER_INIT, (u32)CLAMP(count, 1u, UINT32_MAX));
+}
+
+void lapic_timer_irq_handling(void)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   lapic_write(LAPIC_REG_EOI, 0);
+   hrtimer_irq_handler();
+}
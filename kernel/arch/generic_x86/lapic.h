@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+bool init_lapic_timer(void);
+void lapic_timer_arm(u32 ns);
+void lapic_timer_irq_handling(void);
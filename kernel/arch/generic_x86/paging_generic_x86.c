@@ -95,10 +95,11 @@ void init_paging(void)
    init_hi_vmem_heap();
 
    /*
-    * Now use the just-created hi vmem heap to reserve a page for the user
-    * vdso-like page and expect it to be == USER_VDSO_VADDR.
+    * Now use the just-created hi vmem heap to reserve two pages for the user
+    * vdso-like page and its data page, and expect them to be at
+    * USER_VDSO_VADDR.
     */
-   user_vdso_vaddr = hi_vmem_reserve(PAGE_SIZE);
+   user_vdso_vaddr = hi_vmem_reserve(2 * PAGE_SIZE);
 
    if (user_vdso_vaddr != (void *)USER_VDSO_VADDR)
       panic("user_vdso_vaddr != USER_VDSO_VADDR");
@@ -114,6 +115,18 @@ void init_paging(void)
 
    if (rc < 0)
       panic("Unable to map the vdso-like page");
+
+   /*
+    * Map the vdso data page right after it, read-only for usermode. The
+    * kernel updates it through its regular (kernel) address.
+    */
+   rc = map_page(get_kernel_pdir(),
+                 (void *)USER_VDSO_DATA_VADDR,
+                 KERNEL_VA_TO_PA(vdso_data_page),
+                 PAGING_FL_US);
+
+   if (rc < 0)
+      panic("Unable to map the vdso data page");
 }
 
 void *
@@ -222,6 +222,25 @@ bool irq_is_masked(int irq)
    return res;
 }
 
+/* Check if the given IRQ has been raised, but not yet acknowledged */
+bool pic_is_irq_pending(int irq)
+{
+   u8 irr;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(IN_RANGE_INC(irq, 0, 16));
+
+   if (irq < 8) {
+      outb(PIC1_COMMAND, PIC_READ_IRR);
+      irr = inb(PIC1_COMMAND);
+   } else {
+      outb(PIC2_COMMAND, PIC_READ_IRR);
+      irr = inb(PIC2_COMMAND);
+      irq -= 8;
+   }
+
+   return !!(irr & (1 << irq));
+}
+
 bool pic_is_spur_irq(int irq)
 {
    ASSERT(!are_interrupts_enabled());
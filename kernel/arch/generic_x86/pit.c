@@ -1,10 +1,15 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/datetime.h>
 
+#include "pic.h"
+#include "pit.h"
+#include "lapic.h"
+
 #define PIT_FREQ           1193182
 
 #define PIT_CMD_PORT          0x43
@@ -31,6 +36,62 @@
 #define PIT_CH2         0b10000000   // select channel 2
 
 #define PIT_READ_BACK   0b11000000   // read-back command (8254 only)
+#define PIT_RB_CH0      0b00000010   // read-back: select channel 0
+#define PIT_STATUS_OUT  0b10000000   // read-back status: OUT pin state
+
+#define PC_SPEAKER_PORT       0x61
+#define PC_SPEAKER_GATE2      0b00000001   // gate of the channel 2
+#define PC_SPEAKER_DATA       0b00000010   // speaker connected to channel 2
+#define PC_SPEAKER_OUT2       0b00100000   // OUT pin of the channel 2
+
+/*
+ * State of the channel 0, when used as fallback for the high-resolution
+ * timers, because the local APIC timer is not available.
+ */
+enum pit_hr_state {
+   PIT_HR_NONE,               // periodic mode, no hr one-shot armed
+   PIT_HR_SHOT,               // counting until the hr timer deadline
+   PIT_HR_BOUNDARY,           // counting until the next tick boundary
+};
+
+static u32 pit_divisor;              // counts per tick, in periodic mode
+static u32 pit_oneshot_count;        // initial count of the armed one-shot
+static u32 pit_oneshot_first;        // counts until the first tick boundary
+static u32 pit_oneshot_ticks;        // tick boundaries covered by the one-shot
+static enum pit_hr_state pit_hr_state;
+static u32 pit_hr_rem;               // counts from the hr deadline to the tick
+static bool hrtimer_use_lapic;
+
+static struct clocksource pit_clocksource = {
+   .name = "pit",
+   .res_ns = (TS_SCALE + PIT_FREQ - 1) / PIT_FREQ,
+   .tick_elapsed_ns = &hw_timer_tick_elapsed_ns,
+   .on_tick = NULL,
+   .vdso_update = NULL,
+};
+
+static void pit_set_ch0(u8 mode, u32 count)
+{
+   outb(PIT_CMD_PORT, PIT_MODE_BIN | mode | PIT_ACC_LOHI | PIT_CH0);
+   outb(PIT_CH0_PORT, count & 0xff);              /* Set low byte of count */
+   outb(PIT_CH0_PORT, (count >> 8) & 0xff);       /* Set high byte of count */
+}
+
+/* Latch and read the status and the current count of the channel 0 */
+static u32 pit_read_ch0(bool *out)
+{
+   u8 status, lo, hi;
+
+   outb(PIT_CMD_PORT, PIT_READ_BACK | PIT_RB_CH0);
+   status = inb(PIT_CH0_PORT);
+   lo = inb(PIT_CH0_PORT);
+   hi = inb(PIT_CH0_PORT);
+
+   if (out)
+      *out = !!(status & PIT_STATUS_OUT);
+
+   return (u32)lo | ((u32)hi << 8);
+}
 
 /*
  * Set the time between ticks to be `interval`, where 1 means 1/TS_SCALE sec.
@@ -78,9 +139,300 @@ u32 hw_timer_setup(u32 interval)
    actual_interval /= PIT_FREQ;
    ASSERT(actual_interval < UINT32_MAX);
 
-   outb(PIT_CMD_PORT, PIT_MODE_BIN | PIT_MODE_2 | PIT_ACC_LOHI | PIT_CH0);
-   outb(PIT_CH0_PORT, divisor & 0xff);            /* Set low byte of divisor */
-   outb(PIT_CH0_PORT, (divisor >> 8) & 0xff);     /* Set high byte of divisor */
-
+   pit_divisor = divisor;
+   pit_set_ch0(PIT_MODE_2, divisor);
+   register_clocksource(&pit_clocksource);
    return (u32)actual_interval;
 }
+
+/*
+ * Stop the periodic tick and program a one-shot timer firing at the `ticks`-th
+ * tick boundary from now, as measured when reading the counter. Returns the
+ * number of ticks actually covered by the one-shot, which might be less than
+ * `ticks` because of the 16-bit counter of the PIT. Returns 0 in case the
+ * one-shot could not be armed.
+ *
+ * NOTE: the phase of the periodic tick is NOT kept exactly: every time ch0 is
+ * reprogrammed (here and in hw_timer_oneshot_stop()), the counts elapsed
+ * between the read of the counter (or the IRQ) and the write of the new count
+ * are lost. Therefore, while idle, the tick clock slowly drifts behind the
+ * real time. With KRN_CLOCK_DRIFT_COMP, that's compensated by clock_drift_adj()
+ * in datetime.c, which periodically compares the system clock with the RTC.
+ *
+ * NOTE: interrupts must be disabled.
+ */
+u32 hw_timer_oneshot(u32 ticks)
+{
+   u32 first, max_ticks;
+
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(ticks > 0);
+
+   if (!pit_divisor || pit_oneshot_ticks || pit_hr_state != PIT_HR_NONE)
+      return 0;
+
+   /* In mode 2, the counter goes from `divisor` to 1 during each tick */
+   first = pit_read_ch0(NULL);
+
+   if (!IN_RANGE_INC(first, 1, pit_divisor))
+      return 0;
+
+   max_ticks = (0xffff - first) / pit_divisor + 1;
+   ticks = MIN(ticks, max_ticks);
+
+   pit_oneshot_first = first;
+   pit_oneshot_count = first + (ticks - 1) * pit_divisor;
+   pit_oneshot_ticks = ticks;
+
+   pit_set_ch0(PIT_MODE_0, pit_oneshot_count);
+   return ticks;
+}
+
+/*
+ * Called on any IRQ while a one-shot is armed. Returns the number of tick
+ * boundaries crossed since the one-shot has been armed and sets `*expired`
+ * if the one-shot already fired. In that case, the periodic tick is restored.
+ * Otherwise, a new one-shot is armed for the next tick boundary and the timer
+ * is considered covering exactly one tick from now on.
+ *
+ * NOTE: interrupts must be disabled.
+ */
+u32 hw_timer_oneshot_stop(bool *expired)
+{
+   u32 rem, elapsed, crossed, next;
+   bool out;
+
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(pit_oneshot_ticks > 0);
+
+   rem = pit_read_ch0(&out);
+
+   if (out) {
+
+      /* The one-shot fired (in mode 0, OUT goes high on terminal count) */
+      crossed = pit_oneshot_ticks;
+      pit_oneshot_ticks = 0;
+      pit_set_ch0(PIT_MODE_2, pit_divisor);
+      *expired = true;
+      return crossed;
+   }
+
+   /* rem <= pit_oneshot_count, as the one-shot didn't fire yet */
+   elapsed = pit_oneshot_count - MIN(rem, pit_oneshot_count);
+
+   if (elapsed < pit_oneshot_first)
+      crossed = 0;
+   else
+      crossed = 1 + (elapsed - pit_oneshot_first) / pit_divisor;
+
+   crossed = MIN(crossed, pit_oneshot_ticks - 1);
+   next = pit_oneshot_first + crossed * pit_divisor - elapsed;
+   next = MAX(next, 1u);
+
+   /* Re-arm the one-shot for the next tick boundary */
+   pit_oneshot_first = next;
+   pit_oneshot_count = next;
+   pit_oneshot_ticks = 1;
+   pit_set_ch0(PIT_MODE_0, next);
+
+   *expired = false;
+   return crossed;
+}
+
+/*
+ * Start the channel 2 in one-shot mode, for `us` microseconds. Its output is
+ * not connected to any IRQ: it has to be polled with pit_ch2_wait_oneshot().
+ * Used only for calibrating other timers.
+ */
+void pit_ch2_start_oneshot(u32 us)
+{
+   const u32 count = (u32)(((u64)us * PIT_FREQ) / MILLION);
+   ASSERT(IN_RANGE_INC(count, 1, 0xffff));
+
+   /* Enable the gate of the channel 2, keeping the PC speaker disconnected */
+   outb(PC_SPEAKER_PORT,
+        (inb(PC_SPEAKER_PORT) & ~PC_SPEAKER_DATA) | PC_SPEAKER_GATE2);
+
+   outb(PIT_CMD_PORT, PIT_MODE_BIN | PIT_MODE_0 | PIT_ACC_LOHI | PIT_CH2);
+   outb(PIT_CH2_PORT, count & 0xff);
+   outb(PIT_CH2_PORT, (count >> 8) & 0xff);
+}
+
+void pit_ch2_wait_oneshot(void)
+{
+   while (!(inb(PC_SPEAKER_PORT) & PC_SPEAKER_OUT2)) { }
+}
+
+/*
+ * Returns the number of PIT counts until the next tick boundary. In case
+ * a hr one-shot is armed, `pit_hr_rem` counts have to be added to the current
+ * value of the counter.
+ */
+static u32 pit_counts_to_tick_boundary(void)
+{
+   u32 elapsed, val;
+   bool out;
+
+   val = pit_read_ch0(&out);
+
+   switch (pit_hr_state) {
+
+      case PIT_HR_NONE:
+         return val;
+
+      case PIT_HR_SHOT:
+
+         if (!out)
+            return val + pit_hr_rem;
+
+         /* In mode 0, after the terminal count the counter wraps around */
+         elapsed = (0x10000 - val) & 0xffff;
+         return pit_hr_rem - MIN(elapsed, pit_hr_rem);
+
+      case PIT_HR_BOUNDARY:
+         return out ? 0 : val;
+
+      default:
+         NOT_REACHED();
+   }
+}
+
+/*
+ * Returns the nanoseconds elapsed since the last tick boundary, with the
+ * resolution of the PIT (~838 ns). In case the IRQ 0 is pending, the tick
+ * has not been accounted yet: therefore, the result can be > than a tick.
+ *
+ * NOTE: interrupts must be disabled.
+ */
+u32 hw_timer_tick_elapsed_ns(void)
+{
+   u32 elapsed;
+   ASSERT(!are_interrupts_enabled());
+
+   if (!pit_divisor || pit_oneshot_ticks)
+      return 0;
+
+   elapsed = pit_divisor - MIN(pit_counts_to_tick_boundary(), pit_divisor);
+
+   if (pic_is_irq_pending(X86_PC_TIMER_IRQ))
+      elapsed += pit_divisor;
+
+   return (u32)(((u64)elapsed * TS_SCALE) / PIT_FREQ);
+}
+
+/*
+ * Shorten the current tick in order to fire a hr timer after `ns` nanoseconds,
+ * if that's before the next tick boundary. Otherwise, do nothing and let the
+ * periodic tick (which always checks the hr timers) to handle that.
+ *
+ * The channel 0 is programmed in one-shot mode (0) for the hr deadline and,
+ * when that IRQ comes, again in one-shot mode for the remaining counts until
+ * the tick boundary. Finally, the periodic mode is restored.
+ */
+static void pit_hrtimer_arm(u32 ns)
+{
+   u32 counts, rem;
+
+   if (!pit_divisor || pit_oneshot_ticks)
+      return;            /* tickless idle: the next IRQ will re-program us */
+
+   /*
+    * In case the IRQ 0 is pending, we cannot change the state of the channel
+    * 0, because the IRQ handler won't be able to determine if that was a hr
+    * timer or a tick. Just wait for the IRQ: it will re-program us.
+    */
+   if (pic_is_irq_pending(X86_PC_TIMER_IRQ))
+      return;
+
+   rem = pit_counts_to_tick_boundary();
+   counts = (u32)MAX(1u, ((u64)ns * PIT_FREQ) / TS_SCALE);
+
+   if (counts >= rem)
+      return;
+
+   pit_hr_rem = rem - counts;
+   pit_hr_state = PIT_HR_SHOT;
+   pit_set_ch0(PIT_MODE_0, counts);
+}
+
+/*
+ * Called on the timer IRQ. Returns true if the IRQ has been triggered by a hr
+ * timer and NOT by the periodic tick.
+ */
+bool hw_timer_hr_irq(void)
+{
+   u32 elapsed, val;
+   bool out, res = false;
+   ulong var;
+
+   disable_interrupts(&var);
+
+   switch (pit_hr_state) {
+
+      case PIT_HR_NONE:
+         break;
+
+      case PIT_HR_SHOT:
+
+         res = true;
+         val = pit_read_ch0(&out);
+
+         if (!out)
+            break;      /* Re-programmed while the IRQ was coming: ignore */
+
+         /* Count until the tick boundary, minus the IRQ latency */
+         elapsed = (0x10000 - val) & 0xffff;
+         val = pit_hr_rem > elapsed ? pit_hr_rem - elapsed : 1;
+         pit_set_ch0(PIT_MODE_0, val);
+         pit_hr_state = PIT_HR_BOUNDARY;
+         break;
+
+      case PIT_HR_BOUNDARY:
+
+         /*
+          * Tick boundary: restore the periodic mode. The IRQ latency is lost
+          * here, but the drift compensation in datetime.c will fix that.
+          */
+         pit_set_ch0(PIT_MODE_2, pit_divisor);
+         pit_hr_state = PIT_HR_NONE;
+         break;
+   }
+
+   enable_interrupts(&var);
+   return res;
+}
+
+/*
+ * Setup the high-resolution one-shot timer: the local APIC timer, when
+ * available, otherwise the PIT itself. Returns true in case of success.
+ */
+bool hw_hrtimer_setup(void)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (init_lapic_timer()) {
+      hrtimer_use_lapic = true;
+      printk("hrtimer: using the local APIC timer\n");
+   } else {
+      printk("hrtimer: using the PIT (fallback)\n");
+   }
+
+   return pit_divisor > 0;
+}
+
+/*
+ * Arm the high-resolution timer to fire after `ns` nanoseconds, replacing
+ * any previous deadline. In the PIT case, deadlines after the next tick are
+ * handled by the periodic tick itself.
+ *
+ * NOTE: interrupts must be disabled.
+ */
+void hw_hrtimer_arm(u32 ns)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (hrtimer_use_lapic)
+      lapic_timer_arm(ns);
+   else
+      pit_hrtimer_arm(ns);
+}
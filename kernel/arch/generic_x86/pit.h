@@ -0,0 +1,6 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+void pit_ch2_start_oneshot(u32 us);
+void pit_ch2_wait_oneshot(void);
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/vdso.h>
+
+#define TSC_MULT_SHIFT           32
+
+extern u32 __tick_duration;
+
+static u64 tsc_last_tick;     /* TSC value at the last accounted tick */
+static u64 tsc_mult;          /* ns = (cycles * tsc_mult) >> TSC_MULT_SHIFT */
+static u32 tsc_max_delta;     /* max cycles delta to avoid 64-bit overflows */
+
+static u32 tsc_tick_elapsed_ns(void)
+{
+   u64 delta = RDTSC() - tsc_last_tick;
+   delta = MIN(delta, (u64)tsc_max_delta);
+   return (u32)((delta * tsc_mult) >> TSC_MULT_SHIFT);
+}
+
+static void tsc_on_tick(void)
+{
+   tsc_last_tick = RDTSC();
+}
+
+static void tsc_vdso_update(struct vdso_data *vd)
+{
+   vd->clock_mode = VDSO_CLOCK_TSC;
+   vd->tsc_last_tick = tsc_last_tick;
+   vd->tsc_mult = tsc_mult;
+   vd->tsc_max_delta = tsc_max_delta;
+}
+
+static struct clocksource tsc_clocksource = {
+   .name = "tsc",
+   .res_ns = 1,
+   .tick_elapsed_ns = &tsc_tick_elapsed_ns,
+   .on_tick = &tsc_on_tick,
+   .vdso_update = &tsc_vdso_update,
+};
+
+/*
+ * Register the TSC as clocksource, given the number of TSC cycles per tick,
+ * measured by the timer code together with the bogoMips. The TSC can be used
+ * only if it's invariant: its frequency must not change with the P-states and
+ * it must not stop in deep C-states.
+ */
+void hw_tsc_clocksource_init(u64 tsc_per_tick)
+{
+   u64 tsc_hz;
+
+   if (!x86_cpu_features.edx1.tsc || !x86_cpu_features.invariant_TSC)
+      return;
+
+   if (!tsc_per_tick || tsc_per_tick > UINT32_MAX)
+      return;
+
+   tsc_mult = ((u64)__tick_duration << TSC_MULT_SHIFT) / tsc_per_tick;
+
+   if (!tsc_mult)
+      return;
+
+   /*
+    * Allow deltas up to 2^32 - 1 cycles (e.g. while in tickless idle), as long
+    * as the multiplication does not overflow and the result fits in 32 bits.
+    */
+   tsc_max_delta = (u32)MIN(UINT64_MAX / tsc_mult, (u64)UINT32_MAX);
+   tsc_max_delta = (u32)MIN((u64)tsc_max_delta,
+                            ((u64)UINT32_MAX << TSC_MULT_SHIFT) / tsc_mult);
+
+   tsc_hz = tsc_per_tick * TS_SCALE / __tick_duration;
+   tsc_clocksource.res_ns = (u32)MAX(1u, TS_SCALE / tsc_hz);
+
+   register_clocksource(&tsc_clocksource);
+}
@@ -11,6 +11,8 @@
 #include "idt_int.h"
 #include "../generic_x86/pic.h"
 
+void lapic_timer_irq_entry(void);
+void lapic_spur_irq_entry(void);
 
 /*
  * We first remap the interrupt controllers, and then we install
@@ -32,4 +34,18 @@ void init_irq_handling(void)
 
       irq_set_mask(i);
    }
+
+   /*
+    * The local APIC interrupts don't go through the PIC. Their vectors are
+    * installed even if the LAPIC won't be used, because that's harmless.
+    */
+   idt_set_entry(X86_LAPIC_TIMER_INT,
+                 lapic_timer_irq_entry,
+                 X86_KERNEL_CODE_SEL,
+                 IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE | IDT_FLAG_DPL0);
+
+   idt_set_entry(X86_LAPIC_SPUR_INT,
+                 lapic_spur_irq_entry,
+                 X86_KERNEL_CODE_SEL,
+                 IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE | IDT_FLAG_DPL0);
 }
@@ -11,6 +11,7 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/hal.h>
@@ -40,6 +41,343 @@ pdir_get_page_table(pdir_t *pdir, u32 i)
    return PA_TO_LIN_VA(pdir->entries[i].ptaddr << PAGE_SHIFT);
 }
 
+/*
+ * The ref-count of a user page table is the number of pdirs using it, stored
+ * as the ref-count of its own pageframe (page tables are never mapped in the
+ * user space).
+ */
+static ALWAYS_INLINE u32 pt_ref_count_inc(page_table_t *pt)
+{
+   return pf_ref_count_inc(LIN_VA_TO_PA(pt));
+}
+
+static ALWAYS_INLINE u32 pt_ref_count_dec(page_table_t *pt)
+{
+   return pf_ref_count_dec(LIN_VA_TO_PA(pt));
+}
+
+static ALWAYS_INLINE u32 pt_ref_count_get(page_table_t *pt)
+{
+   return pf_ref_count_get(LIN_VA_TO_PA(pt));
+}
+
+/*
+ * Mark all the non-shared pages in `pt` as COW and retain their pageframes,
+ * because they're about to be referenced by one more page table.
+ */
+static void pt_cow_retain_pages(page_table_t *pt)
+{
+   for (u32 j = 0; j < 1024; j++) {
+
+      page_t *const p = &pt->pages[j];
+
+      if (!p->present)
+         continue;
+
+      const ulong paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+
+      /* Sanity-check: a mapped page MUST have ref-count > 0 */
+      ASSERT(pf_ref_count_get(paddr) > 0);
+
+      if (!(p->avail & PAGE_SHARED)) {
+
+         if (p->rw)
+            p->avail |= PAGE_COW_ORIG_RW;
+
+         p->rw = false;
+      }
+
+      pf_ref_count_inc(paddr);
+   }
+}
+
+/*
+ * User 4-MB pages
+ * ------------------
+ *
+ * The ref-counts of the pageframes in a user 4-MB page are kept one by one,
+ * exactly as if the 4-MB page were made by 1024 regular pages. Therefore,
+ * splitting a 4-MB page in a page table (required before doing anything on a
+ * part of it: COW, partial un-map, etc.) and collapsing a page table of
+ * contiguous pages in a 4-MB page don't need to touch the ref-counts at all.
+ */
+
+static ALWAYS_INLINE ulong big_page_get_paddr(page_dir_entry_t *e)
+{
+   return (ulong)e->big_4mb_page.paddr << BIG_PAGE_SHIFT;
+}
+
+static void big_page_retain_frames(ulong paddr)
+{
+   for (u32 j = 0; j < 1024; j++)
+      pf_ref_count_inc(paddr + (j << PAGE_SHIFT));
+}
+
+static void big_page_release_frames(ulong paddr, bool free_pageframes)
+{
+   for (u32 j = 0; j < 1024; j++) {
+
+      const ulong pa = paddr + (j << PAGE_SHIFT);
+
+      if (pa >= phys_mem_lim)
+         break; /* Not RAM (e.g. the framebuffer): no ref-counts */
+
+      if (!pf_ref_count_dec(pa) && free_pageframes) {
+         ASSERT(pa != KERNEL_VA_TO_PA(zero_page));
+         free_page(PA_TO_LIN_VA(pa));
+      }
+   }
+}
+
+/* Tell if none of the pageframes in the 4-MB page is used by other pdirs */
+static bool big_page_is_private(ulong paddr)
+{
+   for (u32 j = 0; j < 1024; j++)
+      if (pf_ref_count_get(paddr + (j << PAGE_SHIFT)) > 1)
+         return false;
+
+   return true;
+}
+
+/*
+ * Replace the user 4-MB page at `pd_index` with a page table mapping the same
+ * pageframes, with the same flags. Returns false in the out-of-memory case.
+ */
+static bool pdir_split_big_page(pdir_t *pdir, u32 pd_index)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   const ulong paddr = big_page_get_paddr(e);
+   page_table_t *pt;
+   u32 flags;
+
+   ASSERT(e->present && e->psize);
+   ASSERT(pd_index < BASE_VADDR_PD_IDX);
+
+   if (!(pt = kalloc_obj(page_table_t)))
+      return false;
+
+   ASSERT(IS_PAGE_ALIGNED(pt));
+   ASSERT(pt_ref_count_get(pt) == 0);
+
+   flags = PG_PRESENT_BIT | (e->raw & PG_BIG_PAGE_FLAGS);
+
+   if (e->big_4mb_page.pat)
+      flags |= PG_PAGE_PAT_BIT;
+
+   for (u32 j = 0; j < 1024; j++)
+      pt->pages[j].raw = flags | (paddr + (j << PAGE_SHIFT));
+
+   pt_ref_count_inc(pt);
+   e->raw = PG_PRESENT_BIT | PG_RW_BIT | PG_US_BIT | LIN_VA_TO_PA(pt);
+   invalidate_page_hw(pd_index << BIG_PAGE_SHIFT);
+   return true;
+}
+
+/*
+ * Replace the page table at `pd_index` with a 4-MB page, if it maps 1024
+ * contiguous pageframes starting at a 4-MB aligned paddr, all with the same
+ * flags. Only private page tables are considered.
+ */
+static bool pdir_try_collapse_page_table(pdir_t *pdir, u32 pd_index)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   page_table_t *pt;
+   ulong paddr;
+   u32 flags;
+
+   ASSERT(pd_index < BASE_VADDR_PD_IDX);
+
+   if (!e->present || e->psize || (e->avail & PDE_SHARED_PT))
+      return false;
+
+   pt = pdir_get_page_table(pdir, pd_index);
+   paddr = (ulong)pt->pages[0].pageAddr << PAGE_SHIFT;
+   flags = pt->pages[0].raw & (PG_BIG_PAGE_FLAGS | PG_PAGE_PAT_BIT);
+
+   if (pt_ref_count_get(pt) > 1 || (paddr & (4 * MB - 1)))
+      return false;
+
+   for (u32 j = 0; j < 1024; j++) {
+
+      const page_t p = pt->pages[j];
+
+      if (!p.present || p.pageAddr != (paddr >> PAGE_SHIFT) + j)
+         return false;
+
+      if ((p.raw & (PG_BIG_PAGE_FLAGS | PG_PAGE_PAT_BIT)) != flags)
+         return false;
+   }
+
+   e->raw = PG_PRESENT_BIT | PG_4MB_BIT | (flags & PG_BIG_PAGE_FLAGS) | paddr;
+
+   if (flags & PG_PAGE_PAT_BIT)
+      e->big_4mb_page.pat = 1;
+
+   pt_ref_count_dec(pt);
+   kfree_obj(pt, page_table_t);
+
+   /* Flush the whole TLB: that's cheaper than 1024 invalidations */
+   if (pdir == get_curr_pdir())
+      set_curr_pdir(pdir);
+
+   return true;
+}
+
+size_t collapse_to_big_pages(pdir_t *pdir, void *vaddr, size_t page_count)
+{
+   const ulong va = (ulong)vaddr;
+   const u32 first = (u32)(pow2_round_up_at(va, 4 * MB) >> BIG_PAGE_SHIFT);
+   const u32 end = (u32)((va + (page_count << PAGE_SHIFT)) >> BIG_PAGE_SHIFT);
+   size_t count = 0;
+
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+   ASSERT(end <= BASE_VADDR_PD_IDX);
+
+   for (u32 i = first; i < end; i++)
+      count += pdir_try_collapse_page_table(pdir, i);
+
+   return count;
+}
+
+/*
+ * Map a newly allocated (zeroed) 4-MB page in place of the page table at
+ * `vaddr`, when it maps just the zero page 1024 times in a big-enough private
+ * anonymous mapping. Called on the first write in that 4-MB region: big
+ * mappings typically get used as a whole, so that's worth the TLB entries and
+ * the page table saved, as long as we have plenty of free memory.
+ */
+static bool pdir_try_map_anon_big_page(pdir_t *pdir, ulong vaddr)
+{
+   const ulong zero_pa = KERNEL_VA_TO_PA(zero_page);
+   const ulong min_free = USER_HUGE_PAGE_MIN_FREE_MEM >> PAGE_SHIFT;
+   const u32 pd_index = vaddr >> BIG_PAGE_SHIFT;
+   page_table_t *pt = pdir_get_page_table(pdir, pd_index);
+   ulong paddr;
+   void *big_page;
+
+   if (MMAP_NO_HUGE_PAGES)
+      return false;
+
+   if (page_alloc_get_free_pages() < min_free)
+      return false;
+
+   if (!user_is_anon_mapping(vaddr & ~(4 * MB - 1), 4 * MB))
+      return false;
+
+   ASSERT(pt_ref_count_get(pt) == 1);
+
+   for (u32 j = 0; j < 1024; j++)
+      if (pt->pages[j].pageAddr != (zero_pa >> PAGE_SHIFT))
+         return false; /* Some pages have been already touched */
+
+   if (!(big_page = alloc_pages(BIG_PAGE_ORDER, 0)))
+      return false;
+
+   bzero(big_page, 4 * MB);
+   paddr = LIN_VA_TO_PA(big_page);
+
+   for (u32 j = 0; j < 1024; j++) {
+      pf_ref_count_dec(zero_pa);
+      pf_ref_count_inc(paddr + (j << PAGE_SHIFT));
+   }
+
+   pdir->entries[pd_index].raw =
+      PG_PRESENT_BIT | PG_RW_BIT | PG_US_BIT | PG_4MB_BIT | paddr;
+
+   pt_ref_count_dec(pt);
+   kfree_obj(pt, page_table_t);
+
+   /* Flush the whole TLB: that's cheaper than 1024 invalidations */
+   set_curr_pdir(pdir);
+   return true;
+}
+
+/*
+ * Make the page table for `pd_index` private to `pdir`, if it's shared with
+ * other pdirs after pdir_clone(). Only at this point, the pages in it are
+ * marked as COW and retained one by one: that's what makes fork() fast. When
+ * the other pdirs have already dropped the page table, there's nothing to copy.
+ * A user 4-MB page gets split in a page table instead, as any operation on a
+ * single page requires one.
+ *
+ * Returns false in the out-of-memory case.
+ */
+static bool pdir_unshare_page_table(pdir_t *pdir, u32 pd_index)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   page_table_t *pt, *new_pt;
+
+   if (!e->present)
+      return true;
+
+   if (UNLIKELY(e->psize)) {
+
+      if (pd_index >= BASE_VADDR_PD_IDX)
+         return true; /* The kernel's 4-MB pages are never split */
+
+      return pdir_split_big_page(pdir, pd_index);
+   }
+
+   if (LIKELY(!(e->avail & PDE_SHARED_PT)))
+      return true;
+
+   ASSERT(pd_index < BASE_VADDR_PD_IDX);
+   pt = pdir_get_page_table(pdir, pd_index);
+
+   if (pt_ref_count_get(pt) > 1) {
+
+      if (!(new_pt = kalloc_obj(page_table_t)))
+         return false;
+
+      /*
+       * Running out of memory, the allocator might have made the MM reaper
+       * destroy the other pdirs sharing `pt`: check again.
+       */
+      if (pt_ref_count_get(pt) == 1) {
+         kfree_obj(new_pt, page_table_t);
+         goto not_shared;
+      }
+
+      ASSERT(IS_PAGE_ALIGNED(new_pt));
+      ASSERT(pt_ref_count_get(new_pt) == 0);
+
+      pt_cow_retain_pages(pt);
+      memcpy32(new_pt, pt, sizeof(page_table_t) / 4);
+
+      pt_ref_count_dec(pt);
+      pt_ref_count_inc(new_pt);
+      e->ptaddr = SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
+   }
+
+not_shared:
+   e->avail &= ~PDE_SHARED_PT;
+   e->rw = true;
+
+   /* Flush the whole TLB: that's cheaper than 1024 invalidations */
+   if (pdir == get_curr_pdir())
+      set_curr_pdir(pdir);
+
+   return true;
+}
+
+static bool handle_cow_out_of_memory(const char *what)
+{
+   struct task *curr = get_curr_task();
+
+   if (!curr->running_in_kernel) {
+
+      // The task was not running in kernel: we can safely kill it.
+      printk("Out-of-memory: killing pid %d\n", get_curr_pid());
+      send_signal(get_curr_pid(), SIGKILL, SIG_FL_PROCESS | SIG_FL_FAULT);
+      return true;
+   }
+
+   // We cannot kill a task running in kernel during a CoW page fault
+   // In this case (but in the one above too), Linux puts the process to
+   // sleep, while the OOM killer runs and frees some memory.
+   panic("Out-of-memory: can't copy a CoW %s [pid %d]", what, get_curr_pid());
+}
+
 bool handle_potential_cow(void *context)
 {
    regs_t *r = context;
@@ -53,7 +391,42 @@ bool handle_potential_cow(void *context)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
    const void *const page_vaddr = (void *)(vaddr & PAGE_MASK);
-   page_table_t *pt = pdir_get_page_table(get_curr_pdir(), pd_index);
+   pdir_t *const pdir = get_curr_pdir();
+   page_dir_entry_t *const e = &pdir->entries[pd_index];
+   page_table_t *pt;
+
+   if (e->psize) {
+
+      if (!(e->avail & PAGE_COW_ORIG_RW))
+         return false; /* Not a COW page */
+
+      if (big_page_is_private(big_page_get_paddr(e))) {
+
+         /* Not shared anymore: no need for splitting it */
+         e->rw = true;
+         e->avail &= ~PAGE_COW_ORIG_RW;
+         invalidate_page_hw(vaddr);
+         return true;
+      }
+
+      /* Split the 4-MB page and copy just the page being written */
+      if (!pdir_split_big_page(pdir, pd_index))
+         return handle_cow_out_of_memory("page table");
+
+   } else if (e->avail & PDE_SHARED_PT) {
+
+      if (!pdir_unshare_page_table(pdir, pd_index))
+         return handle_cow_out_of_memory("page table");
+
+      pt = pdir_get_page_table(pdir, pd_index);
+
+      if (pt->pages[pt_index].rw) {
+         invalidate_page_hw(vaddr);
+         return true; /* The page was writable: just the table was shared */
+      }
+   }
+
+   pt = pdir_get_page_table(pdir, pd_index);
 
    if (!(pt->pages[pt_index].avail & PAGE_COW_ORIG_RW))
       return false; /* Not a COW page */
@@ -78,29 +451,15 @@ bool handle_potential_cow(void *context)
       return true;
    }
 
-   // Allocate a new page.
-   void *new_page_vaddr = kmalloc(PAGE_SIZE);
-
-   if (!new_page_vaddr) {
-
-      // Out-of-memory case
-      struct task *curr = get_curr_task();
-
-      if (!curr->running_in_kernel) {
-
-         // The task was not running in kernel: we can safely kill it.
-         printk("Out-of-memory: killing pid %d\n", get_curr_pid());
-         send_signal(get_curr_pid(), SIGKILL, SIG_FL_PROCESS | SIG_FL_FAULT);
+   if (orig_page_paddr == KERNEL_VA_TO_PA(zero_page))
+      if (pdir_try_map_anon_big_page(pdir, vaddr))
          return true;
 
-      } else {
+   // Allocate a new page.
+   void *new_page_vaddr = alloc_page();
 
-         // We cannot kill a task running in kernel during a CoW page fault
-         // In this case (but in the one above too), Linux puts the process to
-         // sleep, while the OOM killer runs and frees some memory.
-         panic("Out-of-memory: can't copy a CoW page [pid %d]", get_curr_pid());
-      }
-   }
+   if (!new_page_vaddr)
+      return handle_cow_out_of_memory("page");
 
    ASSERT(IS_PAGE_ALIGNED(new_page_vaddr));
 
@@ -116,8 +475,12 @@ bool handle_potential_cow(void *context)
    // Increase the ref-count of the new pageframe
    pf_ref_count_inc(paddr);
 
-   // Decrease the ref-count of the original pageframe.
-   pf_ref_count_dec(orig_page_paddr);
+   /*
+    * Decrease the ref-count of the original pageframe. It might drop to 0 if
+    * the allocation above made the MM reaper destroy the other pdirs using it.
+    */
+   if (!pf_ref_count_dec(orig_page_paddr))
+      free_page(PA_TO_LIN_VA(orig_page_paddr));
 
    // Re-map the vaddr to its new (writable) pageframe
    pt->pages[pt_index].pageAddr = SHR_BITS(paddr, PAGE_SHIFT, u32);
@@ -128,6 +491,32 @@ bool handle_potential_cow(void *context)
    return true;
 }
 
+/*
+ * Like in Linux, a fault from user space is considered an access to the stack
+ * only when it's not too far below the stack pointer: the biggest legit case is
+ * `enter` with a 64 KB frame (+ 32 pushed words).
+ */
+#define USER_STACK_FAULT_SLACK            (64 * KB + 32 * sizeof(ulong))
+
+bool handle_potential_stack_growth(void *context)
+{
+   regs_t *r = context;
+   u32 vaddr;
+
+   if (r->err_code & PAGE_FAULT_FL_PRESENT)
+      return false;
+
+   asmVolatile("movl %%cr2, %0" : "=r"(vaddr));
+
+   if ((r->err_code & PAGE_FAULT_FL_US) &&
+       vaddr + USER_STACK_FAULT_SLACK < r->useresp)
+   {
+      return false;
+   }
+
+   return user_stack_try_grow(vaddr);
+}
+
 static void kernel_page_fault_panic(regs_t *r, u32 vaddr, bool rw, bool p)
 {
    long off = 0;
@@ -249,12 +638,70 @@ void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
 
+   ASSERT(!(pdir->entries[pd_index].avail & PDE_SHARED_PT));
+
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    ASSERT(LIN_VA_TO_PA(pt) != 0);
    pt->pages[pt_index].rw = rw;
    invalidate_page_hw(vaddr);
 }
 
+static page_t *get_pte(pdir_t *pdir, ulong vaddr)
+{
+   const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+
+   ASSERT(pdir->entries[pd_index].present);
+   return &pdir_get_page_table(pdir, pd_index)->pages[pt_index];
+}
+
+static bool unshare_page_tables(pdir_t *pdir, ulong vaddr, size_t count)
+{
+   const u32 first = vaddr >> BIG_PAGE_SHIFT;
+   const u32 last = (vaddr + (count << PAGE_SHIFT) - 1) >> BIG_PAGE_SHIFT;
+
+   for (u32 i = first; i <= last; i++)
+      if (!pdir_unshare_page_table(pdir, i))
+         return false;
+
+   return true;
+}
+
+int swap_pages(pdir_t *pdir, void *va1, void *va2, size_t count)
+{
+   page_t *p1, *p2, tmp;
+
+   ASSERT(IS_PAGE_ALIGNED(va1));
+   ASSERT(IS_PAGE_ALIGNED(va2));
+
+   /* Unshare all the page tables first: the swap itself cannot fail */
+   if (!unshare_page_tables(pdir, (ulong)va1, count))
+      return -ENOMEM;
+
+   if (!unshare_page_tables(pdir, (ulong)va2, count))
+      return -ENOMEM;
+
+   for (size_t i = 0; i < count; i++) {
+
+      const ulong v1 = (ulong)va1 + (i << PAGE_SHIFT);
+      const ulong v2 = (ulong)va2 + (i << PAGE_SHIFT);
+
+      p1 = get_pte(pdir, v1);
+      p2 = get_pte(pdir, v2);
+
+      ASSERT(p1->present && p2->present);
+
+      tmp = *p1;
+      *p1 = *p2;
+      *p2 = tmp;
+
+      invalidate_page_hw(v1);
+      invalidate_page_hw(v2);
+   }
+
+   return 0;
+}
+
 static inline int
 __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 {
@@ -263,6 +710,14 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
 
+   if (UNLIKELY(!pdir_unshare_page_table(pdir, pd_index))) {
+
+      if (permissive)
+         return -ENOMEM;
+
+      panic("Out-of-memory: unable to unshare a page table");
+   }
+
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
 
    if (permissive) {
@@ -286,7 +741,7 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 
    if (!pf_ref_count_dec(paddr) && free_pageframe) {
       ASSERT(paddr != KERNEL_VA_TO_PA(zero_page));
-      kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+      free_page(PA_TO_LIN_VA(paddr));
    }
 
    return 0;
@@ -304,6 +759,31 @@ unmap_page_permissive(pdir_t *pdir, void *vaddrp, bool free_pageframe)
    return __unmap_page(pdir, vaddrp, free_pageframe, true);
 }
 
+/*
+ * Un-map the whole user 4-MB page at `vaddrp`, if any, without splitting it.
+ * Returns false if there's no such page.
+ */
+static bool
+unmap_big_page(pdir_t *pdir, void *vaddrp, bool free_pageframes)
+{
+   const ulong vaddr = (ulong) vaddrp;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   ulong paddr;
+
+   if ((vaddr & (4 * MB - 1)) || pd_index >= BASE_VADDR_PD_IDX)
+      return false;
+
+   if (!e->present || !e->psize)
+      return false;
+
+   paddr = big_page_get_paddr(e);
+   e->raw = 0;
+   invalidate_page_hw(vaddr);
+   big_page_release_frames(paddr, free_pageframes);
+   return true;
+}
+
 void
 unmap_pages(pdir_t *pdir,
             void *vaddr,
@@ -311,7 +791,15 @@ unmap_pages(pdir_t *pdir,
             bool do_free)
 {
    for (size_t i = 0; i < page_count; i++) {
-      unmap_page(pdir, (char *)vaddr + (i << PAGE_SHIFT), do_free);
+
+      void *va = (char *)vaddr + (i << PAGE_SHIFT);
+
+      if (page_count - i >= 1024 && unmap_big_page(pdir, va, do_free)) {
+         i += 1023;
+         continue;
+      }
+
+      unmap_page(pdir, va, do_free);
    }
 }
 
@@ -325,11 +813,16 @@ unmap_pages_permissive(pdir_t *pdir,
    int rc;
 
    for (size_t i = 0; i < page_count; i++) {
-      rc = unmap_page_permissive(
-         pdir,
-         (char *)vaddr + (i << PAGE_SHIFT),
-         do_free
-      );
+
+      void *va = (char *)vaddr + (i << PAGE_SHIFT);
+
+      if (page_count - i >= 1024 && unmap_big_page(pdir, va, do_free)) {
+         unmapped_pages += 1024;
+         i += 1023;
+         continue;
+      }
+
+      rc = unmap_page_permissive(pdir, va, do_free);
       unmapped_pages += (rc == 0);
    }
 
@@ -353,6 +846,11 @@ ulong get_mapping(pdir_t *pdir, void *vaddrp)
 
    e.raw = pdir->entries[pd_index].raw;
    ASSERT(e.present);
+
+   if (e.psize)
+      return ((ulong) e.big_4mb_page.paddr << BIG_PAGE_SHIFT) |
+             (vaddr & (4 * MB - 1));
+
    ASSERT(e.ptaddr != 0);
 
    pt = PA_TO_LIN_VA(e.ptaddr << PAGE_SHIFT);
@@ -417,6 +915,9 @@ map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, u32 hw_flags)
    ASSERT(!(vaddr & OFFSET_IN_PAGE_MASK)); // the vaddr must be page-aligned
    ASSERT(!(paddr & OFFSET_IN_PAGE_MASK)); // the paddr must be page-aligned
 
+   if (UNLIKELY(!pdir_unshare_page_table(pdir, pd_index)))
+      return -ENOMEM;
+
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    ASSERT(IS_PAGE_ALIGNED(pt));
 
@@ -429,6 +930,7 @@ map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, u32 hw_flags)
          return -ENOMEM;
 
       ASSERT(IS_PAGE_ALIGNED(pt));
+      pt_ref_count_inc(pt);
 
       pdir->entries[pd_index].raw =
          PG_PRESENT_BIT |
@@ -523,7 +1025,7 @@ map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
       void *va;
       ASSERT(paddr == 0);
 
-      if (!(va = kmalloc(PAGE_SIZE)))
+      if (!(va = alloc_page()))
          return -ENOMEM;
 
       if (pg_flags & PAGING_FL_ZERO_PG)
@@ -548,7 +1050,7 @@ map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
                    /* Kernel pages are global */
 
    if (UNLIKELY(rc != 0) && (pg_flags & PAGING_FL_DO_ALLOC)) {
-      kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+      free_page(PA_TO_LIN_VA(paddr));
    }
 
    return rc;
@@ -606,6 +1108,13 @@ map_pages(pdir_t *pdir,
                     (u32)((!us) << PG_GLOBAL_BIT_POS));
 }
 
+/*
+ * Clone `pdir` for fork(), sharing all of its user page tables with the new
+ * pdir, instead of copying them: the page tables are copied only on the first
+ * write, see pdir_unshare_page_table(). That makes fork() cost proportional to
+ * the number of page tables, not to the amount of mapped memory. The user 4-MB
+ * pages become COW as a whole instead: they're split on the first write.
+ */
 pdir_t *pdir_clone(pdir_t *pdir)
 {
    pdir_t *new_pdir = kalloc_obj(pdir_t);
@@ -614,69 +1123,49 @@ pdir_t *pdir_clone(pdir_t *pdir)
       return NULL;
 
    ASSERT(IS_PAGE_ALIGNED(new_pdir));
-   memcpy32(new_pdir, pdir, sizeof(pdir_t) / 4);
-
-   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
-      /* User-space cannot use 4-MB pages */
-      ASSERT(!pdir->entries[i].psize);
-
-      if (!pdir->entries[i].present)
-         continue;
+   if (pdir == __kernel_pdir) {
 
-      page_table_t *pt = kalloc_obj(page_table_t);
+      /*
+       * New pdir for execve(): the kernel's page tables are never shared and,
+       * in the user part, there's nothing a program should inherit.
+       */
+      bzero(new_pdir, BASE_VADDR_PD_IDX * sizeof(new_pdir->entries[0]));
 
-      if (UNLIKELY(!pt)) {
+      for (u32 i = BASE_VADDR_PD_IDX; i < 1024; i++)
+         new_pdir->entries[i].raw = pdir->entries[i].raw;
 
-         for (; i > 0; i--) {
-            if (pdir->entries[i - 1].present)
-               kfree_obj(pdir_get_page_table(pdir, i - 1), page_table_t);
-         }
-
-         kfree_obj(new_pdir, pdir_t);
-         return NULL;
-      }
-
-      ASSERT(IS_PAGE_ALIGNED(pt));
-      new_pdir->entries[i].ptaddr=SHR_BITS(LIN_VA_TO_PA(pt),PAGE_SHIFT,u32);
+      return new_pdir;
    }
 
    for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
-      if (!pdir->entries[i].present)
-         continue;
-
-      page_table_t *orig_pt = pdir_get_page_table(pdir, i);
-      page_table_t *new_pt = pdir_get_page_table(new_pdir, i);
-
-      /* Mark all the non-shared pages in that page-table as COW. */
-      for (u32 j = 0; j < 1024; j++) {
+      page_dir_entry_t *e = &pdir->entries[i];
 
-         page_t *const p = &orig_pt->pages[j];
-
-         if (!p->present)
-            continue;
-
-         const ulong orig_paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+      if (!e->present)
+         continue;
 
-         /* Sanity-check: a mapped page MUST have ref-count > 0 */
-         ASSERT(pf_ref_count_get(orig_paddr) > 0);
+      if (e->psize) {
 
-         if (!(p->avail & PAGE_SHARED)) {
+         /* A 4-MB page: just make it COW, like a regular page */
+         if (!(e->avail & PAGE_SHARED)) {
 
-            if (p->rw)
-               p->avail |= PAGE_COW_ORIG_RW;
+            if (e->rw)
+               e->avail |= PAGE_COW_ORIG_RW;
 
-            p->rw = false;
+            e->rw = false;
          }
 
-         pf_ref_count_inc(orig_paddr);
+         big_page_retain_frames(big_page_get_paddr(e));
+         continue;
       }
 
-      // copy the page table
-      memcpy(new_pt, orig_pt, sizeof(page_table_t));
+      e->avail |= PDE_SHARED_PT;
+      e->rw = false;
+      pt_ref_count_inc(pdir_get_page_table(pdir, i));
    }
 
+   memcpy32(new_pdir, pdir, sizeof(pdir_t) / 4);
    return new_pdir;
 }
 
@@ -696,16 +1185,22 @@ pdir_deep_clone(pdir_t *pdir)
 
    ASSERT(IS_PAGE_ALIGNED(new_pdir));
 
-   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
+   /* Make the user part empty, in order to support pdir_destroy() on OOM */
+   bzero(new_pdir, BASE_VADDR_PD_IDX * sizeof(new_pdir->entries[0]));
 
+   for (u32 i = BASE_VADDR_PD_IDX; i < 1024; i++) {
       new_pdir->entries[i].raw = pdir->entries[i].raw;
+   }
 
-      /* User-space cannot use 4-MB pages */
-      ASSERT(!pdir->entries[i].psize);
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
       if (!pdir->entries[i].present)
          continue;
 
+      /* 4-MB pages are copied as regular pages */
+      if (pdir->entries[i].psize && !pdir_split_big_page(pdir, i))
+         goto oom_exit;
+
       page_table_t *orig_pt = pdir_get_page_table(pdir, i);
       page_table_t *new_pt = kmalloc_accelerator_get_elem(&acc);
 
@@ -713,15 +1208,22 @@ pdir_deep_clone(pdir_t *pdir)
          goto oom_exit;
 
       ASSERT(IS_PAGE_ALIGNED(new_pt));
+      bzero(new_pt, sizeof(page_table_t));
+      pt_ref_count_inc(new_pt);
 
-      for (u32 j = 0; j < 1024; j++) {
+      /* The copied page table is never shared */
+      new_pdir->entries[i].raw = pdir->entries[i].raw;
+      new_pdir->entries[i].avail &= ~PDE_SHARED_PT;
+      new_pdir->entries[i].rw = true;
+      new_pdir->entries[i].ptaddr =
+         SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
 
-         new_pt->pages[j].raw = orig_pt->pages[j].raw;
+      for (u32 j = 0; j < 1024; j++) {
 
          if (!orig_pt->pages[j].present)
             continue;
 
-         void *new_page = kmalloc_accelerator_get_elem(&acc);
+         void *new_page = alloc_page();
 
          if (!new_page)
             goto oom_exit;
@@ -738,15 +1240,9 @@ pdir_deep_clone(pdir_t *pdir)
          pf_ref_count_inc(new_page_paddr);
 
          memcpy32(new_page, orig_page, PAGE_SIZE / 4);
+         new_pt->pages[j].raw = orig_pt->pages[j].raw;
          new_pt->pages[j].pageAddr = SHR_BITS(new_page_paddr, PAGE_SHIFT, u32);
       }
-
-      new_pdir->entries[i].ptaddr =
-         SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
-   }
-
-   for (u32 i = BASE_VADDR_PD_IDX; i < 1024; i++) {
-      new_pdir->entries[i].raw = pdir->entries[i].raw;
    }
 
    kmalloc_destroy_accelerator(&acc);
@@ -762,38 +1258,131 @@ oom_exit:
    return NULL;
 }
 
-void pdir_destroy(pdir_t *pdir)
+/* Drop pdir's reference to the user page table `i`, freeing it if unused */
+static void pdir_release_user_pt(pdir_t *pdir, u32 i)
 {
-   // Kernel's pdir cannot be destroyed!
-   ASSERT(pdir != __kernel_pdir);
+   page_table_t *pt;
+
+   if (pdir->entries[i].psize) {
+      big_page_release_frames(big_page_get_paddr(&pdir->entries[i]), true);
+      pdir->entries[i].raw = 0;
+      return;
+   }
+
+   pt = pdir_get_page_table(pdir, i);
+   pdir->entries[i].raw = 0;
+
+   // The page table is still used by other pdirs: just drop our ref.
+   if (pt_ref_count_dec(pt) > 0)
+      return;
+
+   for (u32 j = 0; j < 1024; j++) {
+
+      if (!pt->pages[j].present)
+         continue;
+
+      const ulong paddr = (ulong)pt->pages[j].pageAddr << PAGE_SHIFT;
+
+      if (pf_ref_count_dec(paddr) == 0)
+         free_page(PA_TO_LIN_VA(paddr));
+   }
+
+   // We freed all the pages, now free the whole page-table.
+   kfree_obj(pt, page_table_t);
+}
+
+u32 pdir_get_owned_pt_count(pdir_t *pdir)
+{
+   u32 count = 0;
+
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
+
+      if (!pdir->entries[i].present)
+         continue;
+
+      if (pdir->entries[i].psize)
+         count++; /* A 4-MB page costs at least as much as a page table */
+      else if (pt_ref_count_get(pdir_get_page_table(pdir, i)) <= 1)
+         count++;
+   }
+
+   return count;
+}
+
+/*
+ * Count the page frames that destroying `pdir` would free: the page tables it
+ * owns and their frames not mapped by any other pdir. The 4-MB pages are
+ * counted as all private.
+ */
+ulong pdir_get_owned_frame_count(pdir_t *pdir)
+{
+   ulong count = 0;
+   page_table_t *pt;
 
    for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
       if (!pdir->entries[i].present)
          continue;
 
-      page_table_t *pt = pdir_get_page_table(pdir, i);
+      if (pdir->entries[i].psize) {
+         count += 1024;
+         continue;
+      }
+
+      pt = pdir_get_page_table(pdir, i);
+
+      if (pt_ref_count_get(pt) > 1)
+         continue;
+
+      count++;
 
       for (u32 j = 0; j < 1024; j++) {
 
          if (!pt->pages[j].present)
             continue;
 
-         const ulong paddr = (ulong)pt->pages[j].pageAddr << PAGE_SHIFT;
-
-         if (pf_ref_count_dec(paddr) == 0)
-            kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+         if (pf_ref_count_get((u32)pt->pages[j].pageAddr << PAGE_SHIFT) == 1)
+            count++;
       }
+   }
 
-      // We freed all the pages, now free the whole page-table.
-      kfree_obj(pt, page_table_t);
+   return count;
+}
+
+u32 pdir_release_user_pts(pdir_t *pdir, u32 max_pts)
+{
+   u32 count = 0;
+
+   ASSERT(pdir != __kernel_pdir);
+   ASSERT(pdir != get_curr_pdir());
+
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX && count < max_pts; i++) {
+
+      if (!pdir->entries[i].present)
+         continue;
+
+      pdir_release_user_pt(pdir, i);
+      count++;
+   }
+
+   return count;
+}
+
+void pdir_destroy(pdir_t *pdir)
+{
+   // Kernel's pdir cannot be destroyed!
+   ASSERT(pdir != __kernel_pdir);
+
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
+
+      if (pdir->entries[i].present)
+         pdir_release_user_pt(pdir, i);
    }
 
    // We freed all pages and all the page-tables, now free pdir.
    kfree_obj(pdir, pdir_t);
 }
 
-
 void map_4mb_page_int(pdir_t *pdir,
                       void *vaddrp,
                       ulong paddr,
@@ -37,12 +37,17 @@
 #define PG_CUSTOM_BITS  (PG_CUSTOM_B0 | PG_CUSTOM_B1 | PG_CUSTOM_B2)
 #define PG_4MB_PAT_BIT  (1u << PG_4MB_PAT_BIT_POS)
 
+/* The flags of a page_t which have a counterpart in a 4-MB page entry */
+#define PG_BIG_PAGE_FLAGS                                                 \
+   (PG_RW_BIT | PG_US_BIT | PG_WT_BIT | PG_CD_BIT | PG_CUSTOM_BITS)
+
 #define PAGE_FAULT_FL_PRESENT (1u << 0)
 #define PAGE_FAULT_FL_RW      (1u << 1)
 #define PAGE_FAULT_FL_US      (1u << 2)
 
 #define PAGE_FAULT_FL_COW (PAGE_FAULT_FL_PRESENT | PAGE_FAULT_FL_RW)
 #define BIG_PAGE_SHIFT                                            22
+#define BIG_PAGE_ORDER                   (BIG_PAGE_SHIFT - PAGE_SHIFT)
 #define BASE_VADDR_PD_IDX                (BASE_VA >> BIG_PAGE_SHIFT)
 
 // A page table entry
@@ -72,6 +77,18 @@ struct x86_page_table {
    union x86_page pages[1024];
 };
 
+/*
+ * When this flag is set in the 'avail' bits of a page directory entry, its
+ * page table is shared with other pdirs (see pdir_clone()) and, therefore, the
+ * entry is read-only. On a write attempt, the page table has to be copied.
+ *
+ * NOTE: that's only for the entries pointing to a page table. The 'avail' bits
+ * of the user 4-MB page entries have the same meaning as in page_t instead
+ * (PAGE_COW_ORIG_RW, PAGE_SHARED), because they're just 1024 pages, mapped
+ * with a single entry: see pdir_split_big_page().
+ */
+#define PDE_SHARED_PT                          (1 << 0)
+
 // A page directory entry
 union x86_page_dir_entry {
 
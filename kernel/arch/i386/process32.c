@@ -24,6 +24,8 @@
 
 #include <tilck/mods/tracing.h>
 
+#include <elf.h>         // system header
+
 #include "gdt_int.h"
 
 void soft_interrupt_resume(void);
@@ -110,18 +112,18 @@ push_args_on_user_stack(regs_t *r,
       env_pointers[i] = r->useresp;
    }
 
-   // push the env array (in reverse order)
-
-   push_on_user_stack(r, 0); /*
-                              * 2nd mandatory NULL pointer: after the 'env'
-                              * pointers there could additional aux information
-                              * that some libc implementations check for.
-                              * Therefore, it is essential to add another NULL
-                              * after the env pointers to inform the libc impl
-                              * that no such information exist. For more info,
-                              * check __init_libc() in libmusl.
-                              */
+   /*
+    * Push the aux vector (in reverse order), after the 'env' pointers. Some
+    * libc implementations require it, even if it contains only AT_NULL: for
+    * more info, check __init_libc() in libmusl. Provide AT_SYSINFO_EHDR, the
+    * address of the vDSO's ELF image, used by libc to find the vDSO functions.
+    */
+   push_on_user_stack(r, 0);
+   push_on_user_stack(r, AT_NULL);
+   push_on_user_stack(r, vdso_elf_user_vaddr);
+   push_on_user_stack(r, AT_SYSINFO_EHDR);
 
+   // push the env array (in reverse order)
    push_on_user_stack(r, 0); // mandatory final NULL pointer (end of 'env' ptrs)
 
    for (u32 i = envc; i > 0; i--) {
@@ -522,7 +524,7 @@ int setup_process(struct elf_program_info *pinfo,
          process_free_mappings_info(pi);
 
          ASSERT(old_pdir == pi->pdir);
-         pdir_destroy(pi->pdir);
+         mm_reaper_destroy_pdir(pi->pdir);
 
          if (pi->elf)
             release_subsys_flock(pi->elf);
@@ -654,6 +656,7 @@ switch_to_task(struct task *ti)
    if (UNLIKELY(ti != curr)) {
       ASSERT(curr->state != TASK_STATE_RUNNING);
       ASSERT_TASK_STATE(ti->state, TASK_STATE_RUNNABLE);
+      sched_account_switch(curr);
    }
 
    ASSERT(!is_preemption_enabled());
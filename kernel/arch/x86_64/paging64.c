@@ -136,6 +136,31 @@ void pdir_destroy(pdir_t *pdir)
    NOT_IMPLEMENTED();
 }
 
+u32 pdir_get_owned_pt_count(pdir_t *pdir)
+{
+   NOT_IMPLEMENTED();
+}
+
+ulong pdir_get_owned_frame_count(pdir_t *pdir)
+{
+   NOT_IMPLEMENTED();
+}
+
+u32 pdir_release_user_pts(pdir_t *pdir, u32 max_pts)
+{
+   NOT_IMPLEMENTED();
+}
+
+int swap_pages(pdir_t *pdir, void *va1, void *va2, size_t count)
+{
+   NOT_IMPLEMENTED();
+}
+
+size_t collapse_to_big_pages(pdir_t *pdir, void *vaddr, size_t page_count)
+{
+   NOT_IMPLEMENTED();
+}
+
 void set_pages_pat_wc(pdir_t *pdir, void *vaddr, size_t size)
 {
    NOT_IMPLEMENTED();
@@ -146,6 +171,11 @@ bool handle_potential_cow(void *context)
    NOT_IMPLEMENTED();
 }
 
+bool handle_potential_stack_growth(void *context)
+{
+   NOT_IMPLEMENTED();
+}
+
 void init_hi_vmem_heap(void)
 {
    NOT_IMPLEMENTED();
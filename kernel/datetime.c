@@ -463,10 +463,8 @@ u64 timespec_to_ticks(const struct k_timespec64 *tp)
    return ticks;
 }
 
-void real_time_get_timespec(struct k_timespec64 *tp)
+static void sys_time_to_real_timespec(u64 t, struct k_timespec64 *tp)
 {
-   const u64 t = get_sys_time();
-
    tp->tv_sec = (s64)boot_timestamp + (s64)(t / TS_SCALE);
 
    if (TS_SCALE <= BILLION)
@@ -475,6 +473,17 @@ void real_time_get_timespec(struct k_timespec64 *tp)
       tp->tv_nsec = (t % TS_SCALE) / (TS_SCALE / BILLION);
 }
 
+void real_time_get_timespec(struct k_timespec64 *tp)
+{
+   sys_time_to_real_timespec(get_hr_time_ns(), tp);
+}
+
+/* Tick-resolution version of real_time_get_timespec(), for the COARSE clocks */
+void real_time_get_coarse_timespec(struct k_timespec64 *tp)
+{
+   sys_time_to_real_timespec(get_sys_time(), tp);
+}
+
 void monotonic_time_get_timespec(struct k_timespec64 *tp)
 {
    /* Same as the real_time clock, for the moment */
@@ -527,16 +536,19 @@ do_clock_gettime(clockid_t clk_id, struct k_timespec64 *tp)
    switch (clk_id) {
 
       case CLOCK_REALTIME:
-      case CLOCK_REALTIME_COARSE:
          real_time_get_timespec(tp);
          break;
 
       case CLOCK_MONOTONIC:
-      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_MONOTONIC_RAW:
          monotonic_time_get_timespec(tp);
          break;
 
+      case CLOCK_REALTIME_COARSE:
+      case CLOCK_MONOTONIC_COARSE:
+         real_time_get_coarse_timespec(tp);
+         break;
+
       case CLOCK_PROCESS_CPUTIME_ID:
       case CLOCK_THREAD_CPUTIME_ID:
          task_cpu_get_timespec(tp);
@@ -556,10 +568,18 @@ do_clock_getres(clockid_t clk_id, struct k_timespec64 *res)
    switch (clk_id) {
 
       case CLOCK_REALTIME:
-      case CLOCK_REALTIME_COARSE:
       case CLOCK_MONOTONIC:
-      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_MONOTONIC_RAW:
+
+         *res = (struct k_timespec64) {
+            .tv_sec = 0,
+            .tv_nsec = get_curr_clocksource()->res_ns,
+         };
+
+         break;
+
+      case CLOCK_REALTIME_COARSE:
+      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_PROCESS_CPUTIME_ID:
       case CLOCK_THREAD_CPUTIME_ID:
 
@@ -11,6 +11,7 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/elf_utils.h>
@@ -67,11 +68,11 @@ load_segment_by_copy(fs_handle *elf_h,
 
       if (!is_mapped(pdir, vaddr)) {
 
-         if (!(p = kzmalloc(PAGE_SIZE)))
+         if (!(p = alloc_zeroed_page()))
             return -ENOMEM;
 
          if ((rc = map_page(pdir, vaddr, LIN_VA_TO_PA(p), PAGING_FL_RWUS))) {
-            kfree2(p, PAGE_SIZE);
+            free_page(p);
             return (int)rc;
          }
 
@@ -294,7 +295,7 @@ static int
 alloc_and_map_stack_page(pdir_t *pdir, void *stack_top, u32 i)
 {
    int rc;
-   void *p = kzmalloc(PAGE_SIZE);
+   void *p = alloc_zeroed_page();
 
    if (!p)
       return -ENOMEM;
@@ -304,6 +305,9 @@ alloc_and_map_stack_page(pdir_t *pdir, void *stack_top, u32 i)
                  LIN_VA_TO_PA(p),
                  PAGING_FL_RW | PAGING_FL_US);
 
+   if (rc)
+      free_page(p);
+
    return rc;
 }
 
@@ -366,7 +370,6 @@ load_elf_program(const char *filepath,
    fs_handle elf_h = NULL;
    struct elf_headers eh;
    ulong brk = 0;
-   size_t count;
    int rc;
 
    pinfo->wrong_arch = false;
@@ -427,31 +430,18 @@ load_elf_program(const char *filepath,
    /*
     * Mapping the user stack.
     *
-    * In the "NOCOW" case, all the pages are pre-allocated.
-    * In the default case instead, most of the pages are zero-mapped and so,
-    * therefore, allocated on-demand. But, `USER_ARGS_PAGE_COUNT` pages are
-    * pre-allocated anyway.
+    * Only the `USER_ARGS_PAGE_COUNT` pages at the top, used for the args, are
+    * mapped here. The rest of the stack, up to USER_STACK_PAGES, is just
+    * reserved: it grows on demand, on faults below its current bottom (see
+    * user_stack_try_grow()). That makes exec() cheaper for the many processes
+    * that never use more than a few KB of stack.
     */
 
-   const size_t pre_allocated_pages =
-      MMAP_NO_COW ? USER_STACK_PAGES : USER_ARGS_PAGE_COUNT;
-
-   const size_t zero_mapped_pages = USER_STACK_PAGES - pre_allocated_pages;
-   const ulong stack_top = (USERMODE_VADDR_END - USER_STACK_PAGES * PAGE_SIZE);
-
-   count = map_zero_pages(pinfo->pdir,
-                          (void *)stack_top,
-                          zero_mapped_pages,
-                          PAGING_FL_US | PAGING_FL_RW);
-
-   if (count != zero_mapped_pages) {
-      unmap_pages(pinfo->pdir, (void *)stack_top, count, true);
-      rc = -ENOMEM;
-      goto out;
-   }
+   const ulong stack_bottom =
+      USERMODE_VADDR_END - USER_ARGS_PAGE_COUNT * PAGE_SIZE;
 
-   for (u32 i = zero_mapped_pages; i < USER_STACK_PAGES; i++) {
-      if ((rc = alloc_and_map_stack_page(pinfo->pdir, (void *)stack_top, i)))
+   for (u32 i = 0; i < USER_ARGS_PAGE_COUNT; i++) {
+      if ((rc = alloc_and_map_stack_page(pinfo->pdir, (void *)stack_bottom, i)))
          goto out;
    }
 
@@ -459,6 +449,7 @@ load_elf_program(const char *filepath,
    // Finally setting the output-params.
 
    pinfo->stack = (void *) USERMODE_STACK_MAX;
+   pinfo->stack_bottom = (void *) stack_bottom;
    pinfo->entry = (void *) eh.header->e_entry;
    pinfo->brk = (void *) brk;
 
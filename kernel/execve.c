@@ -123,7 +123,7 @@ save_cmdline(struct process *pi, const char *const *argv)
 
 static void
 execve_final_steps(struct task *ti,
-                   void *brk,
+                   struct elf_program_info *pinfo,
                    const char *const *argv,
                    regs_t *user_regs)
 {
@@ -133,8 +133,9 @@ execve_final_steps(struct task *ti,
    finalize_usermode_task_setup(ti, user_regs);
 
    /* Final steps */
-   pi->brk = brk;
-   pi->initial_brk = brk;
+   pi->brk = pinfo->brk;
+   pi->initial_brk = pinfo->brk;
+   pi->stack_bottom = pinfo->stack_bottom;
    pi->did_call_execve = true;
    ti->timer_ready = false;
 
@@ -361,7 +362,7 @@ do_execve_int(struct execve_ctx *ctx, const char *path, const char *const *argv)
    close_cloexec_handles(ti->pi);
    disable_preemption();
    {
-      execve_final_steps(ti, pinfo.brk, argv, &user_regs);
+      execve_final_steps(ti, &pinfo, argv, &user_regs);
       execve_do_task_switch(ctx, ti); /* this might NOT return */
    }
    enable_preemption();
@@ -333,7 +333,7 @@ void terminate_process(int exit_code, int term_sig)
    set_curr_pdir(get_kernel_pdir());
 
    if (!vforked)
-      pdir_destroy(pi->pdir);
+      mm_reaper_destroy_pdir(pi->pdir);
 
    switch_stack_free_mem_and_schedule();
 }
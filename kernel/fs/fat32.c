@@ -9,6 +9,8 @@
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/user.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/bintree.h>
 
 #include <dirent.h> // system header
 
@@ -32,22 +34,248 @@ fat_fs_walk_generic(struct fat_fs_device_data *d,
                      : fat_get_first_cluster(e));
 }
 
-STATIC ssize_t
-fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
+/*
+ * Cluster index
+ * ----------------
+ *
+ * The cluster chain of a file is a linked list stored in the FAT: finding the
+ * cluster at a given offset means walking the chain from its beginning, which
+ * costs O(file size). Because our FAT ramdisks are read-only, the chains never
+ * change: so, the first time a file is accessed at an arbitrary offset, we walk
+ * its chain just once, compressing it into a sorted array of extents (runs of
+ * consecutive clusters). After that, mapping an offset to a cluster is just a
+ * binary search. On our ramdisks, files are typically contiguous: their index
+ * is made by a single extent.
+ *
+ * The indexes are kept, by first cluster, until the file system is unmounted.
+ */
+
+struct fat_extent {
+
+   u32 idx;       /* index in the file of the extent's first cluster */
+   u32 clu;       /* the extent's first cluster */
+};
+
+struct fat_clu_index {
+
+   struct bintree_node node;
+   ulong first_clu;              /* first cluster of the file (the key) */
+   u32 count;                    /* number of extents */
+   struct fat_extent *extents;
+};
+
+static u32
+fat_get_clusters_count(struct fat_fs_device_data *d, struct fat_entry *e)
+{
+   const u32 fsize = e->DIR_FileSize;
+   return fsize / d->cluster_size + !!(fsize % d->cluster_size);
+}
+
+/*
+ * Walk the first `nclu` clusters of the chain starting at `clu`, counting its
+ * extents and, when `ext` is not NULL, storing them there.
+ */
+static u32
+fat_walk_extents(struct fat_fs_device_data *d,
+                 u32 clu,
+                 u32 nclu,
+                 struct fat_extent *ext)
+{
+   u32 count = 0;
+   u32 prev = 0;
+
+   for (u32 idx = 0; idx < nclu; idx++) {
+
+      if (fat_is_end_of_clusterchain(d->type, clu))
+         break;
+
+      // we do not expect BAD CLUSTERS
+      ASSERT(!fat_is_bad_cluster(d->type, clu));
+
+      if (!idx || clu != prev + 1) {
+
+         if (ext)
+            ext[count] = (struct fat_extent) { .idx = idx, .clu = clu };
+
+         count++;
+      }
+
+      prev = clu;
+      clu = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+   }
+
+   return count;
+}
+
+static void
+fat_destroy_clu_index(struct fat_clu_index *ci)
+{
+   kfree_array_obj(ci->extents, struct fat_extent, ci->count);
+   kfree_obj(ci, struct fat_clu_index);
+}
+
+static struct fat_clu_index *
+fat_build_clu_index(struct fat_fs_device_data *d, struct fat_entry *e)
+{
+   const u32 first_clu = fat_get_first_cluster(e);
+   const u32 nclu = fat_get_clusters_count(d, e);
+   struct fat_clu_index *ci;
+   u32 count;
+
+   count = fat_walk_extents(d, first_clu, nclu, NULL);
+   ASSERT(count > 0);
+
+   if (!(ci = kalloc_obj(struct fat_clu_index)))
+      return NULL;
+
+   if (!(ci->extents = kalloc_array_obj(struct fat_extent, count))) {
+      kfree_obj(ci, struct fat_clu_index);
+      return NULL;
+   }
+
+   bintree_node_init(&ci->node);
+   ci->first_clu = first_clu;
+   ci->count = count;
+   fat_walk_extents(d, first_clu, nclu, ci->extents);
+   return ci;
+}
+
+/* Get the cluster index of the file `e`, building it if necessary */
+static struct fat_clu_index *
+fat_get_clu_index(struct fat_fs_device_data *d, struct fat_entry *e)
+{
+   const ulong first_clu = fat_get_first_cluster(e);
+   struct fat_clu_index *ci, *new_ci;
+
+   disable_preemption();
+   {
+      ci = bintree_find_ptr(d->clu_indexes,
+                            first_clu,
+                            struct fat_clu_index,
+                            node,
+                            first_clu);
+   }
+   enable_preemption();
+
+   if (ci)
+      return ci;
+
+   /* Walk the chain with preemption enabled, as it might take a while */
+   if (!(new_ci = fat_build_clu_index(d, e)))
+      return NULL;
+
+   disable_preemption();
+   {
+      /* Another task might have built the same index in the meanwhile */
+      ci = bintree_find_ptr(d->clu_indexes,
+                            first_clu,
+                            struct fat_clu_index,
+                            node,
+                            first_clu);
+
+      if (!ci) {
+
+         bintree_insert_ptr(&d->clu_indexes,
+                            new_ci,
+                            struct fat_clu_index,
+                            node,
+                            first_clu);
+
+         ci = new_ci;
+         new_ci = NULL;
+      }
+   }
+   enable_preemption();
+
+   if (new_ci)
+      fat_destroy_clu_index(new_ci);
+
+   return ci;
+}
+
+/* Slow path for fat_get_cluster_at(), used only when out of memory */
+static u32
+fat_walk_to_cluster(struct fat_fs_device_data *d, struct fat_entry *e, u32 idx)
+{
+   u32 clu = fat_get_first_cluster(e);
+
+   for (; idx > 0; idx--) {
+
+      clu = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+
+      ASSERT(!fat_is_end_of_clusterchain(d->type, clu));
+      ASSERT(!fat_is_bad_cluster(d->type, clu));
+   }
+
+   return clu;
+}
+
+/*
+ * Return the cluster containing the offset `pos` of the file `e`. The caller
+ * must check that `pos` is less than the size of the file.
+ */
+static u32
+fat_get_cluster_at(struct fat_fs_device_data *d, struct fat_entry *e, offt pos)
+{
+   const u32 idx = (u32)(pos / (offt)d->cluster_size);
+   struct fat_clu_index *ci;
+   struct fat_extent *ext;
+   u32 lo, hi;
+
+   ASSERT(pos < (offt)e->DIR_FileSize);
+
+   if (!idx)
+      return fat_get_first_cluster(e);
+
+   if (!(ci = fat_get_clu_index(d, e)))
+      return fat_walk_to_cluster(d, e, idx);
+
+   /* Binary search of the last extent starting at or before `idx` */
+   lo = 0;
+   hi = ci->count;
+
+   while (hi - lo > 1) {
+
+      const u32 mid = lo + (hi - lo) / 2;
+
+      if (ci->extents[mid].idx <= idx)
+         lo = mid;
+      else
+         hi = mid;
+   }
+
+   ext = &ci->extents[lo];
+   return ext->clu + (idx - ext->idx);
+}
+
+static void
+fat_destroy_all_clu_indexes(struct fat_fs_device_data *d)
+{
+   struct fat_clu_index *ci;
+
+   while ((ci = bintree_get_first_obj(d->clu_indexes,
+                                      struct fat_clu_index,
+                                      node)))
+   {
+      bintree_remove_ptr(&d->clu_indexes,
+                         ci,
+                         struct fat_clu_index,
+                         node,
+                         first_clu);
+
+      fat_destroy_clu_index(ci);
+   }
+}
+
+static ssize_t
+fat_read_int(fs_handle handle, char *buf, size_t bufsize, offt *pos, bool user)
 {
    struct fatfs_handle *h = (struct fatfs_handle *) handle;
    struct fat_fs_device_data *d = h->fs->device_data;
    offt fsize = (offt)h->e->DIR_FileSize;
    offt written_to_buf = 0;
-
-   if (pos != &h->h_fpos) {
-
-      /*
-       * We don't support pread() for this filesystem, at the moment.
-       * TODO: make fat32 support pread64().
-       */
-      return -EPERM;
-   }
+   u32 *clu_ref = &h->curr_cluster;
+   u32 pread_clu;
 
    if (h->e->directory)
       return -EISDIR;
@@ -61,9 +289,19 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
       return 0;
    }
 
+   if (pos != &h->h_fpos) {
+
+      /*
+       * pread(): start from the cluster at `pos`, found with the cluster
+       * index, and leave the handle's `curr_cluster` untouched.
+       */
+      pread_clu = fat_get_cluster_at(d, h->e, *pos);
+      clu_ref = &pread_clu;
+   }
+
    do {
 
-      char *data = fat_get_pointer_to_cluster_data(d->hdr, h->curr_cluster);
+      char *data = fat_get_pointer_to_cluster_data(d->hdr, *clu_ref);
 
       const offt file_rem       = fsize - *pos;
       const offt buf_rem        = (offt)bufsize - written_to_buf;
@@ -73,7 +311,21 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
 
       ASSERT(to_read >= 0);
 
-      memcpy(buf + written_to_buf, data + cluster_off, (size_t)to_read);
+      if (user) {
+
+         if (copy_to_user(buf + written_to_buf,
+                          data + cluster_off,
+                          (size_t)to_read) < 0)
+         {
+            /* Stop here: `pos` and `*clu_ref` are still consistent */
+            return written_to_buf ? (ssize_t)written_to_buf : -EFAULT;
+         }
+
+      } else {
+
+         memcpy(buf + written_to_buf, data + cluster_off, (size_t)to_read);
+      }
+
       written_to_buf += to_read;
       *pos += to_read;
 
@@ -88,7 +340,7 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
       }
 
       // find the next cluster
-      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster);
+      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, *clu_ref);
 
       if (fat_is_end_of_clusterchain(d->type, fatval)) {
          ASSERT(*pos == fsize);
@@ -98,73 +350,121 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
       // we do not expect BAD CLUSTERS
       ASSERT(!fat_is_bad_cluster(d->type, fatval));
 
-      h->curr_cluster = fatval; // go reading the new cluster in the chain.
+      *clu_ref = fatval; // go reading the new cluster in the chain.
 
    } while (true);
 
    return (ssize_t)written_to_buf;
 }
 
+STATIC ssize_t
+fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
+{
+   return fat_read_int(handle, buf, bufsize, pos, false);
+}
 
-STATIC int
-fat_rewind(fs_handle handle)
+static ssize_t
+fat_read_user(fs_handle handle, char *u_buf, size_t bufsize, offt *pos)
 {
-   struct fatfs_handle *h = (struct fatfs_handle *) handle;
-   h->h_fpos = 0;
-   h->curr_cluster = fat_get_first_cluster(h->e);
-   return 0;
+   return fat_read_int(handle, u_buf, bufsize, pos, true);
 }
 
-STATIC offt
-fat_seek_forward(fs_handle handle, offt dist)
+static ssize_t
+fat_readv(fs_handle handle, const struct iovec *iov, int iovcnt, offt *pos)
 {
-   struct fatfs_handle *h = (struct fatfs_handle *) handle;
-   struct fat_fs_device_data *d = h->fs->device_data;
-   offt fsize = (offt)h->e->DIR_FileSize;
-   offt moved_distance = 0;
+   ssize_t ret = 0;
+   ssize_t rc;
 
-   if (dist == 0)
-      return h->h_fpos;
+   for (int i = 0; i < iovcnt; i++) {
 
-   if (h->h_fpos + dist > fsize) {
-      /* Allow, like Linux does, to seek past the end of a file. */
-      h->h_fpos += dist;
-      h->curr_cluster = (u32) -1; /* invalid cluster */
-      return (offt) h->h_fpos;
-   }
+      rc = fat_read_int(handle, iov[i].iov_base, iov[i].iov_len, pos, true);
 
-   do {
+      if (rc < 0) {
 
-      const offt file_rem       = fsize - h->h_fpos;
-      const offt dist_rem       = dist - moved_distance;
-      const offt cluster_off    = h->h_fpos % (offt)d->cluster_size;
-      const offt cluster_rem    = (offt)d->cluster_size - cluster_off;
-      const offt to_move        = MIN3(cluster_rem, dist_rem, file_rem);
+         if (!ret)
+            ret = rc;
 
-      ASSERT(to_move >= 0);
+         break;
+      }
 
-      moved_distance += to_move;
-      h->h_fpos += to_move;
+      ret += rc;
 
-      if (to_move < cluster_rem)
+      if (rc < (ssize_t)iov[i].iov_len)
          break;
+   }
 
-      // find the next cluster
-      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster);
+   return ret;
+}
 
-      if (fat_is_end_of_clusterchain(d->type, fatval)) {
-         ASSERT(h->h_fpos == fsize);
-         break;
-      }
+/*
+ * Lend to vfs_splice() the data at `pos`, up to the end of its cluster. The
+ * ramdisk is read-only and it cannot be unmounted while we have open handles,
+ * so pointing directly to the cluster's data is always safe.
+ */
+static int
+fat_splice_read(fs_handle handle,
+                offt pos,
+                size_t len,
+                struct vfs_splice_buf *sb)
+{
+   struct fatfs_handle *h = (struct fatfs_handle *) handle;
+   struct fat_fs_device_data *d = h->fs->device_data;
+   const offt fsize = (offt)h->e->DIR_FileSize;
+   offt cluster_off, to_read;
+   char *data;
+   u32 clu;
 
-      // we do not expect BAD CLUSTERS
-      ASSERT(!fat_is_bad_cluster(d->type, fatval));
+   if (h->e->directory)
+      return -EISDIR;
 
-      h->curr_cluster = fatval; // go reading the new cluster in the chain.
+   if (pos >= fsize)
+      return 0;
 
-   } while (true);
+   /*
+    * At the file position, `curr_cluster` already tells us where we are.
+    * Otherwise, we have to look in the cluster index.
+    */
+   clu = pos == h->h_fpos
+      ? h->curr_cluster
+      : fat_get_cluster_at(d, h->e, pos);
+
+   data = fat_get_pointer_to_cluster_data(d->hdr, clu);
+   cluster_off = pos % (offt)d->cluster_size;
+   to_read = MIN3((offt)d->cluster_size - cluster_off, (offt)len, fsize - pos);
+
+   *sb = (struct vfs_splice_buf) {
+      .data = data + cluster_off,
+      .len = (size_t)to_read,
+      .ref = NULL,
+   };
 
-   return (offt)h->h_fpos;
+   return (int)to_read;
+}
+
+
+/*
+ * Move the file position to `pos`. Unless the new position is in the same
+ * cluster as the old one, get the new `curr_cluster` from the cluster index.
+ */
+static offt
+fat_set_pos(struct fatfs_handle *h, offt pos)
+{
+   struct fat_fs_device_data *d = h->fs->device_data;
+   const offt fsize = (offt)h->e->DIR_FileSize;
+   const offt cs = (offt)d->cluster_size;
+
+   if (pos >= fsize) {
+
+      /* Allow, like Linux does, to seek past the end of a file. */
+      h->curr_cluster = (u32) -1; /* invalid cluster */
+
+   } else if (h->h_fpos >= fsize || pos / cs != h->h_fpos / cs) {
+
+      h->curr_cluster = fat_get_cluster_at(d, h->e, pos);
+   }
+
+   h->h_fpos = pos;
+   return h->h_fpos;
 }
 
 struct fat_count_dirents_ctx {
@@ -220,6 +520,7 @@ STATIC offt
 fat_seek(fs_handle handle, offt off, int whence)
 {
    struct fatfs_handle *fh = handle;
+   offt new_pos;
 
    if (fh->e->directory) {
 
@@ -229,51 +530,28 @@ fat_seek(fs_handle handle, offt off, int whence)
       return fat_seek_dir(fh, off);
    }
 
-   offt curr_pos = fh->h_fpos;
-
    switch (whence) {
 
       case SEEK_SET:
-
-         if (off < 0)
-            return -EINVAL; /* invalid negative offset */
-
-         fat_rewind(handle);
-         break;
-
-      case SEEK_END:
-
-         if (off >= 0)
-            break;
-
-         struct fatfs_handle *h = (struct fatfs_handle *) handle;
-         off = (offt) h->e->DIR_FileSize + off;
-
-         if (off < 0)
-            return -EINVAL;
-
-         fat_rewind(handle);
+         new_pos = off;
          break;
 
       case SEEK_CUR:
+         new_pos = fh->h_fpos + off;
+         break;
 
-         if (off < 0) {
-
-            off = curr_pos + off;
-
-            if (off < 0)
-               return -EINVAL;
-
-            fat_rewind(handle);
-         }
-
+      case SEEK_END:
+         new_pos = (offt)fh->e->DIR_FileSize + off;
          break;
 
       default:
          return -EINVAL;
    }
 
-   return fat_seek_forward(handle, off);
+   if (new_pos < 0)
+      return -EINVAL; /* invalid negative offset */
+
+   return fat_set_pos(fh, new_pos);
 }
 
 struct datetime
@@ -461,6 +739,9 @@ STATIC int fat_ioctl(fs_handle h, ulong request, void *arg)
 static const struct file_ops static_ops_fat =
 {
    .read = fat_read,
+   .read_user = fat_read_user,
+   .readv = fat_readv,
+   .splice_read = fat_splice_read,
    .seek = fat_seek,
    .write = fat_write,
    .ioctl = fat_ioctl,
@@ -638,7 +919,7 @@ struct mnt_fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
    fs = create_fs_obj("fat",
                       &static_fsops_fat,
                       d,
-                      flags | VFS_FS_RQ_DE_SKIP);
+                      flags | VFS_FS_RQ_DE_SKIP | VFS_FS_DCACHE);
 
    if (!fs) {
       kfree_obj(d, struct fat_fs_device_data);
@@ -653,6 +934,7 @@ struct mnt_fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
 
 void fat_umount_ramdisk(struct mnt_fs *fs)
 {
+   fat_destroy_all_clu_indexes(fs->device_data);
    kfree_obj(fs->device_data, struct fat_fs_device_data);
    destory_fs_obj(fs);
 }
@@ -109,8 +109,8 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (fh->e->directory)
       return -EACCES;
 
-   if (flags & VFS_MM_DONT_MMAP)
-      return 0;
+   if (flags & (VFS_MM_DONT_MMAP | VFS_MM_PREFAULT))
+      return 0; /* NOTE: our mappings are always fully mapped */
 
    clu = fat_get_first_cluster(fh->e);
 
@@ -19,6 +19,8 @@ struct vfs_resolve_int_ctx {
    int ss;                                       /* stack size */
    bool exlock;                                  /* true -> use exlock,
                                                     false -> use shlock */
+   bool no_pcache;                               /* true -> the path went
+                                                    through a non-cached FS */
 
    const char *orig_paths[RESOLVE_STACK_SIZE];   /* original paths stack */
    struct vfs_path paths[RESOLVE_STACK_SIZE];    /* vfs paths stack */
@@ -174,8 +174,6 @@ int sys_mkdir(const char *u_path, mode_t mode)
 
 int sys_read(int fd, void *u_buf, size_t count)
 {
-   int ret;
-   struct task *curr = get_curr_task();
    struct fs_handle_base *h;
 
    if (!(h = get_fs_handle(fd)))
@@ -195,118 +193,234 @@ int sys_read(int fd, void *u_buf, size_t count)
     */
 
    count = MIN(count, (size_t)INT32_MAX);
+   return (int)vfs_read_user(h, u_buf, count);
+}
 
-   if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
+int sys_write(int fd, const void *u_buf, size_t count)
+{
+   struct fs_handle_base *h;
 
-      ret = (int) vfs_read(h, u_buf, count);
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
 
-   } else {
+   count = MIN(count, (size_t)INT32_MAX);
+   return (int)vfs_write_user(h, u_buf, count);
+}
 
-      count = MIN(count, IO_COPYBUF_SIZE);
-      ret = (int) vfs_read(h, curr->io_copybuf, count);
+int sys_pread64(int fd, void *u_buf, size_t count, s64 off)
+{
+   struct fs_handle_base *h;
 
-      if (ret > 0) {
-         if (copy_to_user(u_buf, curr->io_copybuf, (size_t)ret) < 0) {
-            // Do we have to rewind the stream in this case? I don't think so.
-            ret = -EFAULT;
-         }
-      }
-   }
+   if (off < 0 || off > OFFT_MAX)
+      return -EINVAL;
 
-   return ret;
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
+
+   count = MIN(count, (size_t)INT32_MAX);
+   return (int)vfs_pread_user(h, u_buf, count, (offt)off);
 }
 
-int sys_write(int fd, const void *u_buf, size_t count)
+int sys_pwrite64(int fd, const void *u_buf, size_t count, s64 off)
 {
-   struct task *curr = get_curr_task();
    struct fs_handle_base *h;
-   int ret;
+
+   if (off < 0 || off > OFFT_MAX)
+      return -EINVAL;
 
    if (!(h = get_fs_handle(fd)))
       return -EBADF;
 
    count = MIN(count, (size_t)INT32_MAX);
+   return (int)vfs_pwrite_user(h, u_buf, count, (offt)off);
+}
+
+#ifndef SPLICE_F_MOVE
+   #define SPLICE_F_MOVE          1
+   #define SPLICE_F_NONBLOCK      2
+   #define SPLICE_F_MORE          4
+   #define SPLICE_F_GIFT          8
+#endif
+
+#define SPLICE_F_ALL                                                       \
+   (SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)
+
+static int do_sendfile(int out_fd, int in_fd, offt *off, size_t count)
+{
+   struct fs_handle_base *in, *out;
+
+   if (!(in = get_fs_handle(in_fd)) || !(out = get_fs_handle(out_fd)))
+      return -EBADF;
+
+   if (!in->fops->seek)
+      return -EINVAL; /* in_fd must be a regular (seekable) file */
+
+   if (out->fl_flags & O_APPEND)
+      return -EINVAL;
+
+   count = MIN(count, (size_t)INT32_MAX);
+   return (int)vfs_splice(in, off, out, NULL, count);
+}
+
+int sys_sendfile(int out_fd, int in_fd, long *u_off, size_t count)
+{
+   long off;
+   offt pos;
+   int rc;
+
+   if (!u_off)
+      return do_sendfile(out_fd, in_fd, NULL, count);
+
+   if (copy_from_user(&off, u_off, sizeof(off)))
+      return -EFAULT;
 
-   if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
+   if (off < 0)
+      return -EINVAL;
 
-      ret = (int)vfs_write(h, (void *)u_buf, count);
+   /* The final offset must fit in a long */
+   pos = (offt)off;
+   count = MIN(count, (size_t)(LONG_MAX - off));
 
-   } else {
+   if ((rc = do_sendfile(out_fd, in_fd, &pos, count)) > 0) {
 
-      count = MIN(count, IO_COPYBUF_SIZE);
+      off = (long)pos;
 
-      if (!copy_from_user(curr->io_copybuf, u_buf, count))
-         ret = (int)vfs_write(h, (char *)curr->io_copybuf, count);
-      else
-         ret = -EFAULT;
+      if (copy_to_user(u_off, &off, sizeof(off)))
+         return -EFAULT;
    }
 
-   return ret;
+   return rc;
 }
 
-int sys_pread64(int fd, void *u_buf, size_t count, s64 off)
+int sys_sendfile64(int out_fd, int in_fd, s64 *u_off, size_t count)
 {
-   int ret;
-   struct task *curr = get_curr_task();
-   struct fs_handle_base *h;
+   s64 off;
+   offt pos;
+   int rc;
+
+   if (!u_off)
+      return do_sendfile(out_fd, in_fd, NULL, count);
+
+   if (copy_from_user(&off, u_off, sizeof(off)))
+      return -EFAULT;
 
    if (off < 0 || off > OFFT_MAX)
       return -EINVAL;
 
-   if (!(h = get_fs_handle(fd)))
-      return -EBADF;
+   pos = (offt)off;
 
-   count = MIN(count, (size_t)INT32_MAX);
+   if ((rc = do_sendfile(out_fd, in_fd, &pos, count)) > 0) {
 
-   if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
+      off = (s64)pos;
 
-      ret = (int) vfs_pread(h, u_buf, count, (offt)off);
+      if (copy_to_user(u_off, &off, sizeof(off)))
+         return -EFAULT;
+   }
 
-   } else {
+   return rc;
+}
 
-      count = MIN(count, IO_COPYBUF_SIZE);
-      ret = (int) vfs_pread(h, curr->io_copybuf, count, (offt)off);
+/*
+ * Read the optional offset of one side of splice(), which is allowed only
+ * when that side is not a pipe.
+ */
+static int
+splice_get_off(struct fs_handle_base *h, s64 *u_off, offt *off, offt **off_ptr)
+{
+   s64 val;
 
-      if (ret > 0) {
-         if (copy_to_user(u_buf, curr->io_copybuf, (size_t)ret)) {
-            // Do we have to rewind the stream in this case? I don't think so.
-            ret = -EFAULT;
-         }
-      }
-   }
+   *off_ptr = NULL;
 
-   return ret;
+   if (!u_off)
+      return 0;
+
+   if (is_pipe(h) || !h->fops->seek)
+      return -ESPIPE;
+
+   if (copy_from_user(&val, u_off, sizeof(val)))
+      return -EFAULT;
+
+   if (val < 0 || val > OFFT_MAX)
+      return -EINVAL;
+
+   *off = (offt)val;
+   *off_ptr = off;
+   return 0;
 }
 
-int sys_pwrite64(int fd, const void *u_buf, size_t count, s64 off)
+static int
+splice_put_off(s64 *u_off, offt *off_ptr)
 {
-   struct task *curr = get_curr_task();
-   struct fs_handle_base *h;
-   int ret;
+   s64 val;
 
-   if (off < 0 || off > OFFT_MAX)
+   if (!off_ptr)
+      return 0;
+
+   val = (s64)*off_ptr;
+   return copy_to_user(u_off, &val, sizeof(val)) ? -EFAULT : 0;
+}
+
+/*
+ * NOTE: unlike Linux, splicing from a pipe to another pipe is not supported:
+ * without a way to give back to the input pipe the data that the output pipe
+ * could not take, that would risk to lose data.
+ */
+int sys_splice(int fd_in,
+               s64 *u_off_in,
+               int fd_out,
+               s64 *u_off_out,
+               size_t len,
+               u32 flags)
+{
+   struct fs_handle_base *in, *out;
+   offt off_in, off_out;
+   offt *off_in_ptr, *off_out_ptr;
+   bool in_pipe, out_pipe;
+   int rc;
+
+   if (flags & ~SPLICE_F_ALL)
       return -EINVAL;
 
-   if (!(h = get_fs_handle(fd)))
+   if (!(in = get_fs_handle(fd_in)) || !(out = get_fs_handle(fd_out)))
       return -EBADF;
 
-   count = MIN(count, (size_t)INT32_MAX);
+   in_pipe = is_pipe(in);
+   out_pipe = is_pipe(out);
+
+   if (in_pipe == out_pipe)
+      return -EINVAL; /* exactly one of the two must be a pipe */
+
+   if (out->fl_flags & O_APPEND)
+      return -EINVAL;
 
-   if (h->spec_flags & VFS_SPFL_NO_USER_COPY) {
+   if ((rc = splice_get_off(in, u_off_in, &off_in, &off_in_ptr)))
+      return rc;
 
-      ret = (int)vfs_pwrite(h, (void *)u_buf, count, (offt)off);
+   if ((rc = splice_get_off(out, u_off_out, &off_out, &off_out_ptr)))
+      return rc;
 
-   } else {
+   if (flags & SPLICE_F_NONBLOCK) {
 
-      count = MIN(count, IO_COPYBUF_SIZE);
+      if (in_pipe && !vfs_read_ready(in))
+         return -EAGAIN;
 
-      if (!copy_from_user(curr->io_copybuf, u_buf, count))
-         ret = (int)vfs_pwrite(h, (char *)curr->io_copybuf, count, (offt)off);
-      else
-         ret = -EFAULT;
+      if (out_pipe && !vfs_write_ready(out))
+         return -EAGAIN;
    }
 
-   return ret;
+   len = MIN(len, (size_t)INT32_MAX);
+   rc = (int)vfs_splice(in, off_in_ptr, out, off_out_ptr, len);
+
+   if (rc > 0) {
+
+      if (splice_put_off(u_off_in, off_in_ptr))
+         return -EFAULT;
+
+      if (splice_put_off(u_off_out, off_out_ptr))
+         return -EFAULT;
+   }
+
+   return rc;
 }
 
 int sys_ioctl(int fd, ulong request, void *argp)
@@ -334,12 +448,16 @@ static bool iov_len_overflow(const struct iovec *iov, int iovcnt)
    return false;
 }
 
-int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
+/*
+ * Copy the user iovec array to the per-task args_copybuf. The buffers it
+ * points to are still in the user space.
+ */
+static int
+get_user_iov(const struct iovec *u_iov, int u_iovcnt, struct iovec **iov_ref)
 {
    struct task *curr = get_curr_task();
    struct iovec *iov = (void *)curr->args_copybuf;
    const u32 iovcnt = (u32) u_iovcnt;
-   fs_handle handle;
 
    if (u_iovcnt <= 0)
       return -EINVAL;
@@ -353,6 +471,40 @@ int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
    if (iov_len_overflow(iov, u_iovcnt))
       return -EINVAL;
 
+   *iov_ref = iov;
+   return 0;
+}
+
+/*
+ * The offset of preadv() and friends is always passed split in two longs,
+ * even on 64-bit architectures, where `pos_l` alone holds the whole value.
+ */
+static inline s64 pos_from_hilo(ulong pos_h, ulong pos_l)
+{
+   return (s64)((((u64)pos_h << (NBITS / 2)) << (NBITS / 2)) | pos_l);
+}
+
+#ifndef RWF_HIPRI
+   #define RWF_HIPRI              1
+   #define RWF_DSYNC              2
+   #define RWF_SYNC               4
+#endif
+
+/*
+ * The preadv2() and pwritev2() flags we accept: all of them are just hints for
+ * Tilck, as its file systems do not have any I/O queue and do not cache data.
+ */
+#define RWF_SUPPORTED            (RWF_HIPRI | RWF_DSYNC | RWF_SYNC)
+
+int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
+{
+   struct iovec *iov;
+   fs_handle handle;
+   int rc;
+
+   if ((rc = get_user_iov(u_iov, u_iovcnt, &iov)))
+      return rc;
+
    if (!(handle = get_fs_handle(fd)))
       return -EBADF;
 
@@ -361,27 +513,104 @@ int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
 
 int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
 {
-   struct task *curr = get_curr_task();
-   struct iovec *iov = (void *)curr->args_copybuf;
-   const u32 iovcnt = (u32) u_iovcnt;
+   struct iovec *iov;
    fs_handle handle;
+   int rc;
 
-   if (u_iovcnt <= 0)
+   if ((rc = get_user_iov(u_iov, u_iovcnt, &iov)))
+      return rc;
+
+   if (!(handle = get_fs_handle(fd)))
+      return -EBADF;
+
+   return (int)vfs_readv(handle, iov, u_iovcnt);
+}
+
+int sys_preadv(int fd,
+               const struct iovec *u_iov,
+               int u_iovcnt,
+               ulong pos_l,
+               ulong pos_h)
+{
+   /* Only preadv2() accepts -1 as offset, meaning: use the file position */
+   if (pos_from_hilo(pos_h, pos_l) < 0)
       return -EINVAL;
 
-   if (sizeof(struct iovec) * iovcnt > ARGS_COPYBUF_SIZE)
+   return sys_preadv2(fd, u_iov, u_iovcnt, pos_l, pos_h, 0);
+}
+
+int sys_pwritev(int fd,
+                const struct iovec *u_iov,
+                int u_iovcnt,
+                ulong pos_l,
+                ulong pos_h)
+{
+   /* Only pwritev2() accepts -1 as offset, meaning: use the file position */
+   if (pos_from_hilo(pos_h, pos_l) < 0)
       return -EINVAL;
 
-   if (copy_from_user(iov, u_iov, sizeof(struct iovec) * iovcnt))
-      return -EFAULT;
+   return sys_pwritev2(fd, u_iov, u_iovcnt, pos_l, pos_h, 0);
+}
 
-   if (iov_len_overflow(iov, u_iovcnt))
+int sys_preadv2(int fd,
+                const struct iovec *u_iov,
+                int u_iovcnt,
+                ulong pos_l,
+                ulong pos_h,
+                int flags)
+{
+   const s64 off = pos_from_hilo(pos_h, pos_l);
+   struct iovec *iov;
+   fs_handle handle;
+   int rc;
+
+   if (flags & ~RWF_SUPPORTED)
+      return -EOPNOTSUPP;
+
+   if (off < -1 || off > OFFT_MAX)
       return -EINVAL;
 
+   if ((rc = get_user_iov(u_iov, u_iovcnt, &iov)))
+      return rc;
+
    if (!(handle = get_fs_handle(fd)))
       return -EBADF;
 
-   return (int)vfs_readv(handle, iov, u_iovcnt);
+   /* With preadv2(), an offset of -1 means: use the file position */
+   if (off == -1)
+      return (int)vfs_readv(handle, iov, u_iovcnt);
+
+   return (int)vfs_preadv(handle, iov, u_iovcnt, (offt)off);
+}
+
+int sys_pwritev2(int fd,
+                 const struct iovec *u_iov,
+                 int u_iovcnt,
+                 ulong pos_l,
+                 ulong pos_h,
+                 int flags)
+{
+   const s64 off = pos_from_hilo(pos_h, pos_l);
+   struct iovec *iov;
+   fs_handle handle;
+   int rc;
+
+   if (flags & ~RWF_SUPPORTED)
+      return -EOPNOTSUPP;
+
+   if (off < -1 || off > OFFT_MAX)
+      return -EINVAL;
+
+   if ((rc = get_user_iov(u_iov, u_iovcnt, &iov)))
+      return rc;
+
+   if (!(handle = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (off == -1)
+      return (int)vfs_writev(handle, iov, u_iovcnt);
+
+   return (int)vfs_pwritev(handle, iov, u_iovcnt, (offt)off);
 }
 
 static int
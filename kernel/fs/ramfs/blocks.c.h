@@ -1,16 +1,18 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+DEF_KMEM_CACHE(ramfs_block_cache, struct ramfs_block, NULL);
+
 static struct ramfs_block *ramfs_new_block(offt page)
 {
    struct ramfs_block *b;
 
    /* Allocate memory for the block object */
-   if (!(b = kalloc_obj(struct ramfs_block)))
+   if (!(b = kmem_cache_alloc(&ramfs_block_cache)))
       return NULL;
 
    /* Allocate block's data */
-   if (!(b->vaddr = kzmalloc(PAGE_SIZE))) {
-      kfree_obj(b, struct ramfs_block);
+   if (!(b->vaddr = alloc_zeroed_page())) {
+      kmem_cache_free(&ramfs_block_cache, b);
       return NULL;
    }
 
@@ -20,6 +22,7 @@ static struct ramfs_block *ramfs_new_block(offt page)
    /* Init the block object */
    bintree_node_init(&b->node);
    b->offset = page;
+   b->ref_count = 1;
    return b;
 }
 
@@ -29,10 +32,20 @@ static void ramfs_destroy_block(struct ramfs_block *b)
    release_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
 
    /* Free the memory pointed by this block */
-   kfree2(b->vaddr, PAGE_SIZE);
+   free_page(b->vaddr);
 
    /* Free the memory used by the block object itself */
-   kfree_obj(b, struct ramfs_block);
+   kmem_cache_free(&ramfs_block_cache, b);
+}
+
+/*
+ * Drop a reference to a block, destroying it if that was the last one. While
+ * a splice is using its page, a block can outlive its removal from the tree.
+ */
+static void ramfs_release_block(struct ramfs_block *b)
+{
+   if (!release_obj(b))
+      ramfs_destroy_block(b);
 }
 
 static void
@@ -5,6 +5,27 @@ static int ramfs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
    return generic_fs_munmap(um, vaddrp, len);
 }
 
+/*
+ * Prefault the page at `va` for the block `b`, unless it's already mapped.
+ * Holes read through a mapping are mapped to the zero page: if the block has
+ * been added later (e.g. by write()), replace the zero page with it.
+ */
+static int
+ramfs_prefault_block(pdir_t *pdir, void *va, struct ramfs_block *b, u32 fl)
+{
+   ulong pa;
+
+   if (!get_mapping2(pdir, va, &pa)) {
+
+      if (pa != KERNEL_VA_TO_PA(&zero_page))
+         return 0; /* already mapped */
+
+      unmap_page(pdir, va, false);
+   }
+
+   return map_page(pdir, va, LIN_VA_TO_PA(b->vaddr), fl);
+}
+
 static int
 ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
 {
@@ -14,7 +35,7 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    struct bintree_walk_ctx ctx;
    struct ramfs_block *b;
    u32 pg_flags;
-   int rc;
+   int rc = 0;
 
    const size_t off_begin = um->off;
    const size_t off_end = off_begin + um->len;
@@ -46,6 +67,18 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
       if ((size_t)b->offset >= off_end)
          break;
 
+      /* NOTE: the file might have holes, not backed by any block */
+      vaddr = um->vaddr + ((size_t)b->offset - off_begin);
+
+      if (flags & VFS_MM_PREFAULT) {
+
+         /* Just a hint: in case of failure, keep what we've mapped so far */
+         if ((rc = ramfs_prefault_block(pdir, (void *)vaddr, b, pg_flags)))
+            break;
+
+         continue;
+      }
+
       rc = map_page(pdir,
                     (void *)vaddr,
                     LIN_VA_TO_PA(b->vaddr),
@@ -54,18 +87,23 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
       if (rc) {
 
          /* mmap failed, we have to unmap the pages already mapped */
-         vaddr -= PAGE_SIZE;
-
-         for (; vaddr >= um->vaddr; vaddr -= PAGE_SIZE) {
-            unmap_page_permissive(pdir, (void *)vaddr, false);
+         for (ulong va = um->vaddr; va < vaddr; va += PAGE_SIZE) {
+            unmap_page_permissive(pdir, (void *)va, false);
          }
 
          return rc;
       }
-
-      vaddr += PAGE_SIZE;
    }
 
+   /*
+    * Blocks allocated in sequence are often physically contiguous: in that
+    * case, use 4-MB pages where possible.
+    */
+   collapse_to_big_pages(pdir, um->vaddrp, um->len >> PAGE_SHIFT);
+
+   if (flags & VFS_MM_PREFAULT)
+      return rc;
+
 register_mapping:
    if (!(flags & VFS_MM_DONT_REGISTER)) {
       list_add_tail(&i->mappings_list, &um->inode_node);
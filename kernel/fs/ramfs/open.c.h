@@ -6,6 +6,10 @@ static const struct file_ops static_ops_ramfs =
    .write = ramfs_write,
    .readv = ramfs_readv,
    .writev = ramfs_writev,
+   .read_user = ramfs_read_user,
+   .write_user = ramfs_write_user,
+   .splice_read = ramfs_splice_read,
+   .splice_release = ramfs_splice_release,
    .seek = ramfs_seek,
    .ioctl = ramfs_ioctl,
    .mmap = ramfs_mmap,
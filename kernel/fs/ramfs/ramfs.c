@@ -6,6 +6,7 @@
 #include <tilck/common/utils.h>
 
 #include <tilck/kernel/process.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/fs/flock.h>
 #include <tilck/kernel/test/vfs.h>
 
@@ -347,7 +348,10 @@ struct mnt_fs *ramfs_create(void)
    if (!(d = kzalloc_obj(struct ramfs_data)))
       return NULL;
 
-   fs = create_fs_obj("ramfs", &static_fsops_ramfs, d, VFS_FS_RW);
+   fs = create_fs_obj("ramfs",
+                      &static_fsops_ramfs,
+                      d,
+                      VFS_FS_RW | VFS_FS_DCACHE);
 
    if (!fs) {
       kfree_obj(d, struct ramfs_data);
@@ -22,6 +22,12 @@ struct ramfs_inode;
 
 struct ramfs_block {
 
+   /*
+    * One reference held by the inode's blocks tree, plus one for each
+    * vfs_splice() currently reading from the block's page.
+    */
+   REF_COUNTED_OBJECT;
+
    struct bintree_node node;
    offt offset;                  /* MUST BE divisible by PAGE_SIZE */
    void *vaddr;
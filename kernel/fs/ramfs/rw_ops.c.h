@@ -212,7 +212,7 @@ static int ramfs_inode_truncate(struct ramfs_inode *i, offt len)
                          node,
                          offset);
 
-      ramfs_destroy_block(b);
+      ramfs_release_block(b);
    }
 
    i->fsize = len;
@@ -248,8 +248,34 @@ static int ramfs_truncate(struct mnt_fs *fs, vfs_inode_ptr_t i, offt len)
    return ramfs_inode_truncate_safe(i, len, false);
 }
 
+/*
+ * Copy `len` bytes of the block `b` (or of a hole, when `b` is NULL) starting
+ * at `off` to `buf`, which is an user buffer when `user` is true.
+ */
+static int
+ramfs_copy_from_block(struct ramfs_block *b,
+                      offt off,
+                      char *buf,
+                      size_t len,
+                      bool user)
+{
+   if (user)
+      return copy_to_user(buf, b ? b->vaddr + off : zero_page + off, len);
+
+   if (b)
+      memcpy(buf, b->vaddr + off, len);
+   else
+      memset(buf, 0, len);
+
+   return 0;
+}
+
 static ssize_t
-ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
+ramfs_read_nolock(struct ramfs_handle *rh,
+                  char *buf,
+                  size_t len,
+                  offt *pos,
+                  bool user)
 {
    struct ramfs_inode *inode = rh->inode;
    offt tot_read = 0;
@@ -283,12 +309,14 @@ ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
                                node,
                                offset);
 
-      if (block) {
-         /* reading a regular block */
-         memcpy(buf + tot_read, block->vaddr + page_off, (size_t)to_read);
-      } else {
-         /* reading a hole */
-         memset(buf + tot_read, 0, (size_t)to_read);
+      /* NOTE: a NULL block means that we're reading a hole */
+      if (ramfs_copy_from_block(block, page_off,
+                                buf + tot_read, (size_t)to_read, user) < 0)
+      {
+         if (!tot_read)
+            return -EFAULT;
+
+         break;
       }
 
       tot_read += to_read;
@@ -306,18 +334,37 @@ static ssize_t ramfs_read(fs_handle h, char *buf, size_t len, offt *pos)
 
    ramfs_file_shlock(h);
    {
-      ret = ramfs_read_nolock(rh, buf, len, pos);
+      ret = ramfs_read_nolock(rh, buf, len, pos, false);
    }
    ramfs_file_shunlock(h);
    return ret;
 }
 
 static ssize_t
-ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
+ramfs_read_user(fs_handle h, char *u_buf, size_t len, offt *pos)
+{
+   struct ramfs_handle *rh = h;
+   ssize_t ret;
+
+   ramfs_file_shlock(h);
+   {
+      ret = ramfs_read_nolock(rh, u_buf, len, pos, true);
+   }
+   ramfs_file_shunlock(h);
+   return ret;
+}
+
+static ssize_t
+ramfs_write_nolock(struct ramfs_handle *rh,
+                   char *buf,
+                   size_t len,
+                   offt *pos,
+                   bool user)
 {
    struct ramfs_inode *inode = rh->inode;
    offt tot_written = 0;
    offt buf_rem = (offt)len;
+   bool fault = false;
 
    /* We can be sure it's a file because dirs cannot be open for writing */
    ASSERT(inode->type == VFS_FILE);
@@ -332,6 +379,7 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
       const offt page_off = *pos & (offt)OFFSET_IN_PAGE_MASK;
       const offt page_rem = (offt)PAGE_SIZE - page_off;
       const offt to_write = MIN(page_rem, buf_rem);
+      bool new_block = false;
 
       ASSERT(to_write > 0);
 
@@ -349,10 +397,32 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
          if (!(block = ramfs_new_block(page)))
             break;
 
-         ramfs_append_new_block(inode, block);
+         new_block = true;
       }
 
-      memcpy(block->vaddr + page_off, buf + tot_written, (size_t)to_write);
+      if (user) {
+
+         fault = copy_from_user(block->vaddr + page_off,
+                                buf + tot_written,
+                                (size_t)to_write) < 0;
+
+      } else {
+
+         memcpy(block->vaddr + page_off, buf + tot_written, (size_t)to_write);
+      }
+
+      if (fault) {
+
+         /* Don't leave behind a block past EOF */
+         if (new_block)
+            ramfs_destroy_block(block);
+
+         break;
+      }
+
+      if (new_block)
+         ramfs_append_new_block(inode, block);
+
       tot_written += to_write;
       buf_rem     -= to_write;
       *pos     += to_write;
@@ -362,7 +432,7 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
    }
 
    if (len > 0 && !tot_written)
-      return -ENOSPC;
+      return fault ? -EFAULT : -ENOSPC;
 
    return (ssize_t)tot_written;
 }
@@ -374,33 +444,109 @@ static ssize_t ramfs_write(fs_handle h, char *buf, size_t len, offt *pos)
 
    ramfs_file_exlock(h);
    {
-      ret = ramfs_write_nolock(rh, buf, len, pos);
+      ret = ramfs_write_nolock(rh, buf, len, pos, false);
+   }
+   ramfs_file_exunlock(h);
+   return ret;
+}
+
+static ssize_t
+ramfs_write_user(fs_handle h, char *u_buf, size_t len, offt *pos)
+{
+   struct ramfs_handle *rh = h;
+   ssize_t ret;
+
+   ramfs_file_exlock(h);
+   {
+      ret = ramfs_write_nolock(rh, u_buf, len, pos, true);
    }
    ramfs_file_exunlock(h);
    return ret;
 }
 
+/*
+ * Lend to vfs_splice() the data at `pos`, up to the end of its page. Instead
+ * of copying it, we retain the block, so that its page stays valid after we
+ * drop the lock, even if the file gets truncated in the meanwhile.
+ */
+static int
+ramfs_splice_read_nolock(struct ramfs_inode *inode,
+                         offt pos,
+                         size_t len,
+                         struct vfs_splice_buf *sb)
+{
+   struct ramfs_block *block;
+   const offt page_off = pos & (offt)OFFSET_IN_PAGE_MASK;
+   const offt page_rem = (offt)PAGE_SIZE - page_off;
+   const offt to_read = MIN3(page_rem, (offt)len, inode->fsize - pos);
+
+   if (pos >= inode->fsize || !to_read)
+      return 0;
+
+   block = bintree_find_ptr(inode->blocks_tree_root,
+                            pos & (offt)PAGE_MASK,
+                            struct ramfs_block,
+                            node,
+                            offset);
+
+   if (block)
+      retain_obj(block);
+
+   /* NOTE: a NULL block means that we're reading a hole */
+   *sb = (struct vfs_splice_buf) {
+      .data = block ? block->vaddr + page_off : zero_page + page_off,
+      .len = (size_t)to_read,
+      .ref = block,
+   };
+
+   return (int)to_read;
+}
+
+static int
+ramfs_splice_read(fs_handle h, offt pos, size_t len, struct vfs_splice_buf *sb)
+{
+   struct ramfs_handle *rh = h;
+   int rc;
+
+   if (rh->inode->type == VFS_DIR)
+      return -EISDIR;
+
+   ramfs_file_shlock(h);
+   {
+      rc = ramfs_splice_read_nolock(rh->inode, pos, len, sb);
+   }
+   ramfs_file_shunlock(h);
+   return rc;
+}
+
+static void
+ramfs_splice_release(fs_handle h, struct vfs_splice_buf *sb)
+{
+   if (sb->ref)
+      ramfs_release_block(sb->ref);
+}
+
 static ssize_t
-ramfs_readv_nolock(struct ramfs_handle *rh, const struct iovec *iov, int iovcnt)
+ramfs_readv_nolock(struct ramfs_handle *rh,
+                   const struct iovec *iov,
+                   int iovcnt,
+                   offt *pos)
 {
-   struct task *curr = get_curr_task();
    ssize_t ret = 0;
    ssize_t rc;
-   size_t len;
 
    for (int i = 0; i < iovcnt; i++) {
 
-      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
-      rc = ramfs_read_nolock(rh, curr->io_copybuf, len, &rh->h_fpos);
+      rc = ramfs_read_nolock(rh, iov[i].iov_base, iov[i].iov_len, pos, true);
 
       if (rc < 0) {
-         ret = rc;
+
+         if (!ret)
+            ret = rc;
+
          break;
       }
 
-      if (copy_to_user(iov[i].iov_base, curr->io_copybuf, len))
-         return -EFAULT;
-
       ret += rc;
 
       if (rc < (ssize_t)iov[i].iov_len)
@@ -411,38 +557,37 @@ ramfs_readv_nolock(struct ramfs_handle *rh, const struct iovec *iov, int iovcnt)
 }
 
 static ssize_t
-ramfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
+ramfs_readv(fs_handle h, const struct iovec *iov, int iovcnt, offt *pos)
 {
    struct ramfs_handle *rh = h;
    ssize_t ret;
 
    ramfs_file_shlock(h);
    {
-      ret = ramfs_readv_nolock(rh, iov, iovcnt);
+      ret = ramfs_readv_nolock(rh, iov, iovcnt, pos);
    }
    ramfs_file_shunlock(h);
    return ret;
 }
 
 static ssize_t
-ramfs_writev_nolock(struct ramfs_handle *h, const struct iovec *iov, int iovcnt)
+ramfs_writev_nolock(struct ramfs_handle *h,
+                    const struct iovec *iov,
+                    int iovcnt,
+                    offt *pos)
 {
-   struct task *curr = get_curr_task();
    ssize_t ret = 0;
    ssize_t rc;
-   size_t len;
 
    for (int i = 0; i < iovcnt; i++) {
 
-      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
+      rc = ramfs_write_nolock(h, iov[i].iov_base, iov[i].iov_len, pos, true);
 
-      if (copy_from_user(curr->io_copybuf, iov[i].iov_base, len))
-         return -EFAULT;
+      if (rc < 0) {
 
-      rc = ramfs_write_nolock(h, curr->io_copybuf, len, &h->h_fpos);
+         if (!ret)
+            ret = rc;
 
-      if (rc < 0) {
-         ret = rc;
          break;
       }
 
@@ -456,14 +601,14 @@ ramfs_writev_nolock(struct ramfs_handle *h, const struct iovec *iov, int iovcnt)
 }
 
 static ssize_t
-ramfs_writev(fs_handle h, const struct iovec *iov, int iovcnt)
+ramfs_writev(fs_handle h, const struct iovec *iov, int iovcnt, offt *pos)
 {
    struct ramfs_handle *rh = h;
    ssize_t ret;
 
    ramfs_file_exlock(h);
    {
-      ret = ramfs_writev_nolock(rh, iov, iovcnt);
+      ret = ramfs_writev_nolock(rh, iov, iovcnt, pos);
    }
    ramfs_file_exunlock(h);
    return ret;
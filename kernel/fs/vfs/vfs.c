@@ -15,6 +15,7 @@
 #include <dirent.h> // system header
 
 #include "../fs_int.h"
+#include "vfs_dcache.c.h"
 #include "vfs_mp.c.h"
 #include "vfs_locking.c.h"
 #include "vfs_resolve.c.h"
@@ -171,6 +172,112 @@ ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off)
    return hb->fops->write(h, buf, buf_size, &off);
 }
 
+/*
+ * Read into an user buffer. File systems supporting that copy the data straight
+ * to it, with their read_user() func. For the others, the data is staged
+ * through the per-task io_copybuf, at most IO_COPYBUF_SIZE bytes at a time.
+ */
+static ssize_t
+vfs_do_read_user(struct fs_handle_base *hb, void *u_buf, size_t len, offt *pos)
+{
+   const struct file_ops *fops = hb->fops;
+   void *buf = get_curr_task()->io_copybuf;
+   ssize_t rc;
+
+   if (!fops->read)
+      return -EBADF;
+
+   if ((hb->fl_flags & O_WRONLY) && !(hb->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
+
+   if (hb->spec_flags & VFS_SPFL_NO_USER_COPY)
+      return fops->read(hb, u_buf, len, pos);
+
+   if (fops->read_user)
+      return fops->read_user(hb, u_buf, len, pos);
+
+   len = MIN(len, IO_COPYBUF_SIZE);
+
+   if ((rc = fops->read(hb, buf, len, pos)) > 0) {
+      if (copy_to_user(u_buf, buf, (size_t)rc) < 0) {
+         // Do we have to rewind the stream in this case? I don't think so.
+         rc = -EFAULT;
+      }
+   }
+
+   return rc;
+}
+
+/* The write counterpart of vfs_do_read_user() */
+static ssize_t
+vfs_do_write_user(struct fs_handle_base *hb,
+                  const void *u_buf,
+                  size_t len,
+                  offt *pos)
+{
+   const struct file_ops *fops = hb->fops;
+   void *buf = get_curr_task()->io_copybuf;
+
+   if (!fops->write)
+      return -EBADF;
+
+   if (!(hb->fl_flags & (O_WRONLY | O_RDWR)))
+      return -EBADF; /* file not opened for writing */
+
+   if (hb->spec_flags & VFS_SPFL_NO_USER_COPY)
+      return fops->write(hb, (char *)u_buf, len, pos);
+
+   if (fops->write_user)
+      return fops->write_user(hb, (char *)u_buf, len, pos);
+
+   len = MIN(len, IO_COPYBUF_SIZE);
+
+   if (copy_from_user(buf, u_buf, len) < 0)
+      return -EFAULT;
+
+   return fops->write(hb, buf, len, pos);
+}
+
+ssize_t vfs_read_user(fs_handle h, void *u_buf, size_t len)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+   return vfs_do_read_user(hb, u_buf, len, &hb->h_fpos);
+}
+
+ssize_t vfs_write_user(fs_handle h, const void *u_buf, size_t len)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+   return vfs_do_write_user(hb, u_buf, len, &hb->h_fpos);
+}
+
+ssize_t vfs_pread_user(fs_handle h, void *u_buf, size_t len, offt off)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   if (!((struct fs_handle_base *)h)->fops->seek)
+      return -ESPIPE; /* pipes, ttys etc. have no offsets */
+
+   return vfs_do_read_user(h, u_buf, len, &off);
+}
+
+ssize_t vfs_pwrite_user(fs_handle h, const void *u_buf, size_t len, offt off)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   if (!((struct fs_handle_base *)h)->fops->seek)
+      return -ESPIPE;
+
+   return vfs_do_write_user(h, u_buf, len, &off);
+}
+
 offt vfs_seek(fs_handle h, offt off, int whence)
 {
    NO_TEST_ASSERT(is_preemption_enabled());
@@ -299,6 +406,7 @@ vfs_open_impl(struct mnt_fs *fs, struct vfs_path *p,
               fs_handle *out, int flags, mode_t mode)
 {
    const enum vfs_entry_type type = p->fs_path.type;
+   const bool creat = !p->fs_path.inode && (flags & O_CREAT);
    int rc;
 
    if (flags & O_DIRECTORY) {
@@ -309,6 +417,9 @@ vfs_open_impl(struct mnt_fs *fs, struct vfs_path *p,
    if ((rc = fs->fsops->open(p, out, flags, mode)))
       return rc;
 
+   if (creat)
+      vfs_dcache_invalidate(p);
+
    {
       struct fs_handle_base *hb = *out;
 
@@ -376,6 +487,8 @@ vfs_mkdir_impl(struct mnt_fs *fs,
                mode_t mode,
                ulong x, ulong y)
 {
+   int rc;
+
    if (!fs->fsops->mkdir)
       return -EPERM;
 
@@ -385,7 +498,11 @@ vfs_mkdir_impl(struct mnt_fs *fs,
    if (p->fs_path.inode)
       return -EEXIST;
 
-   return fs->fsops->mkdir(p, mode);
+   if ((rc = fs->fsops->mkdir(p, mode)))
+      return rc;
+
+   vfs_dcache_invalidate(p);
+   return 0;
 }
 
 int vfs_mkdir(const char *path, mode_t mode)
@@ -406,6 +523,8 @@ vfs_rmdir_impl(struct mnt_fs *fs,
                struct vfs_path *p,
                ulong u1, ulong u2, ulong u3)
 {
+   int rc;
+
    if (!fs->fsops->rmdir)
       return -EPERM;
 
@@ -415,7 +534,12 @@ vfs_rmdir_impl(struct mnt_fs *fs,
    if (!p->fs_path.inode)
       return -ENOENT;
 
-   return fs->fsops->rmdir(p);
+   if ((rc = fs->fsops->rmdir(p)))
+      return rc;
+
+   vfs_dcache_invalidate(p);
+   vfs_dcache_invalidate_dir(fs, p->fs_path.inode);
+   return 0;
 }
 
 int vfs_rmdir(const char *path)
@@ -434,6 +558,8 @@ vfs_unlink_impl(struct mnt_fs *fs,
                 struct vfs_path *p,
                 ulong u1, ulong u2, ulong u3)
 {
+   int rc;
+
    if (!fs->fsops->unlink)
       return -EPERM;
 
@@ -443,7 +569,11 @@ vfs_unlink_impl(struct mnt_fs *fs,
    if (!p->fs_path.inode)
       return -ENOENT;
 
-   return fs->fsops->unlink(p);
+   if ((rc = fs->fsops->unlink(p)))
+      return rc;
+
+   vfs_dcache_invalidate(p);
+   return 0;
 }
 
 int vfs_unlink(const char *path)
@@ -506,6 +636,8 @@ static ALWAYS_INLINE int
 vfs_symlink_impl(struct mnt_fs *fs,
                  struct vfs_path *p, const char *target, ulong u1, ulong u2)
 {
+   int rc;
+
    if (!fs->fsops->symlink)
       return -EPERM;
 
@@ -515,7 +647,11 @@ vfs_symlink_impl(struct mnt_fs *fs,
    if (p->fs_path.inode)
       return -EEXIST; /* the linkpath already exists! */
 
-   return fs->fsops->symlink(target, p);
+   if ((rc = fs->fsops->symlink(target, p)))
+      return rc;
+
+   vfs_dcache_invalidate(p);
+   return 0;
 }
 
 int vfs_symlink(const char *target, const char *linkpath)
@@ -724,6 +860,17 @@ vfs_rename_or_link(const char *oldpath,
          : -EROFS /* read-only struct mnt_fs */
       : -EPERM; /* not supported */
 
+   /*
+    * Drop the dentries of both the paths, even in case of failure: ramfs'
+    * rename() might have removed the destination anyway (see the comment
+    * there). If the destination was a directory, drop its children as well.
+    */
+   vfs_dcache_invalidate(&oldp);
+   vfs_dcache_invalidate(&newp);
+
+   if (newp.fs_path.type == VFS_DIR)
+      vfs_dcache_invalidate_dir(fs, newp.fs_path.inode);
+
    /* We're done, release fs's exlock and its retain count */
    vfs_smart_fs_unlock(fs, true);
    release_obj(fs);
@@ -803,16 +950,23 @@ int vfs_futimens(fs_handle h, const struct k_timespec64 times[2])
    return fsops->futimens(hb->fs, fsops->get_inode(h), times);
 }
 
-ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
+static ssize_t
+vfs_do_readv(struct fs_handle_base *hb,
+             const struct iovec *iov,
+             int iovcnt,
+             offt *pos)
 {
-   struct fs_handle_base *hb = h;
-   struct task *curr = get_curr_task();
    ssize_t ret = 0;
    ssize_t rc;
-   size_t len;
+
+   if (!hb->fops->read)
+      return -EBADF;
+
+   if ((hb->fl_flags & O_WRONLY) && !(hb->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
 
    if (hb->fops->readv)
-      return hb->fops->readv(h, iov, iovcnt);
+      return hb->fops->readv(hb, iov, iovcnt, pos);
 
    /*
     * readv() is not implemented in the file system: implement here it in a
@@ -828,18 +982,16 @@ ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
 
    for (int i = 0; i < iovcnt; i++) {
 
-      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
-
-      rc = vfs_read(h, curr->io_copybuf, len);
+      rc = vfs_do_read_user(hb, iov[i].iov_base, iov[i].iov_len, pos);
 
       if (rc < 0) {
-         ret = rc;
+
+         if (!ret)
+            ret = rc;
+
          break;
       }
 
-      if (copy_to_user(iov[i].iov_base, curr->io_copybuf, len))
-         return -EFAULT;
-
       ret += rc;
 
       if (rc < (ssize_t)iov[i].iov_len)
@@ -849,40 +1001,38 @@ ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
    return ret;
 }
 
-ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt)
+static ssize_t
+vfs_do_writev(struct fs_handle_base *hb,
+              const struct iovec *iov,
+              int iovcnt,
+              offt *pos)
 {
-   struct fs_handle_base *hb = h;
-   struct task *curr = get_curr_task();
    ssize_t ret = 0;
    ssize_t rc;
-   size_t len;
+
+   if (!hb->fops->write)
+      return -EBADF;
+
+   if (!(hb->fl_flags & (O_WRONLY | O_RDWR)))
+      return -EBADF; /* file not opened for writing */
 
    if (hb->fops->writev)
-      return hb->fops->writev(h, iov, iovcnt);
+      return hb->fops->writev(hb, iov, iovcnt, pos);
 
    /*
     * writev() is not implemented in the file system: implement here it in a
-    * generic but non-atomic way. There's nothing more we can do. Also, the
-    * POSIX standard does not require writev() to be atomic:
-    *
-    *    https://pubs.opengroup.org/onlinepubs/9699919799/
-    *
-    * Note: Linux's man page claims that readv/writev must be atomic: that's
-    * possible now because all of the Linux file systems support internally the
-    * scatter/gather I/O. On Tilck, not all the file systems will support it.
+    * generic but non-atomic way. See the comments in vfs_do_readv().
     */
 
    for (int i = 0; i < iovcnt; i++) {
 
-      len = MIN(iov[i].iov_len, IO_COPYBUF_SIZE);
+      rc = vfs_do_write_user(hb, iov[i].iov_base, iov[i].iov_len, pos);
 
-      if (copy_from_user(curr->io_copybuf, iov[i].iov_base, len))
-         return -EFAULT;
+      if (rc < 0) {
 
-      rc = vfs_write(h, curr->io_copybuf, len);
+         if (!ret)
+            ret = rc;
 
-      if (rc < 0) {
-         ret = rc;
          break;
       }
 
@@ -898,6 +1048,199 @@ ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt)
    return ret;
 }
 
+ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+   return vfs_do_readv(hb, iov, iovcnt, &hb->h_fpos);
+}
+
+ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+   return vfs_do_writev(hb, iov, iovcnt, &hb->h_fpos);
+}
+
+ssize_t
+vfs_preadv(fs_handle h, const struct iovec *iov, int iovcnt, offt off)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   if (!((struct fs_handle_base *)h)->fops->seek)
+      return -ESPIPE;
+
+   return vfs_do_readv(h, iov, iovcnt, &off);
+}
+
+ssize_t
+vfs_pwritev(fs_handle h, const struct iovec *iov, int iovcnt, offt off)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   if (!((struct fs_handle_base *)h)->fops->seek)
+      return -ESPIPE;
+
+   return vfs_do_writev(h, iov, iovcnt, &off);
+}
+
+/*
+ * Move by `n` bytes the offset `pos` of `h`. When that's the file position of
+ * the handle, do it through seek(), in order to keep in sync any FS-specific
+ * state depending on it (e.g. the current cluster on FAT).
+ */
+static void
+vfs_splice_move_pos(struct fs_handle_base *h, offt *pos, offt n)
+{
+   if (pos == &h->h_fpos) {
+      DEBUG_ONLY_UNSAFE(offt rc =)
+         h->fops->seek(h, n, SEEK_CUR);
+
+      ASSERT(rc >= 0);
+   } else {
+      *pos += n;
+   }
+}
+
+/*
+ * Move one chunk of data from `in` to `out`. Returns the number of bytes
+ * written on `out` and sets `*stop` when the caller should not try to move
+ * any other chunk.
+ */
+static ssize_t
+vfs_splice_chunk(struct fs_handle_base *in,
+                 offt *in_pos,
+                 struct fs_handle_base *out,
+                 offt *out_pos,
+                 size_t len,
+                 bool *stop)
+{
+   const struct file_ops *in_fops = in->fops;
+   void *buf = get_curr_task()->io_copybuf;
+   struct vfs_splice_buf sb;
+   ssize_t rc, wrc;
+
+   if (in_fops->splice_read) {
+
+      ASSERT(in_fops->seek != NULL);
+
+      if ((rc = in_fops->splice_read(in, *in_pos, len, &sb)) <= 0) {
+         *stop = true;
+         return rc;
+      }
+
+      ASSERT(sb.len == (size_t)rc);
+      wrc = out->fops->write(out, sb.data, sb.len, out_pos);
+
+      if (in_fops->splice_release)
+         in_fops->splice_release(in, &sb);
+
+      if (wrc > 0)
+         vfs_splice_move_pos(in, in_pos, wrc);
+
+      *stop = wrc < rc;
+      return wrc;
+   }
+
+   if ((rc = in_fops->read(in, buf, MIN(len, IO_COPYBUF_SIZE), in_pos)) <= 0) {
+      *stop = true;
+      return rc;
+   }
+
+   wrc = out->fops->write(out, buf, (size_t)rc, out_pos);
+
+   if (wrc < rc) {
+
+      /*
+       * Give back to `in` the data that could not be written. That's possible
+       * only on seekable files: with pipes and char devices, that data is lost.
+       * But, as the syscalls never move data from a pipe to another one, that
+       * can happen only in case of errors.
+       */
+      if (in_fops->seek)
+         vfs_splice_move_pos(in, in_pos, -(rc - MAX(wrc, 0)));
+
+      *stop = true;
+   }
+
+   return wrc;
+}
+
+/*
+ * Move up to `len` bytes from `in` to `out`, without copying them to the user
+ * space and back: that's the core of sendfile() and splice(). When `in_pos` or
+ * `out_pos` are NULL, the file positions of the handles are used (and moved).
+ *
+ * File systems implementing splice_read() lend their data in place, which then
+ * gets copied just once, by out's write(). For the others, the data is staged
+ * through the per-task io_copybuf.
+ *
+ * Like splice() on Linux, after moving some data this func stops instead of
+ * blocking on a non-seekable `in` or `out` (e.g. an empty or a full pipe).
+ */
+ssize_t vfs_splice(fs_handle in_h,
+                   offt *in_pos,
+                   fs_handle out_h,
+                   offt *out_pos,
+                   size_t len)
+{
+   struct fs_handle_base *in = in_h;
+   struct fs_handle_base *out = out_h;
+   bool stop = false;
+   ssize_t tot = 0;
+   ssize_t rc;
+
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(in != NULL && out != NULL);
+
+   if (!in->fops->read || !out->fops->write)
+      return -EBADF;
+
+   if ((in->fl_flags & O_WRONLY) && !(in->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
+
+   if (!(out->fl_flags & (O_WRONLY | O_RDWR)))
+      return -EBADF; /* file not opened for writing */
+
+   if (!in_pos)
+      in_pos = &in->h_fpos;
+
+   if (!out_pos)
+      out_pos = &out->h_fpos;
+
+   while (!stop && (size_t)tot < len) {
+
+      if (tot > 0) {
+
+         if (!in->fops->seek && !vfs_read_ready(in))
+            break;
+
+         if (!out->fops->seek && !vfs_write_ready(out))
+            break;
+      }
+
+      rc = vfs_splice_chunk(in, in_pos, out, out_pos, len - (size_t)tot, &stop);
+
+      if (rc < 0) {
+
+         if (!tot)
+            tot = rc;
+
+         break;
+      }
+
+      tot += rc;
+   }
+
+   return tot;
+}
+
 u32 vfs_get_new_device_id(void)
 {
    return next_device_id++;
@@ -927,6 +1270,7 @@ create_fs_obj(const char *type,
 void destory_fs_obj(struct mnt_fs *fs)
 {
    ASSERT(!fs->pss_lock_root);
+   vfs_dcache_invalidate_dir(fs, NULL);
    kfree_obj(fs, struct mnt_fs);
 }
 
@@ -994,6 +1338,9 @@ panic_handles[PANIC_HANDLES][MAX_FS_HANDLE_SIZE] ALIGNED_AT(MAX_FS_HANDLE_SIZE);
 static bool
 panic_handles_used[PANIC_HANDLES];
 
+static struct kmem_cache handle_cache =
+   KMEM_CACHE_INIT("fs_handle", MAX_FS_HANDLE_SIZE, NULL);
+
 fs_handle vfs_alloc_handle_raw(void)
 {
    if (UNLIKELY(in_panic())) {
@@ -1008,7 +1355,7 @@ fs_handle vfs_alloc_handle_raw(void)
       return NULL;
    }
 
-   return kmalloc(MAX_FS_HANDLE_SIZE);
+   return kmem_cache_alloc(&handle_cache);
 }
 
 void vfs_free_handle(fs_handle h)
@@ -1025,7 +1372,7 @@ void vfs_free_handle(fs_handle h)
       return;
    }
 
-   kfree2(h, MAX_FS_HANDLE_SIZE);
+   kmem_cache_free(&handle_cache, h);
 }
 
 fs_handle vfs_alloc_handle(void)
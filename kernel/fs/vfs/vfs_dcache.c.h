@@ -0,0 +1,363 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Dentry cache
+ * ---------------
+ *
+ * vfs_resolve() asks the FS for every component of every path: that's cheap
+ * for ramfs, but it means walking a whole directory for fat. The dentry cache
+ * remembers the results of the recent get_entry() calls, keyed by (fs, dir
+ * inode, name), including the negative ones (no such entry). On top of that,
+ * the path cache remembers the result of the recent vfs_resolve() calls, keyed
+ * by (starting dir, path), where the starting dir is the cwd for the relative
+ * paths and the root for the absolute ones.
+ *
+ * Only the file systems having the VFS_FS_DCACHE flag are cached: the ones
+ * whose namespace changes exclusively through the VFS functions. The dentries
+ * are looked up and inserted holding at least a shared lock on their FS, while
+ * the VFS calls vfs_dcache_invalidate*() holding an exclusive lock on it,
+ * right after changing its namespace: therefore, no stale dentry can ever be
+ * seen. The cached paths instead can cross multiple file systems, so each one
+ * of them is valid only as long as `vfs_dcache_gen`, incremented on every
+ * namespace change, mount or destruction of a file system, is the same as it
+ * was when its resolution started.
+ *
+ * Both the caches are small direct-mapped tables: a new entry just replaces
+ * the one in its slot. The "." and ".." components are never cached.
+ */
+
+#define VFS_DCACHE_SLOTS                    256
+#define VFS_DCACHE_NAME_MAX                  28
+#define VFS_PCACHE_SLOTS                     32
+#define VFS_PCACHE_PATH_MAX                  64
+
+struct vfs_dcache_entry {
+
+   struct mnt_fs *fs;                  /* NULL -> empty slot */
+   vfs_inode_ptr_t dir_inode;
+   struct fs_path fs_path;
+   u32 hash;
+   u32 name_len;
+   char name[VFS_DCACHE_NAME_MAX];
+};
+
+struct vfs_pcache_entry {
+
+   struct mnt_fs *start_fs;            /* NULL -> empty slot */
+   vfs_inode_ptr_t start_inode;        /* NULL for the absolute paths */
+   struct mnt_fs *fs;
+   struct fs_path fs_path;
+   u32 gen;
+   u32 hash;
+   u16 path_len;
+   u16 last_comp_off;
+   bool res_last_sl;
+   char path[VFS_PCACHE_PATH_MAX];
+};
+
+static struct vfs_dcache_entry dcache[VFS_DCACHE_SLOTS];
+static struct vfs_pcache_entry pcache[VFS_PCACHE_SLOTS];
+static u32 vfs_dcache_gen;
+
+/* FNV-1a */
+static inline u32
+vfs_dcache_hash_mem(u32 h, const void *ptr, size_t len)
+{
+   const u8 *p = ptr;
+
+   for (size_t i = 0; i < len; i++)
+      h = (h ^ p[i]) * 16777619u;
+
+   return h;
+}
+
+static inline u32
+vfs_dcache_hash(const void *a, const void *b, const char *s, size_t len)
+{
+   u32 h = 2166136261u;
+   h = vfs_dcache_hash_mem(h, &a, sizeof(a));
+   h = vfs_dcache_hash_mem(h, &b, sizeof(b));
+   return vfs_dcache_hash_mem(h, s, len);
+}
+
+static inline bool
+vfs_dcache_is_fs_cached(struct mnt_fs *fs)
+{
+   return !!(fs->flags & VFS_FS_DCACHE);
+}
+
+static inline bool
+vfs_dcache_can_use(struct mnt_fs *fs, const char *name, ssize_t len)
+{
+   if (!vfs_dcache_is_fs_cached(fs))
+      return false;
+
+   if (len <= 0 || len > VFS_DCACHE_NAME_MAX)
+      return false;
+
+   return !is_dot_or_dotdot(name, (int)len);
+}
+
+static inline struct vfs_dcache_entry *
+vfs_dcache_slot(u32 hash)
+{
+   return &dcache[hash % VFS_DCACHE_SLOTS];
+}
+
+static inline bool
+vfs_dcache_match(struct vfs_dcache_entry *e,
+                 u32 hash,
+                 struct mnt_fs *fs,
+                 vfs_inode_ptr_t idir,
+                 const char *name,
+                 ssize_t len)
+{
+   return e->hash == hash &&
+          e->fs == fs &&
+          e->dir_inode == idir &&
+          e->name_len == (u32)len &&
+          !memcmp(e->name, name, (size_t)len);
+}
+
+/*
+ * Cached version of vfs_get_entry(). The caller must hold (at least) a shared
+ * lock on `fs`, like for vfs_get_entry().
+ */
+static void
+vfs_dcache_get_entry(struct mnt_fs *fs,
+                     vfs_inode_ptr_t idir,
+                     const char *name,
+                     ssize_t len,
+                     struct fs_path *fs_path)
+{
+   struct vfs_dcache_entry *e;
+   u32 hash;
+   bool hit;
+
+   if (!vfs_dcache_can_use(fs, name, len)) {
+      vfs_get_entry(fs, idir, name, len, fs_path);
+      return;
+   }
+
+   hash = vfs_dcache_hash(fs, idir, name, (size_t)len);
+   e = vfs_dcache_slot(hash);
+
+   disable_preemption();
+   {
+      if ((hit = vfs_dcache_match(e, hash, fs, idir, name, len)))
+         *fs_path = e->fs_path;
+   }
+   enable_preemption();
+
+   if (hit)
+      return;
+
+   vfs_get_entry(fs, idir, name, len, fs_path);
+
+   disable_preemption();
+   {
+      e->fs = fs;
+      e->dir_inode = idir;
+      e->fs_path = *fs_path;
+      e->hash = hash;
+      e->name_len = (u32)len;
+      memcpy(e->name, name, (size_t)len);
+   }
+   enable_preemption();
+}
+
+/*
+ * Drop the dentry for the last component of `p`, which the FS has just created,
+ * removed or renamed. The caller must hold an exclusive lock on p->fs.
+ */
+static void
+vfs_dcache_invalidate(struct vfs_path *p)
+{
+   struct mnt_fs *fs = p->fs;
+   vfs_inode_ptr_t idir = p->fs_path.dir_inode;
+   const char *name = p->last_comp;
+   struct vfs_dcache_entry *e;
+   ssize_t len = 0;
+   u32 hash;
+
+   if (!vfs_dcache_is_fs_cached(fs))
+      return;
+
+   while (name[len] && name[len] != '/')
+      len++;
+
+   hash = vfs_dcache_hash(fs, idir, name, (size_t)len);
+   e = vfs_dcache_slot(hash);
+
+   disable_preemption();
+   {
+      if (vfs_dcache_match(e, hash, fs, idir, name, len))
+         e->fs = NULL;
+
+      vfs_dcache_gen++;
+   }
+   enable_preemption();
+}
+
+/*
+ * Drop all the dentries of `fs` having `idir` as parent (or all the dentries
+ * of `fs`, when `idir` is NULL). Used when `idir` is going to be destroyed,
+ * because a new inode at the same address must not inherit its dentries.
+ */
+static void
+vfs_dcache_invalidate_dir(struct mnt_fs *fs, vfs_inode_ptr_t idir)
+{
+   if (!vfs_dcache_is_fs_cached(fs))
+      return;
+
+   disable_preemption();
+   {
+      for (int i = 0; i < VFS_DCACHE_SLOTS; i++) {
+
+         struct vfs_dcache_entry *e = &dcache[i];
+
+         if (e->fs == fs && (!idir || e->dir_inode == idir))
+            e->fs = NULL;
+      }
+
+      vfs_dcache_gen++;
+   }
+   enable_preemption();
+}
+
+/* Invalidate all the cached paths (e.g. after a mount) */
+static void
+vfs_dcache_paths_changed(void)
+{
+   disable_preemption();
+   {
+      vfs_dcache_gen++;
+   }
+   enable_preemption();
+}
+
+static inline bool
+vfs_pcache_get_path_len(const char *path, size_t *len_ref)
+{
+   size_t len = 0;
+
+   while (path[len]) {
+
+      if (++len >= VFS_PCACHE_PATH_MAX)
+         return false;
+   }
+
+   *len_ref = len;
+   return true;
+}
+
+static inline bool
+vfs_pcache_match(struct vfs_pcache_entry *e,
+                 u32 hash,
+                 struct mnt_fs *start_fs,
+                 vfs_inode_ptr_t start_inode,
+                 const char *path,
+                 size_t len,
+                 bool res_last_sl)
+{
+   return e->hash == hash &&
+          e->start_fs == start_fs &&
+          e->start_inode == start_inode &&
+          e->res_last_sl == res_last_sl &&
+          e->path_len == len &&
+          !memcmp(e->path, path, len);
+}
+
+/*
+ * Look for `path` in the path cache. In case of success, the cached result is
+ * copied in `rp`, with the struct mnt_fs RETAINED but NOT locked, and its
+ * generation is stored in `gen_ref`: once the FS is locked, the caller has to
+ * check that it's still the current one.
+ */
+static bool
+vfs_pcache_get(struct mnt_fs *start_fs,
+               vfs_inode_ptr_t start_inode,
+               const char *path,
+               bool res_last_sl,
+               struct vfs_path *rp,
+               u32 *gen_ref)
+{
+   struct vfs_pcache_entry *e;
+   size_t len;
+   u32 hash;
+   bool hit;
+
+   if (!start_fs || !vfs_dcache_is_fs_cached(start_fs))
+      return false;
+
+   if (!vfs_pcache_get_path_len(path, &len))
+      return false;
+
+   hash = vfs_dcache_hash(start_fs, start_inode, path, len);
+   e = &pcache[hash % VFS_PCACHE_SLOTS];
+
+   disable_preemption();
+   {
+      hit = e->gen == vfs_dcache_gen &&
+            vfs_pcache_match(e, hash, start_fs, start_inode,
+                             path, len, res_last_sl);
+
+      if (hit) {
+
+         *rp = (struct vfs_path) {
+            .fs = e->fs,
+            .fs_path = e->fs_path,
+            .last_comp = path + e->last_comp_off,
+         };
+
+         *gen_ref = e->gen;
+         retain_obj(rp->fs);
+      }
+   }
+   enable_preemption();
+   return hit;
+}
+
+/*
+ * Store the result of a successful vfs_resolve() in the path cache, unless
+ * the namespace changed after its beginning (`gen`).
+ */
+static void
+vfs_pcache_put(struct mnt_fs *start_fs,
+               vfs_inode_ptr_t start_inode,
+               const char *path,
+               bool res_last_sl,
+               struct vfs_path *rp,
+               u32 gen)
+{
+   struct vfs_pcache_entry *e;
+   size_t len;
+   u32 hash;
+
+   if (!vfs_dcache_is_fs_cached(start_fs) || !vfs_dcache_is_fs_cached(rp->fs))
+      return;
+
+   if (!vfs_pcache_get_path_len(path, &len))
+      return;
+
+   hash = vfs_dcache_hash(start_fs, start_inode, path, len);
+   e = &pcache[hash % VFS_PCACHE_SLOTS];
+
+   disable_preemption();
+   {
+      if (gen == vfs_dcache_gen) {
+
+         e->start_fs = start_fs;
+         e->start_inode = start_inode;
+         e->fs = rp->fs;
+         e->fs_path = rp->fs_path;
+         e->gen = gen;
+         e->hash = hash;
+         e->path_len = (u16)len;
+         e->last_comp_off = (u16)(rp->last_comp - path);
+         e->res_last_sl = res_last_sl;
+         memcpy(e->path, path, len);
+      }
+   }
+   enable_preemption();
+}
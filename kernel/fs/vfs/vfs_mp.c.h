@@ -11,10 +11,12 @@ int mp_init(struct mnt_fs *root_fs)
 
 #ifdef UNIT_TEST_ENVIRONMENT
    bzero(mps2, sizeof(mps2));
+   bzero(dcache, sizeof(dcache));
 #endif
 
    mp_root = root_fs;
    retain_obj(mp_root);
+   vfs_dcache_paths_changed();
    return 0;
 }
 
@@ -133,6 +135,9 @@ int mp_add(struct mnt_fs *target_fs, const char *target_path)
       /* Now that we've succeeded, we must retain the target_fs as well */
       retain_obj(target_fs);
 
+      /* The paths through `target_path` now resolve differently */
+      vfs_dcache_paths_changed();
+
    } else {
 
       /* no free slot, sorry */
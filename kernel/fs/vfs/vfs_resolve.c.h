@@ -68,7 +68,7 @@ __vfs_resolve_get_entry(vfs_inode_ptr_t idir,
                         struct vfs_path *rp,
                         bool exlock)
 {
-   vfs_get_entry(rp->fs, idir, pc, path - pc, &rp->fs_path);
+   vfs_dcache_get_entry(rp->fs, idir, pc, path - pc, &rp->fs_path);
    rp->last_comp = pc;
 
    struct mnt_fs *target_fs = mp_get_retained_at(rp->fs, rp->fs_path.inode);
@@ -250,8 +250,16 @@ vfs_resolve_get_entry(struct vfs_resolve_int_ctx *ctx,
    struct vfs_path *rp = vfs_resolve_stack_top(ctx);
    const char *const lc = rp->last_comp;
 
-   if (vfs_handle_cross_fs_dotdot(ctx, lc, np))
+   if (!vfs_dcache_is_fs_cached(rp->fs))
+      ctx->no_pcache = true;
+
+   if (vfs_handle_cross_fs_dotdot(ctx, lc, np)) {
+
+      if (!vfs_dcache_is_fs_cached(np->fs))
+         ctx->no_pcache = true;
+
       return 0;
+   }
 
    *np = *rp;
 
@@ -268,6 +276,9 @@ vfs_resolve_get_entry(struct vfs_resolve_int_ctx *ctx,
                            np,
                            ctx->exlock);
 
+   if (!vfs_dcache_is_fs_cached(np->fs))
+      ctx->no_pcache = true;
+
    if (np->fs_path.type == VFS_SYMLINK && res_symlinks)
       return vfs_resolve_symlink(ctx, np);
 
@@ -356,6 +367,61 @@ get_locked_retained_cwd(struct vfs_path *rp, bool exlock)
    vfs_smart_fs_lock(rp->fs, exlock);
 }
 
+/*
+ * Get the key of the starting point of the resolution of `path` in the path
+ * cache: the cwd for the relative paths, the root FS for the absolute ones.
+ */
+static void
+vfs_resolve_get_start(const char *path,
+                      struct mnt_fs **fs_ref,
+                      vfs_inode_ptr_t *inode_ref)
+{
+   struct process *pi;
+
+   if (*path == '/') {
+      *fs_ref = mp_get_root();
+      *inode_ref = NULL;
+      return;
+   }
+
+   pi = get_curr_proc();
+
+   kmutex_lock(&pi->fslock);
+   {
+      *fs_ref = pi->cwd.fs;
+      *inode_ref = pi->cwd.fs_path.inode;
+   }
+   kmutex_unlock(&pi->fslock);
+}
+
+/* Like vfs_resolve(), but using only the path cache */
+static bool
+vfs_resolve_cached(const char *path,
+                   struct vfs_path *rp,
+                   bool exlock,
+                   bool res_last_sl)
+{
+   struct mnt_fs *start_fs;
+   vfs_inode_ptr_t start_inode;
+   u32 gen;
+
+   vfs_resolve_get_start(path, &start_fs, &start_inode);
+
+   if (!vfs_pcache_get(start_fs, start_inode, path, res_last_sl, rp, &gen))
+      return false;
+
+   vfs_smart_fs_lock(rp->fs, exlock);
+
+   if (gen == vfs_dcache_gen)
+      return true;
+
+   /* The namespace changed while we were waiting for the lock */
+   vfs_smart_fs_unlock(rp->fs, exlock);
+   release_obj(rp->fs);
+   bzero(rp, sizeof(*rp));
+   return false;
+}
+
 /*
  * Resolves the path, locking the last struct mnt_fs with an exclusive or a
  * shared lock depending on `exlock`. The last component of the path, if a
@@ -372,6 +438,9 @@ vfs_resolve(const char *path,
             bool exlock,
             bool res_last_sl)
 {
+   struct mnt_fs *start_fs;
+   vfs_inode_ptr_t start_inode;
+   u32 gen;
    int rc;
 
 #ifndef KERNEL_TEST
@@ -388,15 +457,23 @@ vfs_resolve(const char *path,
 
 #endif
 
+   if (vfs_resolve_cached(path, rp, exlock, res_last_sl))
+      return 0;
+
    bzero(rp, sizeof(*rp));
    ctx->ss = 0;
    ctx->exlock = exlock;
+   ctx->no_pcache = false;
+   gen = vfs_dcache_gen;
 
    if (*path == '/')
       get_locked_retained_root(rp, exlock);
    else
       get_locked_retained_cwd(rp, exlock);
 
+   start_fs = rp->fs;
+   start_inode = *path == '/' ? NULL : rp->fs_path.inode;
+
    rc = vfs_resolve_stack_push(ctx, path, rp);
    ASSERT(rc == 0);
 
@@ -422,6 +499,9 @@ vfs_resolve(const char *path,
          for (; rp->last_comp > path && *--rp->last_comp == '/'; ) { }
       }
 
+      if (!ctx->no_pcache)
+         vfs_pcache_put(start_fs, start_inode, path, res_last_sl, rp, gen);
+
    } else {
 
       /* resolve failed: release the lock and the fs */
@@ -11,6 +11,7 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/hal.h>
+#include <tilck/kernel/timer.h>
 
 void handle_syscall(regs_t *);
 void handle_fault(regs_t *);
@@ -205,6 +206,11 @@ void irq_entry(regs_t *r)
    /* Increase the always-enabled in_irq_count counter */
    inc_irq_count();
 
+#if KRN_TICKLESS_IDLE
+   /* Account the ticks elapsed while the periodic tick was stopped, if any */
+   timer_irq_enter();
+#endif
+
    /* Call the arch-dependent IRQ handling logic */
    arch_irq_handling(r);
 
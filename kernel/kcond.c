@@ -24,7 +24,13 @@ bool kcond_is_anyone_waiting(struct kcond *c)
    return ret;
 }
 
-bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
+/*
+ * Wait on the condition `c` with a timeout which is either in ticks or in
+ * nanoseconds (`ns` = true). KCOND_WAIT_FOREVER means no timeout, in both
+ * the cases.
+ */
+static bool
+kcond_wait_int(struct kcond *c, struct kmutex *m, u64 timeout, bool ns)
 {
    DEBUG_ONLY(check_not_in_irq_handler());
    ASSERT(!m || kmutex_is_curr_task_holding_lock(m));
@@ -36,8 +42,12 @@ panic_retry_hack:
    disable_preemption();
    prepare_to_wait_on(WOBJ_KCOND, c, NO_EXTRA, &c->wait_list);
 
-   if (timeout_ticks != KCOND_WAIT_FOREVER)
-      task_set_wakeup_timer(curr, timeout_ticks);
+   if (timeout != KCOND_WAIT_FOREVER) {
+      if (ns)
+         task_set_wakeup_timer_ns(curr, timeout);
+      else
+         task_set_wakeup_timer(curr, (u32)timeout);
+   }
 
    if (m) {
       kmutex_unlock(m);
@@ -102,6 +112,20 @@ panic_retry_hack:
    return ret;
 }
 
+bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
+{
+   return kcond_wait_int(c, m, timeout_ticks, false);
+}
+
+/*
+ * Like kcond_wait(), but with a timeout in nanoseconds, which will be honored
+ * with the resolution of the high-resolution timers, when available.
+ */
+bool kcond_wait_ns(struct kcond *c, struct kmutex *m, u64 timeout_ns)
+{
+   return kcond_wait_int(c, m, timeout_ns, true);
+}
+
 static void
 kcond_signal_int(struct kcond *c, struct wait_obj *wo)
 {
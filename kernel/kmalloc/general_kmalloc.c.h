@@ -18,7 +18,7 @@ main_heaps_kmalloc(size_t *size, u32 flags)
 {
    ASSERT(kmalloc_initialized);
 
-   // Iterate in reverse-order because the first heaps are the biggest ones.
+   // Iterate in reverse-order because the last heaps are the biggest ones.
    for (int i = used_heaps - 1; i >= 0; i--) {
 
       ASSERT(heaps[i] != NULL);
@@ -91,10 +91,65 @@ main_heaps_kfree(void *ptr, size_t *size, u32 flags)
    return 0;
 }
 
+static void *
+heaps_kmalloc(size_t *size, u32 flags)
+{
+   const u32 sub_block_sz = flags & KMALLOC_FL_SUB_BLOCK_MIN_SIZE_MASK;
+   void *res;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (*size <= SMALL_HEAP_MAX_ALLOC ||
+       UNLIKELY(sub_block_sz && sub_block_sz <= SMALL_HEAP_MAX_ALLOC))
+   {
+      /* Small DMA allocations are not allowed */
+      ASSERT(~flags & KMALLOC_FL_DMA);
+      return small_heaps_kmalloc(size, flags);
+   }
+
+   res = main_heaps_kmalloc(size, flags);
+
+   if (UNLIKELY(res == NULL && ~flags & KMALLOC_FL_DMA))
+      res = main_heaps_kmalloc(size, flags | KMALLOC_FL_DMA);
+
+   return res;
+}
+
+static int
+heaps_kfree(void *ptr, size_t *size, u32 flags)
+{
+   int rc;
+   ASSERT(!is_preemption_enabled());
+
+   if (*size) {
+
+      /* We know which heap set contains our chunk */
+
+      if (*size <= SMALL_HEAP_MAX_ALLOC) {
+         rc = small_heaps_kfree(ptr, size, flags);
+      } else {
+         rc = main_heaps_kfree(ptr, size, flags);
+      }
+
+   } else {
+
+      /* We don't know which heap set contains our chunk: try them both */
+
+      rc = small_heaps_kfree(ptr, size, flags);
+
+      if (rc)
+         rc = main_heaps_kfree(ptr, size, flags);
+   }
+
+   return rc;
+}
+
+/* Natural continuation of this source file. Purpose: make this file shorter. */
+#include "kmalloc_magazines.c.h"
+
 void *general_kmalloc(size_t *size, u32 flags)
 {
    void *res;
-   const u32 sub_block_sz = flags & KMALLOC_FL_SUB_BLOCK_MIN_SIZE_MASK;
    ASSERT(kmalloc_initialized);
    ASSERT(size != NULL);
    ASSERT(*size);
@@ -103,19 +158,25 @@ void *general_kmalloc(size_t *size, u32 flags)
    {
       const size_t orig_size = *size;
 
-      if (*size <= SMALL_HEAP_MAX_ALLOC ||
-          UNLIKELY(sub_block_sz && sub_block_sz <= SMALL_HEAP_MAX_ALLOC))
-      {
-         /* Small DMA allocations are not allowed */
-         ASSERT(~flags & KMALLOC_FL_DMA);
-         res = small_heaps_kmalloc(size, flags);
+      if (KMALLOC_MAGAZINES && kmalloc_mag_can_use(*size, flags))
+         res = kmalloc_mag_alloc(size);
+      else
+         res = heaps_kmalloc(size, flags);
 
-      } else {
+      if (UNLIKELY(!res) && kmalloc_mag_drain_all()) {
 
-         res = main_heaps_kmalloc(size, flags);
+         /* Retry, after returning to the heaps the memory in the magazines */
+         *size = orig_size;
+         res = heaps_kmalloc(size, flags);
+      }
+
+      if (UNLIKELY(!res) &&
+          kmalloc_grow_heaps(orig_size, !!(flags & KMALLOC_FL_DMA)))
+      {
 
-         if (UNLIKELY(res == NULL && ~flags & KMALLOC_FL_DMA))
-            res = main_heaps_kmalloc(size, flags | KMALLOC_FL_DMA);
+         /* Retry, after taking a new heap from the page allocator */
+         *size = orig_size;
+         res = heaps_kmalloc(size, flags);
       }
 
       if (KMALLOC_HEAVY_STATS && res != NULL)
@@ -128,7 +189,7 @@ void *general_kmalloc(size_t *size, u32 flags)
 
 void general_kfree(void *ptr, size_t *size, u32 flags)
 {
-   int rc;
+   int rc = 0;
 
    ASSERT(kmalloc_initialized);
    ASSERT(size != NULL);
@@ -143,26 +204,10 @@ void general_kfree(void *ptr, size_t *size, u32 flags)
 
    disable_preemption();
    {
-      if (*size) {
-
-         /* We know which heap set contains our chunk */
-
-         if (*size <= SMALL_HEAP_MAX_ALLOC) {
-            rc = small_heaps_kfree(ptr, size, flags);
-         } else {
-            rc = main_heaps_kfree(ptr, size, flags);
-         }
-
-
-      } else {
-
-         /* We don't know which heap set contains our chunk: try them both */
-
-         rc = small_heaps_kfree(ptr, size, flags);
-
-         if (rc)
-            rc = main_heaps_kfree(ptr, size, flags);
-      }
+      if (KMALLOC_MAGAZINES && *size && kmalloc_mag_can_use(*size, flags))
+         kmalloc_mag_free(ptr, size);
+      else
+         rc = heaps_kfree(ptr, size, flags);
    }
    enable_preemption();
 
@@ -12,7 +12,6 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
-#include <tilck/kernel/sort.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/worker_thread.h>
 
@@ -30,6 +29,10 @@ size_t kmalloc_get_heap_struct_size(void)
 STATIC_ASSERT(sizeof(struct block_node) == KMALLOC_METADATA_BLOCK_NODE_SIZE);
 
 STATIC bool kmalloc_initialized;
+static void kmem_caches_reset(void);
+static void kmalloc_mags_reset(void);
+static bool kmalloc_mag_drain_all(void);
+static struct kmalloc_mag_stats mag_stats;
 static const struct block_node s_new_node; // Just zeros.
 
 #define HALF(x) ((x) >> 1)
@@ -619,6 +622,23 @@ internal_kfree(struct kmalloc_heap *h,
    }
 }
 
+/*
+ * Size of the biggest block starting at offset `off` in the heap, naturally
+ * aligned and not longer than `len` bytes.
+ */
+static size_t aligned_block_size(ulong off, size_t len)
+{
+   size_t s = roundup_next_power_of_2(len);
+
+   if (s > len)
+      s >>= 1;
+
+   if (off)
+      s = MIN(s, (size_t)(off & (~off + 1)));
+
+   return s;
+}
+
 static size_t calculate_block_size(struct kmalloc_heap *h, ulong vaddr)
 {
    struct block_node *nodes = h->metadata_nodes;
@@ -704,17 +724,19 @@ per_heap_kfree_unsafe(struct kmalloc_heap *h,
    ASSERT(vaddr + size - 1 <= h->heap_last_byte);
    ASSERT(pow2_round_up_at(size, h->min_block_size) == size);
 
-   size_t tot = 0;
-
-   for (int i = (int)h->heap_data_size_log2 - 1; i >= 0 && tot < size; i--) {
+   /*
+    * Free the chunk as a sequence of naturally aligned blocks: for chunks
+    * returned by per_heap_kmalloc(), these are exactly the blocks it allocated,
+    * but this way we support also chunks grown by per_heap_kmalloc_at() and
+    * partial frees (KFREE_FL_ALLOW_SPLIT) not aligned at their size.
+    */
 
-      const size_t sub_block_size = (1 << i);
+   size_t tot, sub_block_size;
 
-      if (!(size & sub_block_size))
-         continue;
+   for (tot = 0; tot < size; tot += sub_block_size) {
 
+      sub_block_size = aligned_block_size(vaddr + tot - h->vaddr, size - tot);
       internal_kfree(h, ptr + tot, sub_block_size, allow_split, do_actual_free);
-      tot += sub_block_size;
    }
 
    ASSERT(tot == size);
@@ -845,6 +867,152 @@ per_heap_kfree(struct kmalloc_heap *h,
    atomic_store_explicit(&h->in_use, false, mo_relaxed);
 }
 
+/* Is the block at `vaddr` free, including all of its ancestors? */
+static bool
+is_block_free_at(struct kmalloc_heap *h, ulong vaddr, size_t size)
+{
+   struct block_node *nodes = h->metadata_nodes;
+   int n = 0;              /* root's node index */
+   ulong va = h->vaddr;    /* root's node data address */
+   size_t s = h->size;     /* root's node size */
+
+   for (; s > size; s >>= 1) {
+
+      if (!nodes[n].split)
+         return !nodes[n].full; /* the whole sub-tree is free or allocated */
+
+      if (vaddr >= va + HALF(s)) {
+         va += HALF(s);
+         n = NODE_RIGHT(n);
+      } else {
+         n = NODE_LEFT(n);
+      }
+   }
+
+   return is_block_node_free(nodes[n]);
+}
+
+/* Split all the ancestors of the (free) block at `vaddr` and return its node */
+static int
+split_path_to_block(struct kmalloc_heap *h, ulong vaddr, size_t size)
+{
+   struct block_node *nodes = h->metadata_nodes;
+   int n = 0;
+   ulong va = h->vaddr;
+   size_t s = h->size;
+
+   for (; s > size; s >>= 1) {
+
+      nodes[n].split = true;
+
+      if (vaddr >= va + HALF(s)) {
+         va += HALF(s);
+         n = NODE_RIGHT(n);
+      } else {
+         n = NODE_LEFT(n);
+      }
+   }
+
+   return n;
+}
+
+static void *
+per_heap_kmalloc_at_unsafe(struct kmalloc_heap *h,
+                           void *ptr,
+                           size_t size,
+                           u32 flags)
+{
+   struct block_node *nodes = h->metadata_nodes;
+   const ulong vaddr = (ulong)ptr;
+   const bool do_actual_alloc = !(flags & KMALLOC_FL_NO_ACTUAL_ALLOC);
+   const u32 sub_blocks_min_size = flags & KMALLOC_FL_SUB_BLOCK_MIN_SIZE_MASK;
+   size_t tot, s;
+   void *addr;
+   bool success;
+   int n;
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(!sub_blocks_min_size || sub_blocks_min_size >= h->min_block_size);
+
+   if (vaddr < h->vaddr || vaddr + size - 1 > h->heap_last_byte)
+      return NULL;
+
+   if ((vaddr | size) & (h->min_block_size - 1))
+      return NULL;
+
+   /* First, check that the whole range is free */
+   for (tot = 0; tot < size; tot += s) {
+
+      s = aligned_block_size(vaddr + tot - h->vaddr, size - tot);
+
+      if (!is_block_free_at(h, vaddr + tot, s))
+         return NULL;
+   }
+
+   /* Then, allocate it block by block, like the multi-step allocations */
+   for (tot = 0; tot < size; tot += s) {
+
+      s = aligned_block_size(vaddr + tot - h->vaddr, size - tot);
+      n = split_path_to_block(h, vaddr + tot, s);
+      success = actual_allocate_node(h, s, n, &addr, do_actual_alloc);
+
+      ASSERT(addr == ptr + tot);
+
+      /* Mark the parent nodes as 'full', when necessary */
+      for (int p = n; p > 0; ) {
+
+         p = NODE_PARENT(p);
+
+         if (!nodes[NODE_LEFT(p)].full || !nodes[NODE_RIGHT(p)].full)
+            break;
+
+         nodes[p].full = true;
+      }
+
+      if (UNLIKELY(!success)) {
+
+         /* See the same corner case in internal_kmalloc() */
+         size_t actual_size = s;
+         per_heap_kfree_unsafe(h, addr, &actual_size, 0);
+
+         if (tot) {
+            actual_size = tot;
+            per_heap_kfree_unsafe(h, ptr, &actual_size,
+                                  KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+         }
+
+         return NULL;
+      }
+
+      if (do_actual_alloc)
+         h->mem_allocated += s;
+
+      if (sub_blocks_min_size)
+         internal_kmalloc_split_block(h, addr, s, sub_blocks_min_size);
+   }
+
+   return ptr;
+}
+
+/*
+ * Allocate exactly the range [ptr, ptr + size) in the heap, if it's free.
+ * Used to grow in-place a chunk allocated with KMALLOC_FL_MULTI_STEP: the
+ * two chunks can be later freed together with KFREE_FL_MULTI_STEP.
+ */
+void *
+per_heap_kmalloc_at(struct kmalloc_heap *h, void *ptr, size_t size, u32 flags)
+{
+   bool expected = false;
+   void *res;
+
+   if (!atomic_cas_strong(&h->in_use, &expected, true, mo_relaxed, mo_relaxed))
+      return NULL; /* heap already in use (we're in IRQ context) */
+
+   res = per_heap_kmalloc_at_unsafe(h, ptr, size, flags);
+   atomic_store_explicit(&h->in_use, false, mo_relaxed);
+   return res;
+}
+
 void *kzmalloc(size_t size)
 {
    void *res = kmalloc(size);
@@ -922,4 +1090,5 @@ void vfree2(void *ptr, size_t size)
 #include "kmalloc_heaps.c.h"
 #include "general_kmalloc.c.h"
 #include "kmalloc_accelerator.c.h"
+#include "kmalloc_cache.c.h"
 
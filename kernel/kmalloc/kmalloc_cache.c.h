@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef _KMALLOC_C_
+
+   #error This is NOT a header file and it is not meant to be included
+
+   /*
+    * The only purpose of this file is to keep kmalloc.c shorter.
+    * Yes, this file could be turned into a regular C source file, but at the
+    * price of making several static functions and variables in kmalloc.c to be
+    * just non-static. We don't want that. Code isolation is a GOOD thing.
+    */
+
+#endif
+
+/*
+ * Object caches
+ * ----------------
+ *
+ * Each cache allocates its objects in batches of ~KMEM_CACHE_BATCH_SIZE bytes
+ * through a kmalloc accelerator, which makes each object individually freeable
+ * with general_kfree(). Freed objects go to a LIFO free list, linked through
+ * their first word, from which the next allocations are served in O(1). When
+ * the free list is full, the objects are returned to the heap instead.
+ */
+
+#define KMEM_CACHE_BATCH_SIZE                (8 * KB)
+
+static struct kmem_cache *kmem_caches;
+
+/*
+ * Drop the internal state of all the caches. Called by early_init_kmalloc():
+ * that's a no-op for the kernel, but the unit tests re-initialize kmalloc many
+ * times and the objects in the free lists belong to the old heaps.
+ */
+static void
+kmem_caches_reset(void)
+{
+   struct kmem_cache *c = kmem_caches;
+   struct kmem_cache *next;
+
+   for (; c; c = next) {
+
+      next = c->next;
+      *c = (struct kmem_cache) KMEM_CACHE_INIT(c->name, c->size, c->ctor);
+   }
+
+   kmem_caches = NULL;
+}
+
+static void
+kmem_cache_setup(struct kmem_cache *c)
+{
+   const u32 obj_size =
+      (u32)roundup_next_power_of_2(MAX(c->size, (size_t)SMALL_HEAP_MBS));
+
+   const u32 batch = MAX(KMEM_CACHE_BATCH_SIZE / obj_size, 1u);
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(c->size > 0);
+
+   kmalloc_create_accelerator(&c->acc, obj_size, batch);
+   c->max_free = 2 * batch;
+   c->next = kmem_caches;
+   kmem_caches = c;
+}
+
+static void
+kmem_cache_release_obj(struct kmem_cache *c, void *obj)
+{
+   size_t actual_size = c->acc.elem_size;
+
+   general_kfree(obj, &actual_size, KFREE_FL_ALLOW_SPLIT);
+   ASSERT(actual_size == c->acc.elem_size);
+}
+
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+   void *obj;
+
+   disable_preemption();
+   {
+      if (UNLIKELY(!c->acc.elem_size))
+         kmem_cache_setup(c);
+
+      if ((obj = c->free_list)) {
+
+         c->free_list = *(void **)obj;
+         c->free_count--;
+
+      } else if ((obj = kmalloc_accelerator_get_elem(&c->acc))) {
+
+         c->refills++;
+      }
+
+      if (obj) {
+         c->allocs++;
+         c->in_use++;
+         c->peak_in_use = MAX(c->peak_in_use, c->in_use);
+      }
+   }
+   enable_preemption();
+
+   if (obj && c->ctor)
+      c->ctor(obj);
+
+   return obj;
+}
+
+void *
+kmem_cache_zalloc(struct kmem_cache *c)
+{
+   void *obj = kmem_cache_alloc(c);
+
+   if (obj)
+      bzero(obj, c->size);
+
+   return obj;
+}
+
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+   if (!obj)
+      return;
+
+   ASSERT(c->acc.elem_size > 0);
+   ASSERT(((ulong)obj & (c->acc.elem_size - 1)) == 0);
+
+   disable_preemption();
+   {
+      ASSERT(c->in_use > 0);
+      c->in_use--;
+
+      if (c->free_count < c->max_free) {
+
+         if (KMALLOC_FREE_MEM_POISONING)
+            memset32(obj, FREE_MEM_POISON_VAL, c->acc.elem_size / 4);
+
+         *(void **)obj = c->free_list;
+         c->free_list = obj;
+         c->free_count++;
+
+      } else {
+
+         kmem_cache_release_obj(c, obj);
+      }
+   }
+   enable_preemption();
+}
+
+/* Return all the free objects of the cache to the heap */
+void
+kmem_cache_shrink(struct kmem_cache *c)
+{
+   void *obj;
+
+   disable_preemption();
+   {
+      while ((obj = c->free_list)) {
+         c->free_list = *(void **)obj;
+         kmem_cache_release_obj(c, obj);
+      }
+
+      c->free_count = 0;
+
+      if (c->acc.elem_size)
+         kmalloc_destroy_accelerator(&c->acc);
+   }
+   enable_preemption();
+}
+
+/* Destroy a cache: all of its objects must have been freed */
+void
+kmem_cache_destroy(struct kmem_cache *c)
+{
+   struct kmem_cache **pp;
+
+   ASSERT(c->in_use == 0);
+   kmem_cache_shrink(c);
+
+   disable_preemption();
+   {
+      for (pp = &kmem_caches; *pp; pp = &(*pp)->next) {
+         if (*pp == c) {
+            *pp = c->next;
+            break;
+         }
+      }
+
+      *c = (struct kmem_cache) KMEM_CACHE_INIT(c->name, c->size, c->ctor);
+   }
+   enable_preemption();
+}
+
+bool
+debug_kmem_cache_get_info(int n, struct debug_kmem_cache_info *i)
+{
+   struct kmem_cache *c = kmem_caches;
+   bool found = false;
+
+   disable_preemption();
+   {
+      for (; c && n > 0; n--)
+         c = c->next;
+
+      if (c) {
+
+         *i = (struct debug_kmem_cache_info) {
+            .name = c->name,
+            .obj_size = c->acc.elem_size,
+            .in_use = c->in_use,
+            .peak_in_use = c->peak_in_use,
+            .free_count = c->free_count,
+            .allocs = c->allocs,
+            .refills = c->refills,
+         };
+
+         found = true;
+      }
+   }
+   enable_preemption();
+   return found;
+}
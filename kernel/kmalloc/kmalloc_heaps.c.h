@@ -14,10 +14,12 @@
 #endif
 
 #include <tilck/kernel/system_mmap.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/list.h>
 #include <tilck/kernel/test/kmalloc.h>
 
 STATIC struct kmalloc_heap first_heap_struct;
+static struct kmalloc_heap other_heap_structs[KMALLOC_HEAPS_COUNT - 1];
 STATIC struct kmalloc_heap *heaps[KMALLOC_HEAPS_COUNT];
 STATIC int used_heaps;
 STATIC size_t max_tot_heap_mem_free;
@@ -215,24 +217,6 @@ kmalloc_heap_dup(struct kmalloc_heap *h)
    return kmalloc_heap_dup_expanded(h, h->size);
 }
 
-static size_t find_biggest_heap_size(ulong vaddr, ulong limit)
-{
-   ulong curr_max = 512 * MB;
-   ulong curr_end;
-
-   while (curr_max) {
-
-      curr_end = vaddr + curr_max;
-
-      if (vaddr < curr_end && curr_end <= limit)
-         break;
-
-      curr_max >>= 1;
-   }
-
-   return curr_max;
-}
-
 static int kmalloc_internal_add_heap(void *vaddr, size_t heap_size)
 {
    const size_t min_block_size = SMALL_HEAP_MAX_ALLOC + 1;
@@ -242,18 +226,13 @@ static int kmalloc_internal_add_heap(void *vaddr, size_t heap_size)
    if (used_heaps >= ARRAY_SIZE(heaps))
       return -1;
 
-   if (!used_heaps) {
-
-      heaps[used_heaps] = &first_heap_struct;
-
-   } else {
-
-      heaps[used_heaps] =
-         kmalloc(MAX(sizeof(struct kmalloc_heap), SMALL_HEAP_MAX_ALLOC + 1));
-
-      if (!heaps[used_heaps])
-         panic("Unable to alloc memory for struct struct kmalloc_heap");
-   }
+   /*
+    * NOTE: the heap structs are NOT allocated with kmalloc() because new heaps
+    * are added exactly when kmalloc() is running out of memory.
+    */
+   heaps[used_heaps] = !used_heaps
+      ? &first_heap_struct
+      : &other_heap_structs[used_heaps - 1];
 
    bool success =
       kmalloc_create_heap(heaps[used_heaps],
@@ -292,54 +271,54 @@ static int kmalloc_internal_add_heap(void *vaddr, size_t heap_size)
    return used_heaps++;
 }
 
-static long greater_than_heap_cmp(const void *a, const void *b)
+/*
+ * Add a new heap, taken from the page allocator, big enough to contain a
+ * block of `size` bytes. The heaps grow geometrically (each new heap is as big
+ * as all the existing ones, when possible) in order to not run out of heap
+ * slots, but never less than KMALLOC_GROW_MIN_SIZE, except for the DMA ones.
+ */
+static bool kmalloc_grow_heaps(size_t size, bool dma)
 {
-   const struct kmalloc_heap *const *ha_ref = a;
-   const struct kmalloc_heap *const *hb_ref = b;
-
-   const struct kmalloc_heap *ha = *ha_ref;
-   const struct kmalloc_heap *hb = *hb_ref;
+   const size_t min_size = dma ? KMALLOC_MIN_HEAP_SIZE : KMALLOC_GROW_MIN_SIZE;
+   size_t tot_size = 0;
+   u32 min_order, order;
+   void *va = NULL;
+   int heap_index;
 
-   if (ha->size < hb->size)
-      return 1;
+   ASSERT(!is_preemption_enabled());
 
-   if (ha->size == hb->size)
-      return 0;
+   if (used_heaps >= ARRAY_SIZE(heaps))
+      return false;
 
-   return -1;
-}
+   /* The metadata is at the beginning of the heap: twice the size is enough */
+   size = MAX(2 * roundup_next_power_of_2(size), KMALLOC_MIN_HEAP_SIZE);
+   min_order = log2_for_power_of_2(size) - PAGE_SHIFT;
 
-static void
-init_kmalloc_fill_region(int region, ulong vaddr, ulong limit, bool dma)
-{
-   int heap_index;
-   vaddr = pow2_round_up_at(
-      vaddr,
-      MIN(KMALLOC_MIN_HEAP_SIZE, KMALLOC_MAX_ALIGN)
-   );
+   if (min_order > PAGE_ALLOC_MAX_ORDER)
+      return false;
 
-   if (vaddr >= limit)
-      return;
+   for (int i = 0; i < used_heaps; i++)
+      tot_size += heaps[i]->size;
 
-   while (true) {
+   order = log2_for_power_of_2(
+      roundup_next_power_of_2(MAX3(size, min_size, tot_size))
+   ) - PAGE_SHIFT;
 
-      size_t heap_size = find_biggest_heap_size(vaddr, limit);
+   order = MIN(order, (u32)PAGE_ALLOC_MAX_ORDER);
 
-      if (heap_size < KMALLOC_MIN_HEAP_SIZE)
+   for (; order >= min_order; order--)
+      if ((va = alloc_pages(order, dma ? PAGE_ALLOC_FL_DMA : 0)))
          break;
 
-      heap_index = kmalloc_internal_add_heap((void *)vaddr, heap_size);
+   if (!va)
+      return false;
 
-      if (heap_index < 0) {
-         printk("kmalloc: no heap slot for heap at %p, size: %zu KB\n",
-                TO_PTR(vaddr), heap_size / KB);
-         break;
-      }
+   heap_index = kmalloc_internal_add_heap(va, PAGE_SIZE << order);
+   VERIFY(heap_index >= 0);
 
-      heaps[heap_index]->region = region;
-      heaps[heap_index]->dma = dma;
-      vaddr = heaps[heap_index]->vaddr + heaps[heap_index]->size;
-   }
+   heaps[heap_index]->region = system_mmap_get_region_of(LIN_VA_TO_PA(va));
+   heaps[heap_index]->dma = dma;
+   return true;
 }
 
 void early_init_kmalloc(void)
@@ -352,6 +331,8 @@ void early_init_kmalloc(void)
 
    used_heaps = 0;
    bzero(heaps, sizeof(heaps));
+   kmem_caches_reset();
+   kmalloc_mags_reset();
 
    {
       size_t first_heap_size;
@@ -370,47 +351,23 @@ void early_init_kmalloc(void)
    }
 }
 
+/*
+ * Called after init_page_alloc(): from now on, the heaps grow on demand by
+ * taking blocks from the page allocator. Some heaps might have been already
+ * added while the page allocator was mapping the memory regions.
+ */
 void init_kmalloc(void)
 {
-   struct mem_region r;
-   ulong vbegin, vend;
-
    ASSERT(kmalloc_initialized);
-   ASSERT(used_heaps == 1);
 
    heaps[0]->region =
       system_mmap_get_region_of(LIN_VA_TO_PA(kmalloc_get_first_heap(NULL)));
 
-   for (int i = 0; i < get_mem_regions_count(); i++) {
-
-      get_mem_region(i, &r);
+   max_tot_heap_mem_free = page_alloc_get_free_pages() << PAGE_SHIFT;
 
-      if (!linear_map_mem_region(&r, &vbegin, &vend))
-         break;
-
-      if (r.type == MULTIBOOT_MEMORY_AVAILABLE) {
-
-         const bool dma = r.extra == MEM_REG_EXTRA_DMA;
-
-         if (!r.extra || dma)
-            init_kmalloc_fill_region(i, vbegin, vend, dma);
-
-         if (vend == LINEAR_MAPPING_END)
-            break;
-      }
-   }
-
-   insertion_sort_ptr(heaps,
-                      (u32)used_heaps,
-                      greater_than_heap_cmp);
-
-   for (int i = 0; i < KMALLOC_HEAPS_COUNT; i++) {
+   for (int i = 0; i < used_heaps; i++) {
 
       struct kmalloc_heap *h = heaps[i];
-
-      if (!h)
-         continue;
-
       max_tot_heap_mem_free += (h->size - h->mem_allocated);
    }
 }
@@ -451,6 +408,7 @@ debug_kmalloc_get_stats(struct debug_kmalloc_stats *stats)
 {
    *stats = (struct debug_kmalloc_stats) {
       .small_heaps = shs,
+      .mags = mag_stats,
       .chunk_sizes_count =
          KMALLOC_HEAVY_STATS ? alloc_arr_used : 0,
    };
@@ -51,6 +51,9 @@ void debug_kmalloc_start_leak_detector(bool save_metadata)
          metadata_copies[i] = buf;
       }
 
+      /* The magazines are bypassed while the leak detector is running */
+      kmalloc_mag_drain_all();
+
       for (int i = 0; i < ARRAY_SIZE(metadata_copies); i++) {
 
          if (!heaps[i].metadata_size)
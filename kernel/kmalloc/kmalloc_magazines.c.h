@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef _KMALLOC_C_
+
+   #error This is NOT a header file and it is not meant to be included
+
+   /*
+    * The only purpose of this file is to keep kmalloc.c shorter.
+    * Yes, this file could be turned into a regular C source file, but at the
+    * price of making several static functions and variables in kmalloc.c to be
+    * just non-static. We don't want that. Code isolation is a GOOD thing.
+    */
+
+#endif
+
+/*
+ * Magazines
+ * ------------
+ *
+ * A front-end for the heaps, made by one LIFO cache (magazine) of free
+ * chunks per power-of-two size class, from KMALLOC_MAG_MIN_SIZE to
+ * KMALLOC_MAG_MAX_SIZE. The chunks in the magazines are still allocated from
+ * the heaps' point of view, so they're reused without walking the heaps'
+ * metadata and without any split or coalesce operation.
+ *
+ * An empty magazine is refilled with half of its capacity at once, while a
+ * full one is drained by half of its capacity, keeping the cost of the heaps'
+ * path amortized. The capacity of each magazine is limited by both the number
+ * of its slots and by KMALLOC_MAG_MAX_BYTES, in order to not waste too much
+ * memory with the bigger size classes.
+ *
+ * Only regular allocations (no flags, known size) go through the magazines.
+ * They're bypassed while the leak detector is running, because that needs to
+ * track each chunk to/from the heaps.
+ */
+
+#define KMALLOC_MAG_MIN_SHIFT                 5
+#define KMALLOC_MAG_MAX_SHIFT                12
+#define KMALLOC_MAG_MIN_SIZE          (1u << KMALLOC_MAG_MIN_SHIFT)
+#define KMALLOC_MAG_MAX_SIZE          (1u << KMALLOC_MAG_MAX_SHIFT)
+#define KMALLOC_MAG_SLOTS                   32u
+#define KMALLOC_MAG_MAX_BYTES        (16u * KB)
+
+#define KMALLOC_MAG_CLASSES                                                 \
+   (KMALLOC_MAG_MAX_SHIFT - KMALLOC_MAG_MIN_SHIFT + 1)
+
+STATIC_ASSERT(KMALLOC_MAG_MIN_SIZE >= SMALL_HEAP_MBS);
+
+struct kmalloc_mag {
+
+   u32 count;
+   u32 cap;
+   void *slots[KMALLOC_MAG_SLOTS];
+};
+
+static struct kmalloc_mag mags[KMALLOC_MAG_CLASSES];
+
+static inline bool
+kmalloc_mag_can_use(size_t size, u32 flags)
+{
+   if (flags || size > KMALLOC_MAG_MAX_SIZE)
+      return false;
+
+   if (KMALLOC_SUPPORT_LEAK_DETECTOR && leak_detector_enabled)
+      return false;
+
+   return true;
+}
+
+static inline int
+kmalloc_mag_get_class(size_t size)
+{
+   const ulong sz = roundup_next_power_of_2(MAX(size, KMALLOC_MAG_MIN_SIZE));
+   return (int)log2_for_power_of_2(sz) - KMALLOC_MAG_MIN_SHIFT;
+}
+
+static inline size_t
+kmalloc_mag_class_size(int cl)
+{
+   return (size_t)KMALLOC_MAG_MIN_SIZE << cl;
+}
+
+static void
+kmalloc_mag_init(struct kmalloc_mag *m, size_t cl_size)
+{
+   const u32 cap = (u32)MAX(4u, KMALLOC_MAG_MAX_BYTES / cl_size);
+   m->cap = MIN(KMALLOC_MAG_SLOTS, cap);
+}
+
+static void
+kmalloc_mag_drain(struct kmalloc_mag *m, size_t cl_size, u32 n)
+{
+   size_t sz;
+   int rc;
+
+   for (; n > 0 && m->count > 0; n--) {
+
+      sz = cl_size;
+      rc = heaps_kfree(m->slots[--m->count], &sz, 0);
+
+      if (rc)
+         panic("kfree: Heap not found for block: %p\n", m->slots[m->count]);
+   }
+}
+
+static void
+kmalloc_mag_refill(struct kmalloc_mag *m, size_t cl_size)
+{
+   const u32 n = m->cap / 2;
+   size_t sz;
+   void *ptr;
+
+   for (u32 i = 0; i < n; i++) {
+
+      sz = cl_size;
+
+      if (!(ptr = heaps_kmalloc(&sz, 0)))
+         break;
+
+      m->slots[m->count++] = ptr;
+   }
+}
+
+static void *
+kmalloc_mag_alloc(size_t *size)
+{
+   const int cl = kmalloc_mag_get_class(*size);
+   const size_t cl_size = kmalloc_mag_class_size(cl);
+   struct kmalloc_mag *m = &mags[cl];
+
+   ASSERT(!is_preemption_enabled());
+
+   if (UNLIKELY(!m->cap))
+      kmalloc_mag_init(m, cl_size);
+
+   if (LIKELY(m->count > 0)) {
+
+      mag_stats.alloc_hits++;
+
+   } else {
+
+      mag_stats.alloc_misses++;
+      kmalloc_mag_refill(m, cl_size);
+
+      if (!m->count)
+         return NULL;
+   }
+
+   *size = cl_size;
+   return m->slots[--m->count];
+}
+
+static void
+kmalloc_mag_free(void *ptr, size_t *size)
+{
+   const int cl = kmalloc_mag_get_class(*size);
+   const size_t cl_size = kmalloc_mag_class_size(cl);
+   struct kmalloc_mag *m = &mags[cl];
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(((ulong)ptr & (cl_size - 1)) == 0);
+
+   if (UNLIKELY(!m->cap))
+      kmalloc_mag_init(m, cl_size);
+
+   if (LIKELY(m->count < m->cap)) {
+
+      mag_stats.free_hits++;
+
+   } else {
+
+      mag_stats.drains++;
+      kmalloc_mag_drain(m, cl_size, m->cap / 2);
+   }
+
+   if (KMALLOC_FREE_MEM_POISONING)
+      memset32(ptr, FREE_MEM_POISON_VAL, cl_size / 4);
+
+   *size = cl_size;
+   m->slots[m->count++] = ptr;
+}
+
+/* Return all the chunks in the magazines to the heaps */
+static bool
+kmalloc_mag_drain_all(void)
+{
+   bool drained = false;
+
+   ASSERT(!is_preemption_enabled());
+
+   for (int cl = 0; cl < KMALLOC_MAG_CLASSES; cl++) {
+
+      if (mags[cl].count) {
+         kmalloc_mag_drain(&mags[cl], kmalloc_mag_class_size(cl), ~0u);
+         drained = true;
+      }
+   }
+
+   return drained;
+}
+
+/*
+ * Drop the state of the magazines, without touching the heaps. Called by
+ * early_init_kmalloc(): see kmem_caches_reset().
+ */
+static void
+kmalloc_mags_reset(void)
+{
+   bzero(mags, sizeof(mags));
+   bzero(&mag_stats, sizeof(mag_stats));
+}
+
+void
+debug_kmalloc_drain_magazines(void)
+{
+   disable_preemption();
+   {
+      kmalloc_mag_drain_all();
+   }
+   enable_preemption();
+}
@@ -7,6 +7,12 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/irq.h>
 
+/*
+ * Max length of a chain of kmutexes followed by the priority inheritance.
+ * A longer chain is very likely just a deadlock.
+ */
+#define KMUTEX_PI_MAX_CHAIN                            16
+
 bool kmutex_is_curr_task_holding_lock(struct kmutex *m)
 {
    return m->owner_task == get_curr_task();
@@ -25,6 +31,64 @@ void kmutex_destroy(struct kmutex *m)
    bzero(m, sizeof(struct kmutex));
 }
 
+static void kmutex_set_owner(struct kmutex *m, struct task *ti)
+{
+   m->owner_task = ti;
+   list_add_tail(&ti->held_mutexes, &m->owner_node);
+}
+
+static int kmutex_get_max_waiter_prio(struct kmutex *m)
+{
+   struct wait_obj *wo;
+   int prio = 0;
+
+   list_for_each_ro(wo, &m->wait_list, wait_list_node) {
+      struct task *ti = CONTAINER_OF(wo, struct task, wobj);
+      prio = MAX(prio, sched_get_prio(ti));
+   }
+
+   return prio;
+}
+
+/*
+ * Priority inheritance: boost the owner of `m` to `prio` and, transitively,
+ * the owners of the kmutexes it's waiting for.
+ */
+static void kmutex_pi_boost(struct kmutex *m, int prio)
+{
+   struct task *owner;
+
+   for (int i = 0; m && i < KMUTEX_PI_MAX_CHAIN; i++) {
+
+      owner = m->owner_task;
+
+      if (sched_get_prio(owner) >= prio)
+         break;
+
+      sched_set_task_pi_prio(owner, prio);
+      m = owner->blocked_on;
+   }
+}
+
+/*
+ * Re-calculate the priority inherited by `ti` from the waiters of all the
+ * kmutexes it still owns.
+ */
+static void kmutex_pi_update(struct task *ti)
+{
+   struct kmutex *m;
+   int prio = 0;
+
+   list_for_each_ro(m, &ti->held_mutexes, owner_node)
+      prio = MAX(prio, kmutex_get_max_waiter_prio(m));
+
+   if (prio <= sched_get_base_prio(ti))
+      prio = 0;
+
+   if (prio != ti->pi_prio)
+      sched_set_task_pi_prio(ti, prio);
+}
+
 static ALWAYS_INLINE void
 kmutex_lock_enable_preemption_wrapper(struct kmutex *m)
 {
@@ -38,13 +102,15 @@ kmutex_lock_enable_preemption_wrapper(struct kmutex *m)
 
 void kmutex_lock(struct kmutex *m)
 {
+   struct task *curr = get_curr_task();
+
    disable_preemption();
    DEBUG_ONLY(check_not_in_irq_handler());
 
    if (!m->owner_task) {
 
       /* Nobody owns this mutex, just make this task own it */
-      m->owner_task = get_curr_task();
+      kmutex_set_owner(m, curr);
 
       if (m->flags & KMUTEX_FL_RECURSIVE) {
          ASSERT(m->lock_count == 0);
@@ -76,6 +142,10 @@ void kmutex_lock(struct kmutex *m)
 #endif
 
    prepare_to_wait_on(WOBJ_KMUTEX, m, NO_EXTRA, &m->wait_list);
+   curr->blocked_on = m;
+
+   /* Don't let a lower priority owner keep us waiting for too long */
+   kmutex_pi_boost(m, sched_get_prio(curr));
    kmutex_lock_enable_preemption_wrapper(m);
 
    /*
@@ -92,6 +162,7 @@ void kmutex_lock(struct kmutex *m)
 
    /* Now for sure this task should hold the mutex */
    ASSERT(kmutex_is_curr_task_holding_lock(m));
+   ASSERT(curr->blocked_on == NULL);
 
    /*
     * DEBUG check: in case we went to sleep with a recursive mutex, then the
@@ -112,7 +183,7 @@ bool kmutex_trylock(struct kmutex *m)
    if (!m->owner_task) {
 
       /* Nobody owns this mutex, just make this task own it */
-      m->owner_task = get_curr_task();
+      kmutex_set_owner(m, get_curr_task());
       success = true;
 
       if (m->flags & KMUTEX_FL_RECURSIVE)
@@ -140,6 +211,8 @@ bool kmutex_trylock(struct kmutex *m)
 
 void kmutex_unlock(struct kmutex *m)
 {
+   struct task *curr = get_curr_task();
+
    disable_preemption();
 
    DEBUG_ONLY(check_not_in_irq_handler());
@@ -158,6 +231,7 @@ void kmutex_unlock(struct kmutex *m)
    }
 
    m->owner_task = NULL;
+   list_remove(&m->owner_node);
 
    /* Unlock one task waiting to acquire the mutex 'm' (if any) */
    if (!list_is_empty(&m->wait_list)) {
@@ -167,7 +241,9 @@ void kmutex_unlock(struct kmutex *m)
 
       struct task *ti = CONTAINER_OF(task_wo, struct task, wobj);
 
-      m->owner_task = ti;
+      ASSERT(ti->blocked_on == m);
+      ti->blocked_on = NULL;
+      kmutex_set_owner(m, ti);
 
       if (m->flags & KMUTEX_FL_RECURSIVE)
          m->lock_count++;
@@ -175,7 +251,14 @@ void kmutex_unlock(struct kmutex *m)
       ASSERT_TASK_STATE(ti->state, TASK_STATE_SLEEPING);
       wake_up(ti);
 
+      /* The new owner inherits the priority of the remaining waiters */
+      kmutex_pi_update(ti);
+
    } // if (!list_is_empty(&m->wait_list))
 
+   /* Drop the priority we inherited through `m`, if any */
+   if (curr->pi_prio)
+      kmutex_pi_update(curr);
+
    enable_preemption();
 }
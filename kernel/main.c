@@ -17,6 +17,7 @@
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/elf_loader.h>
@@ -31,6 +32,7 @@
 #include <tilck/kernel/self_tests.h>
 #include <tilck/kernel/term.h>
 #include <tilck/kernel/process.h>
+#include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/fs/kernelfs.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/uefi.h>
@@ -362,6 +364,7 @@ kmain(u32 multiboot_magic, u32 mbi_addr)
    kmain_early_checks();
    init_segmentation();
    init_fpu_memcpy();
+   init_page_alloc();
    init_kmalloc();
    init_paging();
 
@@ -374,6 +377,7 @@ kmain(u32 multiboot_magic, u32 mbi_addr)
    init_sched();
    init_syscall_interfaces();
    init_worker_threads();
+   init_mm_reaper();
    init_timer();
    init_system_time();
    init_kernelfs();
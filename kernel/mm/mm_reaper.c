@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_mm.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/page_alloc.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/list.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/worker_thread.h>
+
+/*
+ * MM reaper
+ * ------------
+ *
+ * Destroying a big address space means visiting all of its page tables and
+ * releasing all of its page frames: doing that while exiting or in execve()
+ * puts that cost right on the critical path of waitpid() and of the new
+ * program. Instead, the pdirs owning at least MM_REAPER_MIN_PTS page tables
+ * are handed to a dedicated lowest-priority worker thread, which releases them
+ * a few page tables at a time, sleeping in between to let the user tasks run.
+ *
+ * The page frames held by the pending pdirs are bounded by
+ * MM_REAPER_MAX_PENDING_MEM. Under memory pressure, or when the worker's queue
+ * is full, the teardown is simply synchronous, as before. Finally, when the
+ * page allocator runs out of memory, it calls mm_reaper_flush(), which destroys
+ * all the pending pdirs right away.
+ */
+
+struct mm_reaper_job {
+
+   struct list_node node;
+   pdir_t *pdir;                 /* NULL -> already destroyed by the flush */
+   ulong frames;
+};
+
+static struct list pending_jobs = STATIC_LIST_INIT(pending_jobs);
+static ulong pending_frames;
+static struct worker_thread *mm_reaper_wth;
+
+static bool
+mm_reaper_is_mem_low(void)
+{
+   return page_alloc_get_free_pages() < (MM_REAPER_MIN_FREE_MEM >> PAGE_SHIFT);
+}
+
+static void
+mm_reaper_job_done(struct mm_reaper_job *job)
+{
+   ASSERT(!is_preemption_enabled());
+
+   pdir_destroy(job->pdir);
+   list_remove(&job->node);
+   pending_frames -= job->frames;
+   job->pdir = NULL;
+}
+
+static void
+mm_reaper_job_func(void *arg)
+{
+   struct mm_reaper_job *job = arg;
+   bool done;
+
+   do {
+
+      disable_preemption();
+      {
+         done = !job->pdir ||
+                !pdir_release_user_pts(job->pdir, MM_REAPER_BATCH_PTS);
+
+         if (done && job->pdir)
+            mm_reaper_job_done(job);
+      }
+      enable_preemption();
+
+      /*
+       * Worker threads always run before the user tasks: sleep between the
+       * batches, unless the memory is needed.
+       */
+      if (!done && !mm_reaper_is_mem_low())
+         kernel_sleep(1);
+
+   } while (!done);
+
+   kfree_obj(job, struct mm_reaper_job);
+}
+
+static bool
+mm_reaper_try_defer(pdir_t *pdir)
+{
+   const ulong max_frames = MM_REAPER_MAX_PENDING_MEM >> PAGE_SHIFT;
+   struct mm_reaper_job *job;
+   ulong frames;
+
+   if (pdir_get_owned_pt_count(pdir) < MM_REAPER_MIN_PTS)
+      return false;
+
+   if (mm_reaper_is_mem_low())
+      return false;
+
+   frames = pdir_get_owned_frame_count(pdir);
+
+   if (pending_frames + frames > max_frames)
+      return false;
+
+   if (!(job = kalloc_obj(struct mm_reaper_job)))
+      return false;
+
+   *job = (struct mm_reaper_job) {
+      .pdir = pdir,
+      .frames = frames,
+   };
+
+   if (!wth_enqueue_on(mm_reaper_wth, &mm_reaper_job_func, job)) {
+      kfree_obj(job, struct mm_reaper_job);
+      return false;
+   }
+
+   list_add_tail(&pending_jobs, &job->node);
+   pending_frames += frames;
+   return true;
+}
+
+/*
+ * Destroy synchronously all the pending pdirs. Called by the page allocator
+ * before failing an allocation: returns true if any memory has been released.
+ * The jobs themselves are freed later, by the worker thread.
+ */
+bool
+mm_reaper_flush(void)
+{
+   struct mm_reaper_job *pos, *temp;
+   bool released;
+
+   disable_preemption();
+   {
+      released = !list_is_empty(&pending_jobs);
+
+      list_for_each(pos, temp, &pending_jobs, node) {
+         mm_reaper_job_done(pos);
+      }
+   }
+   enable_preemption();
+   return released;
+}
+
+/*
+ * Destroy an user pdir, not in use anymore. Big pdirs are destroyed later by
+ * the MM reaper, the others right away.
+ */
+void
+mm_reaper_destroy_pdir(pdir_t *pdir)
+{
+   ASSERT(!is_preemption_enabled());
+   ASSERT(pdir != get_curr_pdir());
+
+   if (mm_reaper_wth && mm_reaper_try_defer(pdir))
+      return;
+
+   pdir_destroy(pdir);
+}
+
+void
+init_mm_reaper(void)
+{
+   disable_preemption();
+   {
+      mm_reaper_wth = wth_create_thread("mm_reaper",
+                                        WTH_PRIO_LOWEST,
+                                        WTH_MM_REAPER_QUEUE_SIZE);
+
+      if (!mm_reaper_wth)
+         printk("WARNING: mm_reaper: unable to create the worker thread\n");
+   }
+   enable_preemption();
+}
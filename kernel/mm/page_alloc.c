@@ -0,0 +1,350 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/utils.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/page_alloc.h>
+#include <tilck/kernel/system_mmap.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * Each free block is linked in its zone's free_lists[order] through a node
+ * stored in its first bytes, together with its order: the memory is free,
+ * after all. The only external metadata is one bit per page frame, set when
+ * the frame is the first one of a free block: that's what makes safe to look
+ * at the buddy of a block while freeing it.
+ *
+ * The DMA zone is made by the frames below `dma_end_pfn`, the normal zone by
+ * all the others. No block ever crosses that boundary.
+ */
+
+struct free_block {
+
+   struct list_node node;
+   u32 order;
+};
+
+struct zone {
+
+   struct list free_lists[PAGE_ALLOC_MAX_ORDER + 1];
+   u32 free_blocks[PAGE_ALLOC_MAX_ORDER + 1];
+   ulong tot_pages;
+   ulong free_pages;
+};
+
+static const char *const zone_names[PAGE_ZONES_COUNT] = {
+   [PAGE_ZONE_DMA] = "DMA",
+   [PAGE_ZONE_NORMAL] = "Normal",
+};
+
+static struct zone zones[PAGE_ZONES_COUNT];
+static ulong *free_heads_bitmap;
+static ulong max_pfn;
+static ulong dma_end_pfn;
+static bool page_alloc_initialized;
+
+#define PFN_TO_BLOCK(pfn)                                                   \
+   ((struct free_block *)PA_TO_LIN_VA((ulong)(pfn) << PAGE_SHIFT))
+
+#define VA_TO_PFN(va)                 (LIN_VA_TO_PA(va) >> PAGE_SHIFT)
+
+static ALWAYS_INLINE bool is_free_head(ulong pfn)
+{
+   return !!(free_heads_bitmap[pfn / NBITS] & (1ul << (pfn % NBITS)));
+}
+
+static ALWAYS_INLINE void set_free_head(ulong pfn)
+{
+   free_heads_bitmap[pfn / NBITS] |= (1ul << (pfn % NBITS));
+}
+
+static ALWAYS_INLINE void clear_free_head(ulong pfn)
+{
+   free_heads_bitmap[pfn / NBITS] &= ~(1ul << (pfn % NBITS));
+}
+
+static ALWAYS_INLINE struct zone *pfn_to_zone(ulong pfn)
+{
+   return &zones[pfn < dma_end_pfn ? PAGE_ZONE_DMA : PAGE_ZONE_NORMAL];
+}
+
+static void
+zone_add_free_block(struct zone *z, ulong pfn, u32 order)
+{
+   struct free_block *b = PFN_TO_BLOCK(pfn);
+
+   b->order = order;
+   list_node_init(&b->node);
+   list_add_head(&z->free_lists[order], &b->node);
+   z->free_blocks[order]++;
+   set_free_head(pfn);
+}
+
+static void
+zone_remove_free_block(struct zone *z, ulong pfn, u32 order)
+{
+   struct free_block *b = PFN_TO_BLOCK(pfn);
+
+   ASSERT(b->order == order);
+   list_remove(&b->node);
+   z->free_blocks[order]--;
+   clear_free_head(pfn);
+}
+
+/* Free a block, coalescing it with its buddy as long as possible */
+static void
+zone_free_block(struct zone *z, ulong pfn, u32 order)
+{
+   ASSERT(!is_free_head(pfn));
+   ASSERT((pfn & ((1ul << order) - 1)) == 0);
+
+   z->free_pages += (1ul << order);
+
+   for (; order < PAGE_ALLOC_MAX_ORDER; order++) {
+
+      const ulong buddy = pfn ^ (1ul << order);
+
+      if (buddy >= max_pfn || !is_free_head(buddy))
+         break;
+
+      if (pfn_to_zone(buddy) != z || PFN_TO_BLOCK(buddy)->order != order)
+         break;
+
+      zone_remove_free_block(z, buddy, order);
+      pfn &= ~(1ul << order);
+   }
+
+   zone_add_free_block(z, pfn, order);
+}
+
+static bool
+zone_alloc_block(struct zone *z, u32 order, ulong *pfn_ref)
+{
+   struct free_block *b;
+   ulong pfn;
+   u32 o;
+
+   for (o = order; o <= PAGE_ALLOC_MAX_ORDER; o++)
+      if (!list_is_empty(&z->free_lists[o]))
+         break;
+
+   if (o > PAGE_ALLOC_MAX_ORDER)
+      return false;
+
+   b = list_first_obj(&z->free_lists[o], struct free_block, node);
+   pfn = VA_TO_PFN(b);
+   zone_remove_free_block(z, pfn, o);
+
+   /* Split the block, giving back its upper halves to the free lists */
+   while (o > order) {
+      o--;
+      zone_add_free_block(z, pfn + (1ul << o), o);
+   }
+
+   z->free_pages -= (1ul << order);
+   *pfn_ref = pfn;
+   return true;
+}
+
+void *
+alloc_pages(u32 order, u32 flags)
+{
+   struct zone *z;
+   ulong pfn;
+   bool ok;
+
+   ASSERT(order <= PAGE_ALLOC_MAX_ORDER);
+
+   if (UNLIKELY(!page_alloc_initialized))
+      return NULL;
+
+   z = &zones[(flags & PAGE_ALLOC_FL_DMA) ? PAGE_ZONE_DMA : PAGE_ZONE_NORMAL];
+
+   disable_preemption();
+   {
+      ok = zone_alloc_block(z, order, &pfn);
+
+      if (UNLIKELY(!ok) && mm_reaper_flush()) {
+
+         /* Retry, after destroying the pdirs pending in the MM reaper */
+         ok = zone_alloc_block(z, order, &pfn);
+      }
+   }
+   enable_preemption();
+
+   return ok ? PA_TO_LIN_VA(pfn << PAGE_SHIFT) : NULL;
+}
+
+void
+free_pages(void *vaddr, u32 order)
+{
+   const ulong pfn = VA_TO_PFN(vaddr);
+
+   ASSERT(page_alloc_initialized);
+   ASSERT(order <= PAGE_ALLOC_MAX_ORDER);
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+   ASSERT(pfn + (1ul << order) <= max_pfn);
+
+   disable_preemption();
+   {
+      zone_free_block(pfn_to_zone(pfn), pfn, order);
+   }
+   enable_preemption();
+}
+
+ulong
+page_alloc_get_free_pages(void)
+{
+   ulong tot = 0;
+
+   for (int i = 0; i < PAGE_ZONES_COUNT; i++)
+      tot += zones[i].free_pages;
+
+   return tot;
+}
+
+bool
+debug_page_alloc_get_zone_info(int zone, struct page_zone_info *i)
+{
+   struct zone *z;
+
+   if (zone < 0 || zone >= PAGE_ZONES_COUNT)
+      return false;
+
+   z = &zones[zone];
+
+   disable_preemption();
+   {
+      i->name = zone_names[zone];
+      i->tot_pages = z->tot_pages;
+      i->free_pages = z->free_pages;
+      memcpy(i->free_blocks, z->free_blocks, sizeof(i->free_blocks));
+   }
+   enable_preemption();
+   return true;
+}
+
+/* Add the frames in [pfn, end_pfn) as a sequence of max-size aligned blocks */
+static void
+page_alloc_add_frames(ulong pfn, ulong end_pfn)
+{
+   while (pfn < end_pfn) {
+
+      struct zone *z = pfn_to_zone(pfn);
+      u32 order = 0;
+
+      while (order < PAGE_ALLOC_MAX_ORDER) {
+
+         const ulong next_sz = 1ul << (order + 1);
+
+         if ((pfn & (next_sz - 1)) || pfn + next_sz > end_pfn)
+            break;
+
+         if (pfn < dma_end_pfn && pfn + next_sz > dma_end_pfn)
+            break;
+
+         order++;
+      }
+
+      z->tot_pages += (1ul << order);
+      zone_free_block(z, pfn, order);
+      pfn += (1ul << order);
+   }
+}
+
+static bool
+is_region_usable(struct mem_region *r)
+{
+   return r->type == MULTIBOOT_MEMORY_AVAILABLE &&
+          (!r->extra || r->extra == MEM_REG_EXTRA_DMA);
+}
+
+static void
+page_alloc_find_limits(void)
+{
+   struct mem_region r;
+   ulong end_pfn;
+
+   max_pfn = 0;
+   dma_end_pfn = 0;
+
+   for (int i = 0; i < get_mem_regions_count(); i++) {
+
+      get_mem_region(i, &r);
+
+      if (r.addr >= LINEAR_MAPPING_SIZE)
+         break;
+
+      if (!is_region_usable(&r))
+         continue;
+
+      end_pfn = (ulong)
+         (MIN(r.addr + r.len, (u64)LINEAR_MAPPING_SIZE) >> PAGE_SHIFT);
+
+      max_pfn = MAX(max_pfn, end_pfn);
+
+      if (r.extra == MEM_REG_EXTRA_DMA)
+         dma_end_pfn = MAX(dma_end_pfn, end_pfn);
+   }
+}
+
+void
+init_page_alloc(void)
+{
+   struct mem_region r;
+   ulong vbegin, vend;
+
+   ASSERT(is_kmalloc_initialized());
+
+   page_alloc_initialized = false;
+   bzero(zones, sizeof(zones));
+
+   for (int i = 0; i < PAGE_ZONES_COUNT; i++)
+      for (int j = 0; j <= PAGE_ALLOC_MAX_ORDER; j++)
+         list_init(&zones[i].free_lists[j]);
+
+   page_alloc_find_limits();
+
+   /*
+    * The bitmap is small enough (1 bit per page frame) to fit in kmalloc's
+    * first heap, the only one available at this point.
+    */
+   free_heads_bitmap = kzmalloc(pow2_round_up_at(max_pfn, NBITS) / 8);
+
+   if (!free_heads_bitmap)
+      panic("page_alloc: unable to allocate the bitmap");
+
+   /*
+    * From now on, kmalloc() can grow its heaps by taking blocks from here, as
+    * soon as some memory has been added. That's required to allocate the
+    * page tables while mapping the (many) regions below.
+    */
+   page_alloc_initialized = true;
+
+   for (int i = 0; i < get_mem_regions_count(); i++) {
+
+      get_mem_region(i, &r);
+
+      if (!linear_map_mem_region(&r, &vbegin, &vend))
+         break;
+
+      if (r.type == MULTIBOOT_MEMORY_AVAILABLE) {
+
+         if (is_region_usable(&r)) {
+            page_alloc_add_frames(
+               pow2_round_up_at(LIN_VA_TO_PA(vbegin), PAGE_SIZE) >> PAGE_SHIFT,
+               LIN_VA_TO_PA(vend) >> PAGE_SHIFT
+            );
+         }
+
+         if (vend == LINEAR_MAPPING_END)
+            break;
+      }
+   }
+}
@@ -9,12 +9,26 @@
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/fs/devfs.h>
 #include <tilck/kernel/syscalls.h>
 
 #include <sys/mman.h>      // system header
 
+#ifndef MREMAP_MAYMOVE
+   #define MREMAP_MAYMOVE 1  /* defined by <sys/mman.h> only with _GNU_SOURCE */
+#endif
+
+#ifndef MADV_WILLNEED
+   #define MADV_WILLNEED  3  /* defined by <sys/mman.h> only with _GNU_SOURCE */
+   #define MADV_DONTNEED  4
+#endif
+
+#ifndef MADV_FREE
+   #define MADV_FREE      8
+#endif
+
 char page_size_buf[PAGE_SIZE] ALIGNED_AT(PAGE_SIZE);
 
 static inline void sys_brk_internal(struct process *pi, void *new_brk)
@@ -47,21 +61,40 @@ static inline void sys_brk_internal(struct process *pi, void *new_brk)
 
    vaddr = pi->brk;
 
-   while (vaddr < new_brk) {
+   if (BRK_NO_COW) {
 
-      void *kernel_vaddr = kmalloc(PAGE_SIZE);
+      while (vaddr < new_brk) {
 
-      if (!kernel_vaddr)
-         break; /* we've allocated as much as possible */
+         void *kernel_vaddr = alloc_zeroed_page();
 
-      const ulong paddr = LIN_VA_TO_PA(kernel_vaddr);
+         if (!kernel_vaddr)
+            break; /* we've allocated as much as possible */
 
-      if (map_page(pi->pdir, vaddr, paddr, PAGING_FL_RWUS) != 0) {
-         kfree2(kernel_vaddr, PAGE_SIZE);
-         break;
+         const ulong paddr = LIN_VA_TO_PA(kernel_vaddr);
+
+         if (map_page(pi->pdir, vaddr, paddr, PAGING_FL_RWUS) != 0) {
+            free_page(kernel_vaddr);
+            break;
+         }
+
+         vaddr += PAGE_SIZE;
       }
 
-      vaddr += PAGE_SIZE;
+   } else {
+
+      /*
+       * Just reserve the range by mapping the zero-page + COW, like mmap()
+       * does: the actual pages will be allocated on the first write, by
+       * handle_potential_cow(). Programs often grow the heap by much more
+       * than they will ever touch.
+       */
+
+      const size_t page_count = (size_t)(new_brk - vaddr) >> PAGE_SHIFT;
+
+      vaddr += map_zero_pages(pi->pdir,
+                              vaddr,
+                              page_count,
+                              PAGING_FL_US | PAGING_FL_RW) << PAGE_SHIFT;
    }
 
    /* We're done. */
@@ -447,3 +480,281 @@ int sys_munmap(void *vaddrp, size_t len)
    enable_preemption();
    return rc;
 }
+
+/* Grow the anonymous mapping `um`, ending at `vaddr + old_len`, in-place */
+static bool
+mremap_grow_in_place(struct process *pi,
+                     struct user_mapping *um,
+                     ulong vaddr,
+                     size_t old_len,
+                     size_t new_len)
+{
+   void *const end = (void *)(vaddr + old_len);
+   const size_t grow_len = new_len - old_len;
+
+   ASSERT(vaddr + old_len == um->vaddr + um->len);
+
+   if (!per_heap_kmalloc_at(pi->mi->mmap_heap, end, grow_len, PAGE_SIZE))
+      return false;
+
+   if (MMAP_NO_COW)
+      bzero(end, grow_len);
+
+   um->len += grow_len;
+   return true;
+}
+
+/*
+ * Move the anonymous memory at [vaddr, vaddr + old_len) to a new mapping of
+ * `new_len` bytes. No data is copied: the PTEs of the old pages are swapped
+ * with the ones of the (zero) pages at the beginning of the new mapping, which
+ * are then released by unmapping the old range.
+ */
+static long
+mremap_move(struct process *pi,
+            struct user_mapping *um,
+            ulong vaddr,
+            size_t old_len,
+            size_t new_len)
+{
+   const size_t old_pages = old_len >> PAGE_SHIFT;
+   struct user_mapping *new_um;
+   size_t actual_len = new_len;
+
+   new_um = mmap_on_user_heap(pi,
+                              &actual_len,
+                              NULL,
+                              KMALLOC_FL_MULTI_STEP | PAGE_SIZE,
+                              0,
+                              um->prot);
+
+   if (!new_um)
+      return -ENOMEM;
+
+   ASSERT(actual_len == new_len);
+
+   if (swap_pages(pi->pdir, (void *)vaddr, new_um->vaddrp, old_pages))
+      goto oom;
+
+   if (munmap_int(pi, (void *)vaddr, old_len)) {
+
+      /* Cannot fail: the page tables have been already unshared */
+      VERIFY(!swap_pages(pi->pdir, (void *)vaddr, new_um->vaddrp, old_pages));
+      goto oom;
+   }
+
+   if (MMAP_NO_COW)
+      bzero(new_um->vaddrp + old_len, new_len - old_len);
+
+   return (long)new_um->vaddr;
+
+oom:
+   mmap_err_case_free(pi, new_um->vaddrp, actual_len);
+   process_remove_user_mapping(new_um);
+   return -ENOMEM;
+}
+
+static long
+mremap_int(struct process *pi,
+           ulong vaddr,
+           size_t old_len,
+           size_t new_len,
+           int flags)
+{
+   struct user_mapping *um;
+   int rc;
+
+   ASSERT(!is_preemption_enabled());
+   um = process_get_user_mapping((void *)vaddr);
+
+   if (!um || vaddr + old_len > um->vaddr + um->len)
+      return -EFAULT; /* the old range must be in a single mapping */
+
+   if (new_len <= old_len) {
+
+      if (new_len < old_len) {
+         rc = munmap_int(pi, (void *)(vaddr + new_len), old_len - new_len);
+
+         if (rc)
+            return rc;
+      }
+
+      return (long)vaddr;
+   }
+
+   if (um->h)
+      return -EINVAL; /* growing file mappings is not supported */
+
+   if (vaddr + old_len == um->vaddr + um->len)
+      if (mremap_grow_in_place(pi, um, vaddr, old_len, new_len))
+         return (long)vaddr;
+
+   if (!(flags & MREMAP_MAYMOVE))
+      return -ENOMEM;
+
+   return mremap_move(pi, um, vaddr, old_len, new_len);
+}
+
+long
+sys_mremap(void *old_addr,
+           size_t old_size,
+           size_t new_size,
+           int flags,
+           void *new_addr)
+{
+   struct process *pi = get_curr_proc();
+   const ulong vaddr = (ulong)old_addr;
+   size_t old_len, new_len;
+   long rc;
+
+   if (flags & ~MREMAP_MAYMOVE)
+      return -EINVAL; /* MREMAP_FIXED and MREMAP_DONTUNMAP are not supported */
+
+   if (!old_size || !new_size || (vaddr & OFFSET_IN_PAGE_MASK))
+      return -EINVAL;
+
+   if (!pi->mi)
+      return -EFAULT;
+
+   if (!IN_RANGE(vaddr,
+                 USER_MMAP_BEGIN,
+                 USER_MMAP_BEGIN + pi->mi->mmap_heap_size))
+   {
+      return -EFAULT;
+   }
+
+   old_len = pow2_round_up_at(old_size, PAGE_SIZE);
+   new_len = pow2_round_up_at(new_size, PAGE_SIZE);
+
+   disable_preemption();
+   {
+      rc = mremap_int(pi, vaddr, old_len, new_len, flags);
+   }
+   enable_preemption();
+   return rc;
+}
+
+/*
+ * Drop the pages of the private anonymous memory in [va, end) by mapping the
+ * zero page in their place: the next writes will get new zeroed pages through
+ * COW, exactly as right after mmap(). The page frames are actually released
+ * only when no other process (after fork) is using them.
+ */
+static void
+madvise_drop_anon_pages(struct process *pi, ulong va, ulong end)
+{
+   const ulong zero_pa = KERNEL_VA_TO_PA(&zero_page);
+   ulong pa;
+
+   for (; va < end; va += PAGE_SIZE) {
+
+      if (get_mapping2(pi->pdir, (void *)va, &pa) < 0)
+         continue;
+
+      if (pa == zero_pa)
+         continue; /* nothing to drop */
+
+      unmap_page(pi->pdir, (void *)va, true);
+
+      /* Cannot fail: unmap_page() has already unshared the page table */
+      VERIFY(!map_zero_page(pi->pdir, (void *)va, PAGING_FL_US | PAGING_FL_RW));
+   }
+}
+
+/*
+ * Map in a single batch all the pages of the file mapping `um` in [va, end)
+ * which are backed by the file, but not mapped yet: the FS skips the others.
+ */
+static int
+madvise_prefault(struct process *pi,
+                 struct user_mapping *um,
+                 ulong va,
+                 ulong end)
+{
+   struct user_mapping range = *um;
+
+   range.vaddr = va;
+   range.off = um->off + (va - um->vaddr);
+   range.len = end - va;
+
+   return vfs_mmap(&range, pi->pdir, VFS_MM_PREFAULT | VFS_MM_DONT_REGISTER);
+}
+
+static int
+madvise_int(struct process *pi, ulong va, ulong end, int advice)
+{
+   struct user_mapping *um;
+   ulong chunk_end;
+   int rc = 0;
+
+   ASSERT(!is_preemption_enabled());
+
+   for (; va < end; va = chunk_end) {
+
+      if ((um = process_get_user_mapping((void *)va))) {
+
+         chunk_end = MIN(end, um->vaddr + um->len);
+
+         if (um->h) {
+
+            if (advice == MADV_WILLNEED)
+               madvise_prefault(pi, um, va, chunk_end); /* just a hint */
+            else if (advice == MADV_FREE)
+               rc = -EINVAL; /* Linux supports it only on anonymous memory */
+
+            /*
+             * MADV_DONTNEED is a no-op on our (shared) file mappings: their
+             * pages belong to the file, and so their contents.
+             */
+            continue;
+         }
+
+      } else if (IN_RANGE(va, (ulong)pi->initial_brk, (ulong)pi->brk)) {
+
+         chunk_end = MIN(end, (ulong)pi->brk);
+
+      } else {
+
+         /* Not mapped: skip the page, but report it [Linux behavior] */
+         chunk_end = va + PAGE_SIZE;
+         rc = -ENOMEM;
+         continue;
+      }
+
+      /* Private anonymous memory: a mmap() mapping or the brk heap */
+      if (advice == MADV_DONTNEED || advice == MADV_FREE)
+         madvise_drop_anon_pages(pi, va, chunk_end);
+   }
+
+   return rc;
+}
+
+int sys_madvise(void *addr, size_t len, int advice)
+{
+   struct process *pi = get_curr_proc();
+   const ulong vaddr = (ulong)addr;
+   ulong end;
+   int rc;
+
+   if (vaddr & OFFSET_IN_PAGE_MASK)
+      return -EINVAL;
+
+   if (advice != MADV_WILLNEED &&
+       advice != MADV_DONTNEED &&
+       advice != MADV_FREE)
+   {
+      return 0; /* Just ignore all the other hints */
+   }
+
+   end = vaddr + pow2_round_up_at(len, PAGE_SIZE);
+
+   if (end < vaddr || end > USERMODE_VADDR_END)
+      return -ENOMEM;
+
+   disable_preemption();
+   {
+      rc = madvise_int(pi, vaddr, end, advice);
+   }
+   enable_preemption();
+   return rc;
+}
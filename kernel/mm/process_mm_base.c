@@ -1,8 +1,13 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <tilck_gen_headers/config_mm.h>
+
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/page_alloc.h>
+
+DEF_KMEM_CACHE(user_mapping_cache, struct user_mapping, NULL);
 
 struct user_mapping *
 process_add_user_mapping(fs_handle h,
@@ -19,7 +24,7 @@ process_add_user_mapping(fs_handle h,
    ASSERT(!process_get_user_mapping(vaddr));
    ASSERT(pi->mi);
 
-   if (!(um = kzalloc_obj(struct user_mapping)))
+   if (!(um = kmem_cache_zalloc(&user_mapping_cache)))
       return NULL;
 
    list_node_init(&um->pi_node);
@@ -42,7 +47,7 @@ void process_remove_user_mapping(struct user_mapping *um)
 
    list_remove(&um->pi_node);
    list_remove(&um->inode_node);
-   kfree_obj(um, struct user_mapping);
+   kmem_cache_free(&user_mapping_cache, um);
 }
 
 struct user_mapping *process_get_user_mapping(void *vaddrp)
@@ -77,6 +82,17 @@ struct user_mapping *process_get_user_mapping(void *vaddrp)
    return NULL;
 }
 
+/* Tell if [vaddr, vaddr + len) is all in a single anonymous mapping */
+bool user_is_anon_mapping(ulong vaddr, size_t len)
+{
+   struct user_mapping *um = process_get_user_mapping((void *)vaddr);
+
+   if (!um || um->h)
+      return false;
+
+   return vaddr + len <= um->vaddr + um->len;
+}
+
 void remove_all_user_zero_mem_mappings(struct process *pi)
 {
    struct user_mapping *um;
@@ -168,7 +184,7 @@ duplicate_mappings_info(struct process *new_pi, struct mappings_info *mi)
 
    list_for_each_ro(um, &mi->mappings, pi_node) {
 
-      if (!(um2 = kalloc_obj(struct user_mapping)))
+      if (!(um2 = kmem_cache_alloc(&user_mapping_cache)))
          goto oom_case;
 
       /* First just copy the mapping info */
@@ -205,7 +221,7 @@ oom_case:
 
       list_for_each(um, um2, &new_mi->mappings, pi_node) {
          list_remove(&um->pi_node);
-         kfree_obj(um, struct user_mapping);
+         kmem_cache_free(&user_mapping_cache, um);
       }
 
       kfree_obj(new_mi, struct mappings_info);
@@ -228,7 +244,7 @@ void user_vfree_and_unmap(ulong user_vaddr, size_t page_count)
    }
 }
 
-bool user_valloc_and_map_slow(ulong user_vaddr, size_t page_count)
+bool user_valloc_and_map(ulong user_vaddr, size_t page_count)
 {
    pdir_t *pdir = get_curr_pdir();
    ulong pa, va = user_vaddr;
@@ -241,7 +257,7 @@ bool user_valloc_and_map_slow(ulong user_vaddr, size_t page_count)
          return false;
       }
 
-      if (!(kernel_vaddr = kmalloc(PAGE_SIZE))) {
+      if (!(kernel_vaddr = alloc_page())) {
          user_vfree_and_unmap(user_vaddr, i);
          return false;
       }
@@ -249,7 +265,7 @@ bool user_valloc_and_map_slow(ulong user_vaddr, size_t page_count)
       pa = LIN_VA_TO_PA(kernel_vaddr);
 
       if (map_page(pdir, (void *)va, pa, PAGING_FL_RWUS) != 0) {
-         kfree2(kernel_vaddr, PAGE_SIZE);
+         free_page(kernel_vaddr);
          user_vfree_and_unmap(user_vaddr, i);
          return false;
       }
@@ -258,37 +274,6 @@ bool user_valloc_and_map_slow(ulong user_vaddr, size_t page_count)
    return true;
 }
 
-bool user_valloc_and_map(ulong user_vaddr, size_t page_count)
-{
-   pdir_t *pdir = get_curr_pdir();
-   size_t size = (size_t)page_count << PAGE_SHIFT;
-   size_t count;
-
-   void *kernel_vaddr =
-      general_kmalloc(&size, KMALLOC_FL_MULTI_STEP | PAGE_SIZE);
-
-   if (!kernel_vaddr)
-      return user_valloc_and_map_slow(user_vaddr, page_count);
-
-   ASSERT(size == (size_t)page_count << PAGE_SHIFT);
-
-   count = map_pages(pdir,
-                     (void *)user_vaddr,
-                     LIN_VA_TO_PA(kernel_vaddr),
-                     page_count,
-                     PAGING_FL_US | PAGING_FL_RW);
-
-   if (count != page_count) {
-      unmap_pages(pdir, (void *)user_vaddr, count, false);
-      general_kfree(kernel_vaddr,
-                    &size,
-                    KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
-      return false;
-   }
-
-   return true;
-}
-
 void user_unmap_zero_page(ulong user_vaddr, size_t page_count)
 {
    pdir_t *pdir = get_curr_pdir();
@@ -310,6 +295,61 @@ bool user_map_zero_page(ulong user_vaddr, size_t page_count)
    return true;
 }
 
+/*
+ * Grow the stack of the current process down to `vaddr`, after a fault on a
+ * non-present page below its current bottom. The faulting page gets a real
+ * page immediately, while the ones between it and the old bottom (if any) are
+ * zero-mapped, like the rest of the anonymous memory. The stack cannot grow
+ * beyond USER_STACK_PAGES, nor closer than USER_STACK_GUARD_GAP to any other
+ * mapping below it.
+ */
+bool user_stack_try_grow(ulong vaddr)
+{
+   struct process *pi = get_curr_proc();
+   const ulong bottom = (ulong)pi->stack_bottom;
+   const ulong limit = USERMODE_VADDR_END - USER_STACK_PAGES * PAGE_SIZE;
+   const ulong new_bottom = vaddr & PAGE_MASK;
+   ulong va;
+   int rc;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (!bottom || vaddr >= bottom || new_bottom < limit)
+      return false;
+
+   va = new_bottom - USER_STACK_GUARD_GAP;
+
+   for (; va < new_bottom; va += PAGE_SIZE)
+      if (is_mapped(pi->pdir, (void *)va))
+         return false;
+
+   for (va = bottom - PAGE_SIZE; va >= new_bottom; va -= PAGE_SIZE) {
+
+      /* After vfork(), the child might have already grown the shared stack */
+      if (!is_mapped(pi->pdir, (void *)va)) {
+
+         if (va == new_bottom || MMAP_NO_COW)
+            rc = map_page(pi->pdir,
+                          (void *)va,
+                          0,
+                          PAGING_FL_RWUS |
+                          PAGING_FL_DO_ALLOC |
+                          PAGING_FL_ZERO_PG);
+         else
+            rc = map_zero_page(pi->pdir,
+                               (void *)va,
+                               PAGING_FL_US | PAGING_FL_RW);
+
+         if (rc)
+            break; /* Out of memory: keep what we've mapped so far */
+      }
+
+      pi->stack_bottom = (void *)va;
+   }
+
+   return pi->stack_bottom == (void *)new_bottom;
+}
+
 int generic_fs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
 {
    struct fs_handle_base *hb = um->h;
@@ -27,25 +27,105 @@ struct pipe {
    ATOMIC(int) write_handles;
 };
 
-static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
+static size_t iov_total_len(const struct iovec *iov, int iovcnt)
+{
+   size_t tot = 0;
+
+   for (int i = 0; i < iovcnt; i++)
+      tot += iov[i].iov_len;
+
+   return tot;
+}
+
+/*
+ * Move data from the pipe's ring buffer to the segments in `iov`, stopping at
+ * the first one which cannot be filled. Returns -EFAULT only when nothing has
+ * been read.
+ */
+static ssize_t
+pipe_rb_read_iov(struct pipe *p,
+                 const struct iovec *iov,
+                 int iovcnt,
+                 bool user)
+{
+   ssize_t tot = 0;
+   ssize_t rc;
+
+   for (int i = 0; i < iovcnt; i++) {
+
+      if (user)
+         rc = ringbuf_read_bytes_user(&p->rb, iov[i].iov_base, iov[i].iov_len);
+      else
+         rc = (ssize_t)ringbuf_read_bytes(&p->rb,
+                                          iov[i].iov_base,
+                                          iov[i].iov_len);
+
+      if (rc < 0)
+         return tot ? tot : rc;
+
+      tot += rc;
+
+      if ((size_t)rc < iov[i].iov_len)
+         break;
+   }
+
+   return tot;
+}
+
+/* The write counterpart of pipe_rb_read_iov() */
+static ssize_t
+pipe_rb_write_iov(struct pipe *p,
+                  const struct iovec *iov,
+                  int iovcnt,
+                  bool user)
+{
+   ssize_t tot = 0;
+   ssize_t rc;
+
+   for (int i = 0; i < iovcnt; i++) {
+
+      if (user)
+         rc = ringbuf_write_bytes_user(&p->rb, iov[i].iov_base, iov[i].iov_len);
+      else
+         rc = (ssize_t)ringbuf_write_bytes(&p->rb,
+                                           iov[i].iov_base,
+                                           iov[i].iov_len);
+
+      if (rc < 0)
+         return tot ? tot : rc;
+
+      tot += rc;
+
+      if ((size_t)rc < iov[i].iov_len)
+         break;
+   }
+
+   return tot;
+}
+
+/*
+ * Read from the pipe into all the segments in `iov`, holding the pipe's lock
+ * just once. Like read(), it blocks only while the pipe is empty.
+ */
+static ssize_t
+pipe_readv_int(fs_handle h, const struct iovec *iov, int iovcnt, bool user)
 {
    struct kfs_handle *kh = h;
    struct pipe *p = (void *)kh->kobj;
    bool sig_pending = false;
    ssize_t rc = 0;
-   ASSERT(*pos == 0);
 
-   if (!size)
+   if (!iov_total_len(iov, iovcnt))
       return 0;
 
    kmutex_lock(&p->mutex);
 
    while (true) {
 
-      rc = (ssize_t)ringbuf_read_bytes(&p->rb, (u8 *)buf, size);
+      rc = pipe_rb_read_iov(p, iov, iovcnt, user);
 
       if (rc)
-         break; /* Everything is alright, we read something */
+         break; /* We read something (or got -EFAULT) */
 
       if (atomic_load_explicit(&p->write_handles, mo_relaxed) == 0) {
          /* No more writers, always return 0, no matter what. */
@@ -91,15 +171,43 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
    return !sig_pending ? rc : -EINTR;
 }
 
-static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
+static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   const struct iovec iov = { .iov_base = buf, .iov_len = size };
+
+   ASSERT(*pos == 0);
+   return pipe_readv_int(h, &iov, 1, false);
+}
+
+static ssize_t pipe_read_user(fs_handle h, char *u_buf, size_t size, offt *pos)
+{
+   const struct iovec iov = { .iov_base = u_buf, .iov_len = size };
+
+   ASSERT(*pos == 0);
+   return pipe_readv_int(h, &iov, 1, true);
+}
+
+static ssize_t
+pipe_readv(fs_handle h, const struct iovec *iov, int iovcnt, offt *pos)
+{
+   ASSERT(*pos == 0);
+   return pipe_readv_int(h, iov, iovcnt, true);
+}
+
+/*
+ * Write all the segments in `iov` to the pipe, holding the pipe's lock just
+ * once: the data fitting in the pipe cannot get interleaved with the data of
+ * other writers. Like write(), it blocks only while the pipe is full.
+ */
+static ssize_t
+pipe_writev_int(fs_handle h, const struct iovec *iov, int iovcnt, bool user)
 {
    struct kfs_handle *kh = h;
    struct pipe *p = (void *)kh->kobj;
    bool sig_pending = false;
    ssize_t rc = 0;
-   ASSERT(*pos == 0);
 
-   if (!size)
+   if (!iov_total_len(iov, iovcnt))
       return 0;
 
    kmutex_lock(&p->mutex);
@@ -114,10 +222,10 @@ static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
          break;
       }
 
-      rc = (ssize_t)ringbuf_write_bytes(&p->rb, (u8 *)buf, size);
+      rc = pipe_rb_write_iov(p, iov, iovcnt, user);
 
       if (rc)
-         break; /* Everything is alright, we wrote something */
+         break; /* We wrote something (or got -EFAULT) */
 
       if (kh->fl_flags & O_NONBLOCK) {
          rc = -EAGAIN;
@@ -150,6 +258,30 @@ static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
    return !sig_pending ? rc : -EINTR;
 }
 
+static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   const struct iovec iov = { .iov_base = buf, .iov_len = size };
+
+   ASSERT(*pos == 0);
+   return pipe_writev_int(h, &iov, 1, false);
+}
+
+static ssize_t
+pipe_write_user(fs_handle h, char *u_buf, size_t size, offt *pos)
+{
+   const struct iovec iov = { .iov_base = u_buf, .iov_len = size };
+
+   ASSERT(*pos == 0);
+   return pipe_writev_int(h, &iov, 1, true);
+}
+
+static ssize_t
+pipe_writev(fs_handle h, const struct iovec *iov, int iovcnt, offt *pos)
+{
+   ASSERT(*pos == 0);
+   return pipe_writev_int(h, iov, iovcnt, true);
+}
+
 static int pipe_read_ready(fs_handle h)
 {
    struct kfs_handle *kh = h;
@@ -222,6 +354,8 @@ static struct kcond *pipe_get_except_cond(fs_handle h)
 static const struct file_ops static_ops_pipe_read_end =
 {
    .read = pipe_read,
+   .read_user = pipe_read_user,
+   .readv = pipe_readv,
    .read_ready = pipe_read_ready,
    .except_ready = pipe_except_ready,
    .get_rready_cond = pipe_get_rready_cond,
@@ -231,6 +365,8 @@ static const struct file_ops static_ops_pipe_read_end =
 static const struct file_ops static_ops_pipe_write_end =
 {
    .write = pipe_write,
+   .write_user = pipe_write_user,
+   .writev = pipe_writev,
    .except_ready = pipe_except_ready,
    .write_ready = pipe_write_ready,
    .get_wready_cond = pipe_get_wready_cond,
@@ -327,3 +463,10 @@ fs_handle pipe_create_write_handle(struct pipe *p)
 
    return res;
 }
+
+bool is_pipe(fs_handle h)
+{
+   const struct file_ops *fops = ((struct fs_handle_base *)h)->fops;
+   return fops == &static_ops_pipe_read_end ||
+          fops == &static_ops_pipe_write_end;
+}
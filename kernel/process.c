@@ -23,6 +23,12 @@ STATIC_ASSERT(IS_PAGE_ALIGNED(KERNEL_STACK_SIZE));
 STATIC_ASSERT(IS_PAGE_ALIGNED(IO_COPYBUF_SIZE));
 STATIC_ASSERT(IS_PAGE_ALIGNED(ARGS_COPYBUF_SIZE));
 
+/* Main tasks are allocated together with their process (see process.h) */
+static struct kmem_cache process_cache =
+   KMEM_CACHE_INIT("process", TOT_PROC_AND_TASK_SIZE, NULL);
+
+DEF_KMEM_CACHE(thread_cache, struct task, NULL);
+
 #define ISOLATED_STACK_HI_VMEM_SPACE   (KERNEL_STACK_SIZE + (2 * PAGE_SIZE))
 
 static void *alloc_kernel_isolated_stack(struct process *pi)
@@ -186,6 +192,7 @@ void init_task_lists(struct task *ti)
 
    list_init(&ti->tasks_waiting_list);
    list_init(&ti->on_exit);
+   list_init(&ti->held_mutexes);
    bzero(&ti->wobj, sizeof(struct wait_obj));
 }
 
@@ -203,7 +210,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    bool common_allocs = false;
    bool arch_fields = false;
 
-   if (UNLIKELY(!(ti = kmalloc(TOT_PROC_AND_TASK_SIZE))))
+   if (UNLIKELY(!(ti = kmem_cache_alloc(&process_cache))))
       goto oom_case;
 
    pi = (struct process *)(ti + 1);
@@ -254,6 +261,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    ti->tid = pid;
    ti->is_main_thread = true;
    ti->timer_ready = false;
+   ti->pi_prio = 0;
 
    /*
     * From fork(2):
@@ -267,6 +275,8 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
 
    /* Reset sched ticks in the new process */
    bzero(&ti->ticks, sizeof(ti->ticks));
+   bzero(&ti->stats, sizeof(ti->stats));
+   ti->state_change_ns = 0;
 
    /* Copy parent's `cwd` while retaining the `fs` and the inode obj */
    process_set_cwd2_nolock_raw(pi, &parent_pi->cwd);
@@ -305,7 +315,7 @@ oom_case:
       if (MOD_debugpanel && pi->debug_cmdline)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
 
-      kfree2(ti, TOT_PROC_AND_TASK_SIZE);
+      kmem_cache_free(&process_cache, ti);
    }
 
    return NULL;
@@ -315,14 +325,14 @@ struct task *allocate_new_thread(struct process *pi, int tid, bool alloc_bufs)
 {
    ASSERT(pi != NULL);
    struct task *process_task = get_process_task(pi);
-   struct task *ti = kzalloc_obj(struct task);
+   struct task *ti = kmem_cache_zalloc(&thread_cache);
 
    if (!ti || !(ti->pi = pi) || !do_common_task_allocs(ti, alloc_bufs)) {
 
       if (ti) /* do_common_task_allocs() failed */
          free_common_task_allocs(ti);
 
-      kfree_obj(ti, struct task);
+      kmem_cache_free(&thread_cache, ti);
       return NULL;
    }
 
@@ -354,10 +364,12 @@ static void free_process_int(struct process *pi)
    if (release_obj(pi) == 0) {
 
       arch_specific_free_proc(pi);
-      kfree2(get_process_task(pi), TOT_PROC_AND_TASK_SIZE);
 
       if (MOD_debugpanel)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
+
+      /* NOTE: `pi` lives in the same allocation of its main task */
+      kmem_cache_free(&process_cache, get_process_task(pi));
    }
 }
 
@@ -375,7 +387,7 @@ void free_task(struct task *ti)
    if (is_main_thread(ti))
       free_process_int(ti->pi);
    else
-      kfree_obj(ti, struct task);
+      kmem_cache_free(&thread_cache, ti);
 }
 
 void *task_temp_kernel_alloc(size_t size)
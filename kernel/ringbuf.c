@@ -5,6 +5,8 @@
 
 #include <tilck/kernel/ringbuf.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/errno.h>
 
 extern inline void ringbuf_reset(struct ringbuf *rb);
 extern inline bool ringbuf_write_elem1(struct ringbuf *rb, u8 val);
@@ -42,12 +44,31 @@ bool ringbuf_write_elem(struct ringbuf *rb, void *elem_ptr)
    return true;
 }
 
-size_t ringbuf_write_bytes(struct ringbuf *rb, u8 *buf, size_t len)
+/*
+ * Copy func used by the *_bytes() funcs below: like copy_to_user() and
+ * copy_from_user(), it returns 0 on success and a negative value on fault.
+ */
+typedef int (*ringbuf_copy_func)(void *dest, const void *src, size_t n);
+
+static int ringbuf_memcpy(void *dest, const void *src, size_t n)
+{
+   memcpy(dest, src, n);
+   return 0;
+}
+
+static size_t
+ringbuf_write_bytes_int(struct ringbuf *rb,
+                        const u8 *buf,
+                        size_t len,
+                        ringbuf_copy_func copy,
+                        bool *fault)
 {
    size_t actual_len;
    size_t actual_len2;
    ASSERT(rb->elem_size == 1);
 
+   *fault = false;
+
    if (ringbuf_is_full(rb))
       return 0;
 
@@ -85,7 +106,10 @@ size_t ringbuf_write_bytes(struct ringbuf *rb, u8 *buf, size_t len)
    if (rb->write_pos < rb->read_pos) {
 
       actual_len = MIN(len, rb->read_pos - rb->write_pos);
-      memcpy(rb->buf + rb->write_pos, buf, actual_len);
+
+      if ((*fault = copy(rb->buf + rb->write_pos, buf, actual_len) < 0))
+         return 0;
+
       rb->write_pos += actual_len;
       rb->elems += actual_len;
       return actual_len;
@@ -93,7 +117,10 @@ size_t ringbuf_write_bytes(struct ringbuf *rb, u8 *buf, size_t len)
 
    /* Part one */
    actual_len = MIN(len, rb->max_elems - rb->write_pos);
-   memcpy(rb->buf + rb->write_pos, buf, actual_len);
+
+   if ((*fault = copy(rb->buf + rb->write_pos, buf, actual_len) < 0))
+      return 0;
+
    rb->write_pos = (rb->write_pos + actual_len) % rb->max_elems;
    rb->elems += actual_len;
 
@@ -106,19 +133,47 @@ size_t ringbuf_write_bytes(struct ringbuf *rb, u8 *buf, size_t len)
    /* Part two */
    ASSERT(rb->write_pos == 0);
    actual_len2 = MIN(len - actual_len, rb->read_pos);
-   memcpy(rb->buf, buf + actual_len, actual_len2);
+
+   if ((*fault = copy(rb->buf, buf + actual_len, actual_len2) < 0))
+      return actual_len;
+
    rb->write_pos += actual_len2;
    rb->elems += actual_len2;
 
    return actual_len + actual_len2;
 }
 
-size_t ringbuf_read_bytes(struct ringbuf *rb, u8 *buf, size_t len)
+size_t ringbuf_write_bytes(struct ringbuf *rb, u8 *buf, size_t len)
+{
+   bool fault;
+   return ringbuf_write_bytes_int(rb, buf, len, &ringbuf_memcpy, &fault);
+}
+
+/*
+ * Like ringbuf_write_bytes(), but reading from an user buffer. Returns -EFAULT
+ * when a fault occurred before any byte could be written.
+ */
+ssize_t
+ringbuf_write_bytes_user(struct ringbuf *rb, const void *u_buf, size_t len)
+{
+   bool fault;
+   size_t rc = ringbuf_write_bytes_int(rb, u_buf, len, &copy_from_user, &fault);
+   return (!rc && fault) ? -EFAULT : (ssize_t)rc;
+}
+
+static size_t
+ringbuf_read_bytes_int(struct ringbuf *rb,
+                       u8 *buf,
+                       size_t len,
+                       ringbuf_copy_func copy,
+                       bool *fault)
 {
    size_t actual_len;
    size_t actual_len2;
    ASSERT(rb->elem_size == 1);
 
+   *fault = false;
+
    if (ringbuf_is_empty(rb))
       return 0;
 
@@ -152,7 +207,10 @@ size_t ringbuf_read_bytes(struct ringbuf *rb, u8 *buf, size_t len)
    if (rb->read_pos < rb->write_pos) {
 
       actual_len = MIN(len, rb->write_pos - rb->read_pos);
-      memcpy(buf, rb->buf + rb->read_pos, actual_len);
+
+      if ((*fault = copy(buf, rb->buf + rb->read_pos, actual_len) < 0))
+         return 0;
+
       rb->read_pos += actual_len;
       rb->elems -= actual_len;
       return actual_len;
@@ -160,7 +218,10 @@ size_t ringbuf_read_bytes(struct ringbuf *rb, u8 *buf, size_t len)
 
    /* Part one */
    actual_len = MIN(len, rb->max_elems - rb->read_pos);
-   memcpy(buf, rb->buf + rb->read_pos, actual_len);
+
+   if ((*fault = copy(buf, rb->buf + rb->read_pos, actual_len) < 0))
+      return 0;
+
    rb->read_pos = (rb->read_pos + actual_len) % rb->max_elems;
    rb->elems -= actual_len;
 
@@ -173,13 +234,33 @@ size_t ringbuf_read_bytes(struct ringbuf *rb, u8 *buf, size_t len)
    /* Part two */
    ASSERT(rb->read_pos == 0);
    actual_len2 = MIN(len - actual_len, rb->write_pos);
-   memcpy(buf + actual_len, rb->buf, actual_len2);
+
+   if ((*fault = copy(buf + actual_len, rb->buf, actual_len2) < 0))
+      return actual_len;
+
    rb->read_pos += actual_len2;
    rb->elems -= actual_len2;
 
    return actual_len + actual_len2;
 }
 
+size_t ringbuf_read_bytes(struct ringbuf *rb, u8 *buf, size_t len)
+{
+   bool fault;
+   return ringbuf_read_bytes_int(rb, buf, len, &ringbuf_memcpy, &fault);
+}
+
+/*
+ * Like ringbuf_read_bytes(), but writing to an user buffer. Returns -EFAULT
+ * when a fault occurred before any byte could be read.
+ */
+ssize_t ringbuf_read_bytes_user(struct ringbuf *rb, void *u_buf, size_t len)
+{
+   bool fault;
+   size_t rc = ringbuf_read_bytes_int(rb, u_buf, len, &copy_to_user, &fault);
+   return (!rc && fault) ? -EFAULT : (ssize_t)rc;
+}
+
 bool ringbuf_read_elem(struct ringbuf *rb, void *elem_ptr /* out */)
 {
    if (ringbuf_is_empty(rb))
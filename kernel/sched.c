@@ -20,9 +20,6 @@ ATOMIC(int) __need_resched;               /* see docs/atomics.md */
 struct task *kernel_process;
 struct process *kernel_process_pi;
 
-/* Task lists */
-struct list runnable_tasks_list;
-
 /* Static variables */
 static struct task *tree_by_tid_root;
 static u64 idle_ticks;
@@ -30,6 +27,38 @@ static volatile int runnable_tasks_count;
 static int current_max_pid = -1;
 static int current_max_kernel_tid = -1;
 struct task *idle_task;
+static struct sched_stats sched_global_stats;
+
+/*
+ * Runqueue
+ * ---------------------
+ *
+ * The runnable tasks are kept in an AVL tree ordered by vruntime, with the
+ * task having the lowest vruntime cached in `rq_leftmost`. In order to keep
+ * the round-robin behavior between tasks having the same vruntime, the ties
+ * are broken by using a sequence number incremented at each insertion.
+ *
+ * Tasks that have just been woken-up by their timer (`timer_ready` is set)
+ * are kept instead in the `timer_ready_tasks_list`, because they have to be
+ * selected before any other runnable task. Finally, worker threads and the
+ * idle task are never part of the runqueue: the worker threads have their
+ * own runqueue in wth.c, while the idle task is just the fall-back choice.
+ *
+ * The real-time tasks (SCHED_FIFO and SCHED_RR) are never part of the tree:
+ * they're kept in one FIFO list per priority level, while a bitmap tracks
+ * the non-empty lists. That makes picking the highest priority real-time task
+ * an O(1) operation. Runnable real-time tasks always preempt the tasks having
+ * a lower priority, including all the SCHED_OTHER ones (priority 0). The same
+ * lists hold the SCHED_OTHER tasks boosted by the priority inheritance (see
+ * kmutex.c), possibly even above the worker threads: that's why they cover
+ * the whole unified priority range, up to SCHED_PRIO_MAX.
+ */
+static struct task *rq_tree_root;
+static struct task *rq_leftmost;
+static u32 rq_seq;
+static struct list timer_ready_tasks_list;
+static struct list rt_queues[SCHED_PRIO_MAX + 1];
+static u32 rt_bitmap[(SCHED_PRIO_MAX + 32) / 32];
 
 const char *const task_state_str[5] = {
    [TASK_STATE_INVALID]  = "invalid",
@@ -378,7 +407,19 @@ static void idle(void)
       ASSERT(is_preemption_enabled());
 
       idle_ticks++;
+
+#if KRN_TICKLESS_IDLE
+      disable_interrupts_forced();
+
+      if (!need_reschedule() && !runnable_tasks_count) {
+         tickless_halt();     /* it re-enables the interrupts */
+      } else {
+         enable_interrupts_forced();
+         halt();
+      }
+#else
       halt();
+#endif
 
       if (need_reschedule() || runnable_tasks_count > 1)
          schedule();
@@ -393,6 +434,95 @@ void yield_until_last(void)
    kernel_yield();
 }
 
+static long rq_cmp(const void *a, const void *b)
+{
+   const struct task *t1 = a;
+   const struct task *t2 = b;
+
+   if (t1->ticks.vruntime != t2->ticks.vruntime)
+      return t1->ticks.vruntime < t2->ticks.vruntime ? -1 : 1;
+
+   /* Same vruntime: the task inserted first, comes first */
+   return (s32)(t1->runqueue_seq - t2->runqueue_seq);
+}
+
+/* Does the task belong to the real-time runqueue? */
+static ALWAYS_INLINE bool rq_is_rt(struct task *ti)
+{
+   return sched_get_prio(ti) > 0;
+}
+
+static void rq_rt_add(struct task *ti)
+{
+   const u32 prio = (u32)sched_get_prio(ti);
+   struct task *curr = get_curr_task();
+
+   list_add_tail(&rt_queues[prio], &ti->runnable_node);
+   rt_bitmap[prio / 32] |= (1u << (prio % 32));
+
+   /* Preempt the current task, if it has a lower priority */
+   if (ti != curr && (int)prio > sched_get_prio(curr))
+      sched_set_need_resched();
+}
+
+static void rq_rt_remove(struct task *ti)
+{
+   const u32 prio = (u32)sched_get_prio(ti);
+
+   list_remove(&ti->runnable_node);
+   list_node_init(&ti->runnable_node);
+
+   if (list_is_empty(&rt_queues[prio]))
+      rt_bitmap[prio / 32] &= ~(1u << (prio % 32));
+}
+
+static void rq_add(struct task *ti)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (rq_is_rt(ti)) {
+      rq_rt_add(ti);
+      return;
+   }
+
+   if (ti->timer_ready) {
+      list_add_tail(&timer_ready_tasks_list, &ti->runnable_node);
+      return;
+   }
+
+   bintree_node_init(&ti->runqueue_node);
+   ti->runqueue_seq = rq_seq++;
+
+   DEBUG_CHECKED_SUCCESS(
+      bintree_insert(&rq_tree_root, ti, rq_cmp, struct task, runqueue_node)
+   );
+
+   if (!rq_leftmost || rq_cmp(ti, rq_leftmost) < 0)
+      rq_leftmost = ti;
+}
+
+static void rq_remove(struct task *ti)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (rq_is_rt(ti)) {
+      rq_rt_remove(ti);
+      return;
+   }
+
+   if (list_is_node_in_list(&ti->runnable_node)) {
+      list_remove(&ti->runnable_node);
+      list_node_init(&ti->runnable_node);
+      return;
+   }
+
+   bintree_remove(&rq_tree_root, ti, rq_cmp, struct task, runqueue_node);
+
+   if (ti == rq_leftmost)
+      rq_leftmost = bintree_get_first_obj(rq_tree_root, struct task,
+                                          runqueue_node);
+}
+
 __attribute__((constructor))
 static void create_kernel_process(void)
 {
@@ -403,7 +533,11 @@ static void create_kernel_process(void)
    struct task *s_kernel_ti = (struct task *)kernel_proc_buf;
    struct process *s_kernel_pi = (struct process *)(s_kernel_ti + 1);
 
-   list_init(&runnable_tasks_list);
+   list_init(&timer_ready_tasks_list);
+
+   for (int i = 0; i < ARRAY_SIZE(rt_queues); i++)
+      list_init(&rt_queues[i]);
+
    s_kernel_pi->pid = create_new_pid();
    s_kernel_ti->tid = create_new_kernel_tid();
    s_kernel_pi->ref_count = 1;
@@ -458,6 +592,14 @@ void init_sched(void)
       panic("Unable to create the idle_task!");
 
    idle_task = get_task(tid);
+
+   /* Drop the idle task from the runqueue: see the "Runqueue" comment */
+   disable_interrupts_forced();
+   {
+      ASSERT(idle_task->state == TASK_STATE_RUNNABLE);
+      rq_remove(idle_task);
+   }
+   enable_interrupts_forced();
 }
 
 void set_current_task_in_kernel(void)
@@ -474,7 +616,10 @@ static void task_add_to_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_add_tail(&runnable_tasks_list, &ti->runnable_node);
+
+         if (ti != idle_task)
+            rq_add(ti);
+
          runnable_tasks_count++;
          break;
 
@@ -503,7 +648,10 @@ static void task_remove_from_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_remove(&ti->runnable_node);
+
+         if (ti != idle_task)
+            rq_remove(ti);
+
          runnable_tasks_count--;
          ASSERT(runnable_tasks_count >= 0);
          break;
@@ -525,6 +673,116 @@ static void task_remove_from_state_list(struct task *ti)
    }
 }
 
+static void sched_lat_add(struct sched_lat *l, u64 ns)
+{
+   const u32 us = (u32)MIN(ns / 1000, (u64)UINT32_MAX);
+
+   l->count++;
+   l->total_ns += ns;
+   l->max_us = MAX(l->max_us, us);
+}
+
+static void sched_hist_add(struct sched_hist *h, u64 ns)
+{
+   const u64 us = ns / 1000;
+   const int b = us ? 64 - __builtin_clzll(us) : 0;
+
+   sched_lat_add(&h->lat, ns);
+   h->buckets[MIN(b, SCHED_HIST_BUCKETS - 1)]++;
+}
+
+/*
+ * Scheduler latency stats
+ * -------------------------
+ *
+ * Every state change is timestamped in `state_change_ns`. That's enough to
+ * measure both the run delay (the time between becoming RUNNABLE and being
+ * RUNNING) and the timeslice length (the time between becoming RUNNING and
+ * changing state again, either because of a preemption or because the task
+ * blocked). The idle task is not accounted in the global stats, as its run
+ * delay and timeslices are meaningless.
+ */
+static void
+task_account_state_change(struct task *ti, enum task_state new_state)
+{
+   const u64 now = get_hr_time_ns();
+   const u64 delta = now - ti->state_change_ns;
+   struct sched_lat *l = NULL;
+   struct sched_hist *h = NULL;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (ti->state_change_ns) {
+
+      if (ti->state == TASK_STATE_RUNNING) {
+
+         l = &ti->stats.timeslice;
+         h = &sched_global_stats.timeslice;
+
+      } else if (ti->state == TASK_STATE_RUNNABLE &&
+                 new_state == TASK_STATE_RUNNING)
+      {
+         l = &ti->stats.run_delay;
+         h = &sched_global_stats.run_delay;
+      }
+   }
+
+   if (l) {
+
+      sched_lat_add(l, delta);
+
+      if (ti != idle_task)
+         sched_hist_add(h, delta);
+   }
+
+   ti->state_change_ns = now;
+}
+
+/*
+ * Called by switch_to_task() when switching away from `curr`, after its state
+ * has been changed by the scheduler: if it's still RUNNABLE, it has been
+ * preempted, otherwise it blocked (or died) voluntarily.
+ */
+void sched_account_switch(struct task *curr)
+{
+   const bool vol = curr->state != TASK_STATE_RUNNABLE;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (vol)
+      curr->stats.vol_switches++;
+   else
+      curr->stats.invol_switches++;
+
+   if (curr == idle_task)
+      return;
+
+   if (vol)
+      sched_global_stats.vol_switches++;
+   else
+      sched_global_stats.invol_switches++;
+}
+
+void sched_get_task_stats(struct task *ti, struct sched_task_stats *out)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      *out = ti->stats;
+   }
+   enable_interrupts(&var);
+}
+
+void sched_get_global_stats(struct sched_stats *out)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      *out = sched_global_stats;
+   }
+   enable_interrupts(&var);
+}
+
 void task_change_state(struct task *ti, enum task_state new_state)
 {
    ulong var;
@@ -533,6 +791,7 @@ void task_change_state(struct task *ti, enum task_state new_state)
 
    disable_interrupts(&var);
    {
+      task_account_state_change(ti, new_state);
       task_remove_from_state_list(ti);
       atomic_store_explicit(&ti->state, new_state, mo_relaxed);
       task_add_to_state_list(ti);
@@ -552,11 +811,34 @@ void task_change_state_idempotent(struct task *ti, enum task_state new_state)
    enable_interrupts(&var);
 }
 
+void task_timer_ready(struct task *ti)
+{
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(ti->timer_ready);
+
+   if (is_worker_thread(ti) || ti == idle_task || rq_is_rt(ti))
+      return;
+
+   if (ti->state != TASK_STATE_RUNNABLE)
+      return;
+
+   if (list_is_node_in_list(&ti->runnable_node))
+      return; /* Already in the timer-ready list */
+
+   /* Move the task from the runqueue tree to the timer-ready list */
+   rq_remove(ti);
+   rq_add(ti);
+}
+
 void add_task(struct task *ti)
 {
+   ulong var;
    disable_preemption();
    {
+      disable_interrupts(&var);
+      ti->state_change_ns = get_hr_time_ns();
       task_add_to_state_list(ti);
+      enable_interrupts(&var);
 
       bintree_insert_ptr(&tree_by_tid_root,
                          ti,
@@ -569,11 +851,14 @@ void add_task(struct task *ti)
 
 void remove_task(struct task *ti)
 {
+   ulong var;
    disable_preemption();
    {
       ASSERT_TASK_STATE(ti->state, TASK_STATE_ZOMBIE);
 
+      disable_interrupts(&var);
       task_remove_from_state_list(ti);
+      enable_interrupts(&var);
 
       bintree_remove_ptr(&tree_by_tid_root,
                          ti,
@@ -586,7 +871,65 @@ void remove_task(struct task *ti)
    enable_preemption();
 }
 
-void sched_account_ticks(void)
+static void
+sched_change_task_prio(struct task *ti, int policy, int rt_prio, int pi_prio)
+{
+   const bool was_rt = rq_is_rt(ti);
+   ulong var;
+   bool in_rq;
+
+   disable_interrupts(&var);
+   {
+      in_rq = ti->state == TASK_STATE_RUNNABLE &&
+              !is_worker_thread(ti) && ti != idle_task;
+
+      if (in_rq)
+         rq_remove(ti);
+
+      ti->sched_policy = (u8)policy;
+      ti->rt_prio = (u8)rt_prio;
+      ti->pi_prio = (u16)pi_prio;
+
+      /*
+       * Tasks leaving the real-time runqueue didn't update their vruntime:
+       * don't let them monopolize the CPU in the fair class.
+       */
+      if (was_rt && !rq_is_rt(ti) && rq_leftmost)
+         ti->ticks.vruntime = MAX(ti->ticks.vruntime,
+                                  rq_leftmost->ticks.vruntime);
+
+      if (in_rq)
+         rq_add(ti);
+
+      /* The current task might not have the highest priority anymore */
+      sched_set_need_resched();
+   }
+   enable_interrupts(&var);
+}
+
+/*
+ * Change the scheduling policy and the real-time priority of a task. The
+ * caller must have validated the parameters.
+ */
+void sched_set_task_policy(struct task *ti, int policy, int rt_prio)
+{
+   ASSERT(!is_worker_thread(ti) && ti != idle_task);
+   ASSERT(policy == SCHED_OTHER || rt_prio > 0);
+
+   sched_change_task_prio(ti, policy, rt_prio, ti->pi_prio);
+}
+
+/*
+ * Set the priority inherited by a task through the kmutexes it owns. The
+ * task's effective priority is the max between its own and `pi_prio`.
+ */
+void sched_set_task_pi_prio(struct task *ti, int pi_prio)
+{
+   ASSERT(IN_RANGE_INC(pi_prio, 0, SCHED_PRIO_MAX));
+   sched_change_task_prio(ti, ti->sched_policy, ti->rt_prio, pi_prio);
+}
+
+void sched_account_ticks(u32 ticks)
 {
    struct task *curr = get_curr_task();
    const enum task_state state = get_curr_task_state();
@@ -597,13 +940,13 @@ void sched_account_ticks(void)
    ASSERT(curr != NULL);
    ASSERT(!is_preemption_enabled());
 
-   t->timeslice++;
-   t->total++;
+   t->timeslice += ticks;
+   t->total += ticks;
 
    if (curr->running_in_kernel)
-      t->total_kernel++;
+      t->total_kernel += ticks;
 
-   if (curr != idle_task) {
+   if (curr != idle_task && is_running && !rq_is_rt(curr)) {
 
       /*
        * The more currently runnable tasks are, the higher vruntime has to
@@ -619,16 +962,29 @@ void sched_account_ticks(void)
        * picking the task with the lowest `total` number of ticks, because
        * tasks that that consumed 100% of the CPU when no other task was
        * runnable won't be so much penalized.
+       *
+       * NOTE: vruntime is the key of the runqueue tree: it cannot change while
+       * the task is RUNNABLE (e.g. it's been woken up while still running),
+       * because in that case the task is already in the tree.
        */
-      t->vruntime += (u64)(runnable_tasks_count - 1);
+      t->vruntime += (u64)ticks * (u64)(runnable_tasks_count - 1);
    }
 
    /*
     * need_resched is never set for worker threads when they used too much
     * CPU time: their timeslice is unlimited and can preempted only be another
-    * worker thread.
+    * worker thread. The same applies to SCHED_FIFO tasks, which run until
+    * they block, yield or get preempted by a higher priority task.
     */
-   const bool timeout = !is_worker && t->timeslice >= TIME_SLICE_TICKS;
+   bool timeout = false;
+
+   if (!is_worker) {
+
+      if (curr->sched_policy == SCHED_RR)
+         timeout = t->timeslice >= RR_TIME_SLICE_TICKS;
+      else if (curr->sched_policy != SCHED_FIFO)
+         timeout = t->timeslice >= TIME_SLICE_TICKS;
+   }
 
    if (curr->stopped || !is_running || timeout)
       sched_set_need_resched();
@@ -667,42 +1023,136 @@ sched_should_return_immediately(struct task *curr, enum task_state curr_state)
 }
 
 static struct task *
-sched_do_select_runnable_task(enum task_state curr_state, bool resched)
+rq_get_first_not_stopped(void)
 {
-   struct task *curr = get_curr_task();
-   struct task *selected = NULL;
+   struct bintree_walk_ctx ctx;
    struct task *pos;
 
-   list_for_each_ro(pos, &runnable_tasks_list, runnable_node) {
+   if (!rq_leftmost || !rq_leftmost->stopped)
+      return rq_leftmost;
+
+   /* Slow path: skip the stopped tasks, in vruntime order */
+   bintree_in_order_visit_start(&ctx,
+                                rq_tree_root,
+                                struct task,
+                                runqueue_node,
+                                false);
+
+   while ((pos = bintree_in_order_visit_next(&ctx))) {
+      if (!pos->stopped)
+         return pos;
+   }
+
+   return NULL;
+}
+
+static struct task *
+rq_get_timer_ready_task(void)
+{
+   struct task *pos, *temp;
+
+   list_for_each(pos, temp, &timer_ready_tasks_list, runnable_node) {
 
       ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
 
-      if (pos->stopped || pos == idle_task)
+      if (!pos->timer_ready) {
+
+         /*
+          * The timer_ready flag has been cleared after the task has been
+          * added to the list: move it back in the runqueue tree.
+          */
+         list_remove(&pos->runnable_node);
+         list_node_init(&pos->runnable_node);
+         rq_add(pos);
          continue;
+      }
 
-      if (pos->timer_ready) {
-         selected = pos;
-         break;
+      if (!pos->stopped)
+         return pos;
+   }
+
+   return NULL;
+}
+
+static struct task *
+rq_get_rt_task(void)
+{
+   struct task *pos;
+
+   for (int w = ARRAY_SIZE(rt_bitmap) - 1; w >= 0; w--) {
+
+      u32 bits = rt_bitmap[w];
+
+      while (bits) {
+
+         const u32 bit = 31 - (u32)__builtin_clz(bits);
+
+         list_for_each_ro(pos, &rt_queues[w * 32 + bit], runnable_node) {
+            if (!pos->stopped)
+               return pos;
+         }
+
+         /* Slow path: all the tasks at this priority level are stopped */
+         bits &= ~(1u << bit);
       }
+   }
+
+   return NULL;
+}
+
+static struct task *
+sched_do_select_runnable_task(enum task_state curr_state, bool resched)
+{
+   struct task *curr = get_curr_task();
+   const bool curr_can_run =
+      curr_state == TASK_STATE_RUNNING && !curr->stopped;
+   struct task *selected;
+   ulong var;
 
-      if (!selected || pos->ticks.vruntime < selected->ticks.vruntime)
-         selected = pos;
+   disable_interrupts(&var);
+   {
+      if (!(selected = rq_get_rt_task()))
+         if (!(selected = rq_get_timer_ready_task()))
+            selected = rq_get_first_not_stopped();
    }
+   enable_interrupts(&var);
 
    /* If there is still no selected task, check for current task */
    if (!selected) {
 
-      if (curr_state == TASK_STATE_RUNNING && !curr->stopped)
+      if (curr_can_run)
          selected = curr;
    }
 
+   if (selected && curr_can_run && selected != curr && !is_worker_thread(curr))
+   {
+      const int curr_prio = sched_get_prio(curr);
+      const int sel_prio = sched_get_prio(selected);
+
+      /*
+       * The current task is not part of the runqueue: it keeps the CPU when
+       * it has a higher priority than the selected one. Real-time tasks with
+       * the same priority switch only when the current one yielded or its RR
+       * time slice expired (resched is set).
+       */
+
+      if (curr_prio > sel_prio)
+         return curr;
+
+      if (curr_prio < sel_prio)
+         return selected;
+
+      if (curr_prio > 0)
+         return resched ? selected : curr;
+   }
+
    if (!resched && selected) {
 
       /*
        * If need_resched is not set, the caller didn't want necessarily to
        * yield, but just give the scheduler an opportunity to switch the current
-       * task. In the loop avoid, the current task was not included because its
-       * state is typically RUNNING, so it's not present in the runnable_list.
+       * task. The current task is not part of the runqueue because its state
+       * is typically RUNNING, therefore we have to check it explicitly.
        */
 
       if (curr_state == TASK_STATE_RUNNING && !curr->stopped)
@@ -713,6 +1163,28 @@ sched_do_select_runnable_task(enum task_state curr_state, bool resched)
    return selected;
 }
 
+/*
+ * Is there any task boosted by the priority inheritance above `prio`, the
+ * priority of a runnable worker thread?
+ */
+static bool
+sched_has_task_above(int prio, struct task *curr, enum task_state curr_state)
+{
+   struct task *rt;
+   ulong var;
+
+   if (curr_state == TASK_STATE_RUNNING && !curr->stopped)
+      if (!is_worker_thread(curr) && sched_get_prio(curr) > prio)
+         return true;
+
+   disable_interrupts(&var);
+   {
+      rt = rq_get_rt_task();
+   }
+   enable_interrupts(&var);
+   return rt && sched_get_prio(rt) > prio;
+}
+
 void do_schedule(void)
 {
    enum task_state curr_state = get_curr_task_state();
@@ -732,6 +1204,12 @@ void do_schedule(void)
    /* Check for worker threads ready to run */
    selected = wth_get_runnable_thread();
 
+   if (selected && sched_has_task_above(sched_get_prio(selected),
+                                        curr, curr_state))
+   {
+      selected = NULL;  /* a task boosted by a higher priority wth must run */
+   }
+
    /* Check for regular runnable tasks */
    if (!selected) {
 
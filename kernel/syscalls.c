@@ -12,6 +12,7 @@
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/signal.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs.h>
 
 #define LINUX_REBOOT_MAGIC1         0xfee1dead
@@ -25,21 +26,15 @@
 #define LINUX_REBOOT_CMD_HALT       0xcdef0123
 #define LINUX_REBOOT_CMD_POWER_OFF  0x4321fedc
 
-int sys_madvise(void *addr, size_t len, int advice)
-{
-   // TODO (future): consider implementing at least part of sys_madvice().
-   return 0;
-}
-
 int
 do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
 {
-   u64 ticks_to_sleep;
-   u64 exp_wake_up_ticks;
+   u64 ns_to_sleep;
+   u64 exp_wake_up_ns;
 
-   ticks_to_sleep = timespec_to_ticks(req);
-   exp_wake_up_ticks = get_ticks() + ticks_to_sleep;
-   kernel_sleep(ticks_to_sleep);
+   ns_to_sleep = (u64)req->tv_sec * BILLION + (u64)req->tv_nsec;
+   exp_wake_up_ns = get_hr_time_ns() + ns_to_sleep;
+   kernel_sleep_ns(ns_to_sleep);
 
    /* After wake-up */
    rem->tv_sec = 0;
@@ -47,10 +42,12 @@ do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
 
    if (pending_signals()) {
 
-      u64 ticks = get_ticks();
+      u64 now = get_hr_time_ns();
 
-      if (ticks < exp_wake_up_ticks)
-         ticks_to_timespec(exp_wake_up_ticks - ticks, rem);
+      if (now < exp_wake_up_ns) {
+         rem->tv_sec = (s64)((exp_wake_up_ns - now) / BILLION);
+         rem->tv_nsec = (long)((exp_wake_up_ns - now) % BILLION);
+      }
 
       return -EINTR;
    }
@@ -242,6 +239,214 @@ int sys_sched_yield(void)
    return 0;
 }
 
+static int sched_get_user_task(int pid, struct task **ti_ref)
+{
+   struct task *ti;
+   ASSERT(!is_preemption_enabled());
+
+   if (pid < 0)
+      return -EINVAL;
+
+   ti = pid ? get_task(pid) : get_curr_task();
+
+   if (!ti || is_kernel_thread(ti))
+      return -ESRCH;
+
+   *ti_ref = ti;
+   return 0;
+}
+
+static int sched_check_param(int policy, int prio)
+{
+   switch (policy) {
+
+      case SCHED_OTHER:
+         return prio == 0 ? 0 : -EINVAL;
+
+      case SCHED_FIFO:
+      case SCHED_RR:
+         if (!IN_RANGE_INC(prio, SCHED_RT_PRIO_MIN, SCHED_RT_PRIO_MAX))
+            return -EINVAL;
+
+         return 0;
+
+      default:
+         return -EINVAL;
+   }
+}
+
+/*
+ * policy == -1 means: keep the current policy.
+ *
+ * Tilck has no credentials to check, so a process is allowed to change only the
+ * policy of its own threads: otherwise, any process could make any other one
+ * SCHED_FIFO with the max priority, starving all the rest of the system.
+ */
+static int do_sched_setscheduler(int pid, int policy, int prio)
+{
+   struct task *ti;
+   int rc;
+
+   disable_preemption();
+   {
+      rc = sched_get_user_task(pid, &ti);
+
+      if (!rc && ti->pi != get_curr_proc())
+         rc = -EPERM;
+
+      if (!rc) {
+
+         if (policy < 0)
+            policy = ti->sched_policy;
+
+         if (!(rc = sched_check_param(policy, prio)))
+            sched_set_task_policy(ti, policy, prio);
+      }
+   }
+   enable_preemption();
+   return rc;
+}
+
+int sys_sched_setscheduler(int pid,
+                           int policy,
+                           const struct k_sched_param *u_param)
+{
+   struct k_sched_param param;
+
+   if (!u_param || policy < 0)
+      return -EINVAL;
+
+   if (copy_from_user(&param, u_param, sizeof(param)))
+      return -EFAULT;
+
+   return do_sched_setscheduler(pid, policy, param.sched_priority);
+}
+
+int sys_sched_setparam(int pid, const struct k_sched_param *u_param)
+{
+   struct k_sched_param param;
+
+   if (!u_param)
+      return -EINVAL;
+
+   if (copy_from_user(&param, u_param, sizeof(param)))
+      return -EFAULT;
+
+   return do_sched_setscheduler(pid, -1, param.sched_priority);
+}
+
+int sys_sched_getscheduler(int pid)
+{
+   struct task *ti;
+   int rc;
+
+   disable_preemption();
+   {
+      if (!(rc = sched_get_user_task(pid, &ti)))
+         rc = ti->sched_policy;
+   }
+   enable_preemption();
+   return rc;
+}
+
+int sys_sched_getparam(int pid, struct k_sched_param *u_param)
+{
+   struct k_sched_param param = {0};
+   struct task *ti;
+   int rc;
+
+   if (!u_param)
+      return -EINVAL;
+
+   disable_preemption();
+   {
+      if (!(rc = sched_get_user_task(pid, &ti)))
+         param.sched_priority = ti->rt_prio;
+   }
+   enable_preemption();
+
+   if (rc)
+      return rc;
+
+   if (copy_to_user(u_param, &param, sizeof(param)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_sched_get_priority_max(int policy)
+{
+   if (policy == SCHED_FIFO || policy == SCHED_RR)
+      return SCHED_RT_PRIO_MAX;
+
+   return policy == SCHED_OTHER ? 0 : -EINVAL;
+}
+
+int sys_sched_get_priority_min(int policy)
+{
+   if (policy == SCHED_FIFO || policy == SCHED_RR)
+      return SCHED_RT_PRIO_MIN;
+
+   return policy == SCHED_OTHER ? 0 : -EINVAL;
+}
+
+static int do_sched_rr_get_interval(int pid, struct k_timespec64 *tp)
+{
+   struct task *ti;
+   u32 ticks = 0;
+   int rc;
+
+   disable_preemption();
+   {
+      if (!(rc = sched_get_user_task(pid, &ti))) {
+
+         if (ti->sched_policy == SCHED_RR)
+            ticks = RR_TIME_SLICE_TICKS;
+         else if (ti->sched_policy == SCHED_OTHER)
+            ticks = TIME_SLICE_TICKS;
+      }
+   }
+   enable_preemption();
+
+   /* SCHED_FIFO tasks have an infinite time slice: Linux reports 0 */
+   ticks_to_timespec(ticks, tp);
+   return rc;
+}
+
+int sys_sched_rr_get_interval_time32(int pid, struct k_timespec32 *u_tp)
+{
+   struct k_timespec64 tp64;
+   struct k_timespec32 tp32;
+   int rc;
+
+   if ((rc = do_sched_rr_get_interval(pid, &tp64)))
+      return rc;
+
+   tp32 = (struct k_timespec32) {
+      .tv_sec = (s32) tp64.tv_sec,
+      .tv_nsec = tp64.tv_nsec,
+   };
+
+   if (copy_to_user(u_tp, &tp32, sizeof(tp32)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_sched_rr_get_interval(int pid, struct k_timespec64 *u_tp)
+{
+   struct k_timespec64 tp;
+   int rc;
+
+   if ((rc = do_sched_rr_get_interval(pid, &tp)))
+      return rc;
+
+   if (copy_to_user(u_tp, &tp, sizeof(tp)))
+      return -EFAULT;
+
+   return 0;
+}
+
 int sys_utimes(const char *u_path, const struct k_timeval u_times[2])
 {
    struct k_timeval ts[2];
@@ -5,6 +5,7 @@
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
 #include <tilck/common/atomics.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/hal.h>
@@ -13,6 +14,7 @@
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/vdso.h>
 
 FASTCALL void asm_nop_loop(u32 iters);
 
@@ -27,16 +29,59 @@ int __tick_adj_ticks_rem;
 
 /* Debug counters */
 u32 slow_timer_irq_handler_count;
+u64 timer_irq_off_cycles_tot;     /* cycles spent in tick_all_timers() */
+u32 timer_irq_off_cycles_max;     /* max cycles spent in a single call */
+u32 timer_irq_off_ticks;          /* number of calls of tick_all_timers() */
 
 /* Temporary global used by asm_do_bogomips_loop() */
 volatile ATOMIC(u32) __bogo_loops;
 
 /* Static variables */
-static struct list timer_wakeup_list = STATIC_LIST_INIT(timer_wakeup_list);
 static u32 loops_per_tick;         /* Tilck bogoMips as loops/tick    */
 static u32 loops_per_ms = 5000000; /* loops/millisecond (initial val)  */
 static u32 loops_per_us = 5000;    /* loops/microsecond (initial val) */
 
+/*
+ * Timer wheel
+ * ---------------------
+ *
+ * Tasks with an active wakeup timer are kept in a hierarchical timer wheel,
+ * instead of a single list iterated on every tick. Each task stores the
+ * absolute tick (`wakeup_timer_expire`) at which its timer will fire, and it
+ * is placed in a bucket depending on how far in the future that tick is:
+ *
+ *    - level 0 has TW_L0_SIZE buckets, one per tick: it contains the timers
+ *      expiring in the next TW_L0_SIZE ticks.
+ *
+ *    - each one of the TW_UPPER_LEVELS upper levels has TW_LN_SIZE buckets,
+ *      each one of them covering a range of ticks TW_LN_SIZE times wider than
+ *      a bucket in the previous level.
+ *
+ * On every tick, ONLY the level-0 bucket for the current tick is iterated and
+ * all the timers in it fire. Every TW_L0_SIZE ticks, one bucket from level 1
+ * is "cascaded" (its timers are re-distributed in the level 0), and so on for
+ * the upper levels. This way, the work done with interrupts disabled on every
+ * tick is proportional to the number of timers about to expire, not to the
+ * total number of active timers. Adding and removing a timer are both O(1).
+ *
+ * The bits of the wheel are chosen to cover exactly the whole range of u32
+ * tick values, which is the maximum supported by task_set_wakeup_timer().
+ */
+
+#define TW_L0_BITS                8
+#define TW_LN_BITS                6
+#define TW_UPPER_LEVELS           4
+#define TW_L0_SIZE                (1u << TW_L0_BITS)
+#define TW_LN_SIZE                (1u << TW_LN_BITS)
+#define TW_L0_MASK                (TW_L0_SIZE - 1)
+#define TW_LN_MASK                (TW_LN_SIZE - 1)
+
+STATIC_ASSERT(TW_L0_BITS + TW_UPPER_LEVELS * TW_LN_BITS == 32);
+
+static struct list tw_l0[TW_L0_SIZE];
+static struct list tw_ln[TW_UPPER_LEVELS][TW_LN_SIZE];
+static u64 tw_next_tick = 1;       /* next tick to be processed by the wheel */
+
 u64 get_ticks(void)
 {
    u64 curr_ticks;
@@ -50,6 +95,184 @@ u64 get_ticks(void)
    return curr_ticks;
 }
 
+static void init_timer_wheel(void)
+{
+   for (u32 i = 0; i < TW_L0_SIZE; i++)
+      list_init(&tw_l0[i]);
+
+   for (u32 l = 0; l < TW_UPPER_LEVELS; l++)
+      for (u32 i = 0; i < TW_LN_SIZE; i++)
+         list_init(&tw_ln[l][i]);
+}
+
+static struct list *tw_get_bucket(u64 expire)
+{
+   u32 delta, shift = TW_L0_BITS;
+   u32 l;
+
+   ASSERT(expire >= tw_next_tick);
+   delta = (u32)(expire - tw_next_tick);
+
+   if (delta < TW_L0_SIZE)
+      return &tw_l0[expire & TW_L0_MASK];
+
+   for (l = 0; l < TW_UPPER_LEVELS - 1; l++, shift += TW_LN_BITS) {
+      if (delta < (1u << (shift + TW_LN_BITS)))
+         break;
+   }
+
+   return &tw_ln[l][(expire >> shift) & TW_LN_MASK];
+}
+
+static void tw_add_timer(struct task *ti, u32 ticks)
+{
+   const u64 expire = tw_next_tick + ticks - 1;
+
+   ASSERT(!are_interrupts_enabled());
+
+   /*
+    * Never let `expire` be in the past (e.g. with ticks == 0 in a release
+    * build): the timer would go in the bucket of the next processed tick, but
+    * tw_run_tick() expects the timers there to expire exactly at that tick.
+    */
+   ti->wakeup_timer_expire = MAX(expire, tw_next_tick);
+   list_add_tail(tw_get_bucket(ti->wakeup_timer_expire),
+                 &ti->wakeup_timer_node);
+}
+
+/*
+ * Clocksources
+ * -------------------------
+ *
+ * The system time (`__time_ns`) advances only on ticks. In order to have a
+ * better resolution, a clocksource provides the time elapsed since the last
+ * accounted tick, which is added to `__time_ns` by get_hr_time_ns(). The
+ * clocksource with the best resolution among the registered ones is used.
+ * The default one, "jiffies", has the resolution of the tick.
+ */
+
+static u32 jiffies_tick_elapsed_ns(void)
+{
+   return 0;
+}
+
+static struct clocksource jiffies_clocksource = {
+   .name = "jiffies",
+   .res_ns = BILLION / TIMER_HZ,
+   .tick_elapsed_ns = &jiffies_tick_elapsed_ns,
+   .on_tick = NULL,
+   .vdso_update = NULL,
+};
+
+static struct clocksource *curr_clocksource = &jiffies_clocksource;
+static u64 hr_last_time_ns;
+
+void register_clocksource(struct clocksource *cs)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      if (cs->res_ns < curr_clocksource->res_ns) {
+
+         if (cs->on_tick)
+            cs->on_tick();
+
+         curr_clocksource = cs;
+         vdso_update_time();
+      }
+   }
+   enable_interrupts(&var);
+}
+
+const struct clocksource *get_curr_clocksource(void)
+{
+   return curr_clocksource;
+}
+
+/*
+ * Monotonic time in nanoseconds since the timer started, like `__time_ns`,
+ * but with the resolution of the current clocksource instead of the tick's.
+ */
+u64 get_hr_time_ns(void)
+{
+   u64 t;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      t = __time_ns + curr_clocksource->tick_elapsed_ns();
+      t = MAX(t, hr_last_time_ns);
+      hr_last_time_ns = t;
+   }
+   enable_interrupts(&var);
+   return t;
+}
+
+/*
+ * High-resolution timers
+ * -------------------------
+ *
+ * When KRN_HIGH_RES_TIMERS is enabled and the HW supports it, the wakeup
+ * timers set with task_set_wakeup_timer_ns() are NOT rounded up to ticks.
+ * Instead, they're kept in a list sorted by deadline (absolute time in ns,
+ * see get_hr_time_ns()) and a HW one-shot timer is programmed to fire at the
+ * first deadline. The list is checked on every tick as well: that allows the
+ * HW one-shot timer (e.g. the PIT fallback) to support only deadlines before
+ * the next tick.
+ *
+ * A task can have either a regular (wheel) wakeup timer or a hr one, never
+ * both: that's why the same list node is used for both.
+ */
+
+static bool hr_timers_enabled;
+static struct list hr_timers_list = STATIC_LIST_INIT(hr_timers_list);
+
+static void hr_add_timer(struct task *ti, u64 expire)
+{
+   struct task *pos;
+   ASSERT(!are_interrupts_enabled());
+
+   ti->wakeup_hr_expire = expire;
+
+   /* Keep the list sorted. Typically, new timers go at the end */
+   pos = list_last_obj(&hr_timers_list, struct task, wakeup_timer_node);
+
+   while (&pos->wakeup_timer_node != (struct list_node *)&hr_timers_list &&
+          pos->wakeup_hr_expire > expire)
+   {
+      pos = list_prev_obj(pos, wakeup_timer_node);
+   }
+
+   list_add_after(&pos->wakeup_timer_node, &ti->wakeup_timer_node);
+}
+
+static void hr_program_next(u64 now)
+{
+   struct task *first;
+   u64 delta;
+
+   if (list_is_empty(&hr_timers_list))
+      return;
+
+   first = list_first_obj(&hr_timers_list, struct task, wakeup_timer_node);
+   delta = first->wakeup_hr_expire > now ? first->wakeup_hr_expire - now : 1;
+   hw_hrtimer_arm((u32)MIN(delta, (u64)UINT32_MAX));
+}
+
+static void task_remove_wakeup_timer(struct task *ti)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (ti->wakeup_timer_expire || ti->wakeup_hr_expire) {
+      ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
+      list_remove(&ti->wakeup_timer_node);
+      ti->wakeup_timer_expire = 0;
+      ti->wakeup_hr_expire = 0;
+   } else {
+      ASSERT(!list_is_node_in_list(&ti->wakeup_timer_node));
+   }
+}
+
 void task_set_wakeup_timer(struct task *ti, u32 ticks)
 {
    ulong var;
@@ -57,14 +280,37 @@ void task_set_wakeup_timer(struct task *ti, u32 ticks)
 
    disable_interrupts(&var);
    {
-      if (ti->ticks_before_wake_up == 0) {
-         ASSERT(!list_is_node_in_list(&ti->wakeup_timer_node));
-         list_add_tail(&timer_wakeup_list, &ti->wakeup_timer_node);
-      } else {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-      }
+      task_remove_wakeup_timer(ti);
+      tw_add_timer(ti, ticks);
+   }
+   enable_interrupts(&var);
+}
+
+/*
+ * Like task_set_wakeup_timer(), but with a timeout in nanoseconds. When the
+ * high-resolution timers are not available, the timeout is rounded up to
+ * ticks (up to 2^32 - 1).
+ */
+void task_set_wakeup_timer_ns(struct task *ti, u64 ns)
+{
+   u64 now, ticks;
+   ulong var;
+   ASSERT(ns > 0);
 
-      ti->ticks_before_wake_up = ticks;
+   if (!hr_timers_enabled) {
+      ticks = div_round_up64(ns, __tick_duration);
+      task_set_wakeup_timer(ti, (u32)CLAMP(ticks, 1u, UINT32_MAX));
+      return;
+   }
+
+   disable_interrupts(&var);
+   {
+      task_remove_wakeup_timer(ti);
+      now = get_hr_time_ns();
+      hr_add_timer(ti, now + ns);
+
+      if (list_first_obj(&hr_timers_list, struct task, wakeup_timer_node) == ti)
+         hr_program_next(now);
    }
    enable_interrupts(&var);
 }
@@ -76,98 +322,186 @@ void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
 
    disable_interrupts(&var);
    {
-      if (ti->ticks_before_wake_up > 0) {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-         ti->ticks_before_wake_up = new_ticks;
+      if (ti->wakeup_timer_expire || ti->wakeup_hr_expire) {
+         task_remove_wakeup_timer(ti);
+         tw_add_timer(ti, new_ticks);
       }
    }
    enable_interrupts(&var);
 }
 
-u32 task_cancel_wakeup_timer(struct task *ti)
+/*
+ * Cancel the wakeup timer of the given task, if any, and return the time that
+ * was remaining before it would fire, in nanoseconds.
+ */
+u64 task_cancel_wakeup_timer_ns(struct task *ti)
 {
    ulong var;
-   u32 old;
+   u64 rem = 0;
+
    disable_interrupts(&var);
    {
-      old = ti->ticks_before_wake_up;
+      if (ti->wakeup_timer_expire) {
+
+         rem = ti->wakeup_timer_expire - tw_next_tick + 1;
+         rem *= __tick_duration;
 
-      if (old > 0) {
+      } else if (ti->wakeup_hr_expire) {
+
+         rem = ti->wakeup_hr_expire;
+         rem -= MIN(get_hr_time_ns(), ti->wakeup_hr_expire);
+      }
+
+      if (ti->wakeup_timer_expire || ti->wakeup_hr_expire) {
          ti->timer_ready = false;
-         ti->ticks_before_wake_up = 0;
-         list_remove(&ti->wakeup_timer_node);
+         task_remove_wakeup_timer(ti);
       }
    }
    enable_interrupts(&var);
-   return old;
+   return rem;
 }
 
-static void tick_all_timers(void)
+u32 task_cancel_wakeup_timer(struct task *ti)
 {
+   const u64 rem = task_cancel_wakeup_timer_ns(ti);
+   return (u32)MIN(div_round_up64(rem, __tick_duration), (u64)UINT32_MAX);
+}
+
+/*
+ * Fire the wakeup timer of the given task, already removed from the wheel or
+ * from the hr timers list. Returns true if the task has been woken up.
+ */
+static bool task_fire_wakeup_timer(struct task *ti)
+{
+   ti->timer_ready = true;
+   ti->wakeup_timer_expire = 0;
+   ti->wakeup_hr_expire = 0;
+   list_remove(&ti->wakeup_timer_node);
+
+   if (ti->state == TASK_STATE_SLEEPING) {
+      task_change_state(ti, TASK_STATE_RUNNABLE);
+      return true;
+   }
+
+   if (ti->state == TASK_STATE_RUNNABLE)
+      task_timer_ready(ti);
+
+   return false;
+}
+
+/*
+ * Move all the timers in the given bucket of the level `l` in the lower
+ * levels. Returns the index of the bucket, which is used by the caller to
+ * determine if the cascade has to continue in the next level.
+ */
+static u32 tw_cascade(u32 l)
+{
+   const u32 idx =
+      (u32)(tw_next_tick >> (TW_L0_BITS + l * TW_LN_BITS)) & TW_LN_MASK;
+
+   struct list *bucket = &tw_ln[l][idx];
    struct task *pos, *temp;
+
+   list_for_each(pos, temp, bucket, wakeup_timer_node) {
+
+      struct list *new_bucket = tw_get_bucket(pos->wakeup_timer_expire);
+
+      /* The timers in a cascaded bucket always move to a lower level */
+      ASSERT(new_bucket != bucket);
+      list_add_tail(new_bucket, &pos->wakeup_timer_node);
+   }
+
+   list_init(bucket);
+   return idx;
+}
+
+static bool tw_run_tick(void)
+{
+   const u32 idx = tw_next_tick & TW_L0_MASK;
+   struct list *bucket = &tw_l0[idx];
    bool any_woken_up_task = false;
+   struct task *pos, *temp;
+
+   if (!idx) {
+      for (u32 l = 0; l < TW_UPPER_LEVELS; l++)
+         if (tw_cascade(l))
+            break;
+   }
+
+   list_for_each(pos, temp, bucket, wakeup_timer_node) {
+
+      /* Timers in the current level-0 bucket must expire exactly now */
+      ASSERT(pos->wakeup_timer_expire == tw_next_tick);
+      any_woken_up_task |= task_fire_wakeup_timer(pos);
+   }
+
+   tw_next_tick++;
+   return any_woken_up_task;
+}
+
+static bool hr_run_timers(void)
+{
+   bool any_woken_up_task = false;
+   struct task *pos, *temp;
+   u64 now;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (list_is_empty(&hr_timers_list))
+      return false;
+
+   now = get_hr_time_ns();
+
+   list_for_each(pos, temp, &hr_timers_list, wakeup_timer_node) {
+
+      if (pos->wakeup_hr_expire > now)
+         break;
+
+      any_woken_up_task |= task_fire_wakeup_timer(pos);
+   }
+
+   hr_program_next(now);
+   return any_woken_up_task;
+}
+
+/*
+ * Called by the arch code when the HW hr one-shot timer fires. It might be
+ * called either with interrupts enabled or disabled.
+ */
+void hrtimer_irq_handler(void)
+{
+   bool any_woken_up_task;
    ulong var;
 
-   /*
-    * This is *NOT* the best we can do. In particular, it's terrible to keep
-    * the interrupts disabled while iterating the _whole_ timer_wakeup_list.
-    *
-    * Possible better solutions
-    * -----------------------------
-    * 1. Keep the tasks to wake-up in a sort of ordered list and then use
-    * relative timers. This way, at each tick we'll have to decrement just one
-    * single counter. We'll start decrement the next counter only when the first
-    * counter reaches 0 and its list node is removed. Of course, if we cannot
-    * use kmalloc() in case of sleep, it gets much harder to create such an
-    * ordered list and make it live inside a member of struct task. Maybe a BST
-    * will do the job, but that would require paying O(logN) per tick for
-    * finding the earliest timer. Not sure how better would be now for N < 50
-    * (typical), given the huge added constant for the BST functions. Also, the
-    * cancellation of a timer would require some extra effort in order to
-    * re-calculate the relative timer values, while we want the cancellation to
-    * be light-fast because it's run by IRQ handlers.
-    *
-    * 2. Use a fixed number of wakeup lists like: short-term, mid-term and
-    * long-term. Current task's wakeup list node will be placed in one those
-    * lists, depending on far in the future the task is supposted to be woke up.
-    * On every tick, here in tick_all_timers(), ONLY the short-term list will be
-    * iterated. That's a considerable improvement. In a system, there might be
-    * even 1,000 active timers, but how many of them will expire in the next
-    * second? Only a small percentage of them. To further improve the
-    * scalability, it's possible to have even more than 3 lists, or to further
-    * reduce the time-horizon of the short-term list. Periodically, but NOT on
-    * every tick, the `ticks_before_wake_up` field belonging to tasks in the
-    * other wakeup lists will adjusted with bigger decrements and tasks will be
-    * moved from one list to another. That will also happen in case the wakeup
-    * timer is changed for task with an already active timer. This solution
-    * looks much better than solution 1.
-    *
-    * Conclusion
-    * ---------------------
-    * For the moment, given the very limited scale of Tilck (tens of tasks at
-    * most running on the whole system), the current solution is safe and
-    * good-enough but, at some point, a smarter ad-hoc solution should be
-    * devised. Probably solution 2 is the right candidate.
-    */
    disable_interrupts(&var);
+   {
+      any_woken_up_task = hr_run_timers();
+   }
+   enable_interrupts(&var);
 
-   list_for_each(pos, temp, &timer_wakeup_list, wakeup_timer_node) {
+   if (any_woken_up_task)
+      sched_set_need_resched();
+}
 
-      /* If task is part of this list, it's counter must be > 0 */
-      ASSERT(pos->ticks_before_wake_up > 0);
+static void tick_all_timers(void)
+{
+   bool any_woken_up_task = false;
+   u64 start;
+   u32 cycles;
+   ulong var;
 
-      if (UNLIKELY(--pos->ticks_before_wake_up == 0)) {
+   disable_interrupts(&var);
+   start = RDTSC();
 
-         pos->timer_ready = true;
-         list_remove(&pos->wakeup_timer_node);
+   while (tw_next_tick <= __ticks)
+      any_woken_up_task |= tw_run_tick();
 
-         if (pos->state == TASK_STATE_SLEEPING) {
-            task_change_state(pos, TASK_STATE_RUNNABLE);
-            any_woken_up_task = true;
-         }
-      }
-   }
+   any_woken_up_task |= hr_run_timers();
 
+   cycles = (u32)(RDTSC() - start);
+   timer_irq_off_cycles_tot += cycles;
+   timer_irq_off_cycles_max = MAX(timer_irq_off_cycles_max, cycles);
+   timer_irq_off_ticks++;
    enable_interrupts(&var);
 
    if (any_woken_up_task)
@@ -213,14 +547,15 @@ void kernel_sleep(u64 ticks)
     *    }
     *    kernel_yield();
     *
-    * But that would require task->ticks_before_wake_up to be actually 64-bit,
-    * wide and that's bad on 32-bit systems because:
+    * But that would require the timer wheel to support delays wider than
+    * 32 bits, and that's bad on 32-bit systems because:
     *
-    *    - it would require using the soft 64-bit integers (slow)
-    *    - it would make impossible, in the case we wanted that, the counter
-    *      to be atomic.
+    *    - it would require using the soft 64-bit integers (slow) for computing
+    *      the bucket of each timer
+    *    - it would require more levels in the wheel, making the cascade of
+    *      the timers more expensive.
     *
-    * Therefore, in order to use a 32-bit value for 'ticks_before_wake_up' and,
+    * Therefore, in order to use a 32-bit delay for the wakeup timers and,
     * at the same time being able to sleep for more than 2^32-1 ticks, we need
     * a more tricky implementation (below), and the little extra runtime price
     * for it is totally fine, since we're going to sleep anyways!
@@ -229,7 +564,7 @@ void kernel_sleep(u64 ticks)
     * ----------------------
     *
     * The simpler way to explain the algorithm is to just assume everything
-    * is in base 10 and that ticks_before_wake_up has 2 digits, while we want
+    * is in base 10 and that the timer delay has 2 digits, while we want
     * to support 4 digits sleep time. For example, we want to sleep for 234
     * ticks. The algorithm first computes 534 % 100 = 34 and then 534 / 100 = 5.
     * After that, it sleeps q (= 5) times for 99 ticks (max allowed). Clearly,
@@ -274,6 +609,25 @@ void kernel_sleep_ms(u64 ms)
    kernel_sleep(MAX(1u, ms_to_ticks(ms)));
 }
 
+void kernel_sleep_ns(u64 ns)
+{
+   if (!hr_timers_enabled || !ns) {
+      kernel_sleep(div_round_up64(ns, __tick_duration));
+      return;
+   }
+
+   if (in_panic())
+      return;      /* See the comment in kernel_sleep() */
+
+   DEBUG_ONLY(check_not_in_irq_handler());
+   ASSERT(are_interrupts_enabled());
+
+   disable_preemption();
+   task_change_state(get_curr_task(), TASK_STATE_SLEEPING);
+   task_set_wakeup_timer_ns(get_curr_task(), ns);
+   kernel_yield_preempt_disabled();
+}
+
 static ALWAYS_INLINE bool timer_nested_irq(void)
 {
    bool res = false;
@@ -294,47 +648,158 @@ static ALWAYS_INLINE bool timer_nested_irq(void)
    return res;
 }
 
+/*
+ * Advance the system time by `n` ticks.
+ *
+ * Alter __ticks and __time_ns here, while keeping the interrupts disabled
+ * because other IRQ handlers might need to use them. `__tick_duration` is
+ * immutable, while `__tick_adj_val` and `__tick_adj_ticks_rem` are changed by
+ * datetime.c while keeping interrupts disabled as well. In case of multiple
+ * ticks (tickless idle), the drift compensation is applied to each one of
+ * them, as if they were regular ticks.
+ */
+static void timer_advance(u32 n)
+{
+   u32 adj_ticks;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      adj_ticks = MIN(n, (u32)__tick_adj_ticks_rem);
+
+      __ticks += n;
+      __time_ns += (u64)n * __tick_duration;
+      __time_ns += (s64)adj_ticks * __tick_adj_val;
+      __tick_adj_ticks_rem -= (int)adj_ticks;
+
+      if (curr_clocksource->on_tick)
+         curr_clocksource->on_tick();
+
+      vdso_update_time();
+   }
+   enable_interrupts(&var);
+}
+
+#if KRN_TICKLESS_IDLE
+
+/*
+ * Tickless idle
+ * ---------------------
+ *
+ * When the idle task has nothing to do, instead of being woken up on every
+ * tick, it stops the periodic timer and programs a one-shot timer for the
+ * next expiring timer in the wheel (or the max the HW timer supports). The
+ * ticks elapsed while halted are accounted all together on the first IRQ
+ * received (see timer_irq_enter()), before running any IRQ handler.
+ *
+ * `tickless_ticks` is the number of ticks covered by the currently armed
+ * one-shot timer: 0 means that the periodic tick is running.
+ */
+static u32 tickless_ticks;
+
+/*
+ * Returns the number of ticks until the next event the timer wheel has to
+ * process, capped to `max`. Timers in the upper levels don't need to be
+ * checked, because they can expire only after being cascaded: therefore,
+ * the next cascade is an event as well.
+ */
+static u32 tw_get_next_event_ticks(u32 max)
+{
+   const u32 limit = (TW_L0_SIZE - (tw_next_tick & TW_L0_MASK)) & TW_L0_MASK;
+
+   ASSERT(tw_next_tick == __ticks + 1);
+
+   if (!limit)
+      return 1;         /* we have to cascade on the next tick */
+
+   for (u32 i = 0; i < MIN(limit, max); i++) {
+      if (!list_is_empty(&tw_l0[(tw_next_tick + i) & TW_L0_MASK]))
+         return i + 1;
+   }
+
+   return MIN(limit + 1, max);
+}
+
+/*
+ * Halt the CPU without the periodic tick, until the next timer event or any
+ * other IRQ. Must be called with interrupts disabled: returns with interrupts
+ * enabled.
+ */
+void tickless_halt(void)
+{
+   u32 next;
+
+   ASSERT(!are_interrupts_enabled());
+
+   /* The PIT fallback for hr timers supports only deadlines before a tick */
+   if (!tickless_ticks && list_is_empty(&hr_timers_list)) {
+
+      next = tw_get_next_event_ticks(TW_L0_SIZE);
+
+      if (next > 1)
+         tickless_ticks = hw_timer_oneshot(next);
+   }
+
+   enable_interrupts_and_halt();
+}
+
+static void timer_catch_up(u32 n)
+{
+   if (!n)
+      return;
+
+   timer_advance(n);
+   sched_account_ticks(n);
+   tick_all_timers();
+}
+
+/*
+ * Called on every IRQ before the actual IRQ handlers, with interrupts
+ * disabled. If the periodic tick was stopped, account the ticks elapsed
+ * while halted. The last tick of an expired one-shot timer is accounted
+ * by timer_irq_handler(), because IRQ 0 is pending (or just being handled).
+ */
+void timer_irq_enter(void)
+{
+   bool expired;
+   u32 crossed;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (LIKELY(!tickless_ticks))
+      return;
+
+   crossed = hw_timer_oneshot_stop(&expired);
+
+   if (expired) {
+      ASSERT(crossed == tickless_ticks);
+      tickless_ticks = 0;
+      timer_catch_up(crossed - 1);
+   } else {
+      tickless_ticks = 1;        /* re-armed for the next tick boundary */
+      timer_catch_up(crossed);
+   }
+}
+
+#endif
+
 static enum irq_action timer_irq_handler(void *ctx)
 {
-   u32 ns_delta;
    ASSERT(are_interrupts_enabled());
 
    if (KRN_TRACK_NESTED_INTERR)
       if (timer_nested_irq())
          return IRQ_HANDLED;
 
-   /*
-    * Compute `ns_delta` by reading `__tick_duration` and `__tick_adj_val` here
-    * without disabling interrupts, because it's safe to do so. Also, decrement
-    * `__tick_adj_ticks_rem` too. Why it's safe:
-    *
-    *    1. `__tick_duration` is immutable
-    *    2. `__tick_adj_val` is changed only by datetime.c while keeping
-    *       interrupts disabled and it's read only here. Nested timer IRQs
-    *       will be ignored (see above). No other IRQ handler should read it.
-    */
+   if (hr_timers_enabled && hw_timer_hr_irq()) {
 
-   if (__tick_adj_ticks_rem) {
-      ns_delta = (u32)((s32)__tick_duration + __tick_adj_val);
-      __tick_adj_ticks_rem--;
-   } else {
-      ns_delta = __tick_duration;
+      /* Not a tick: the HW timer fired earlier for a hr timer */
+      hrtimer_irq_handler();
+      return IRQ_HANDLED;
    }
 
-   disable_interrupts_forced();
-   {
-      /*
-       * Alter __ticks and __time_ns here, while keeping the interrupts disabled
-       * because other IRQ handlers might need to use them. While, as explained
-       * above, `__tick_adj_val` and `__tick_adj_ticks_rem` will never need to
-       * be read or written by IRQ handlers.
-       */
-      __ticks++;
-      __time_ns += ns_delta;
-   }
-   enable_interrupts_forced();
-
-   sched_account_ticks();
+   timer_advance(1);
+   sched_account_ticks(1);
    tick_all_timers();
    return IRQ_HANDLED;
 }
@@ -348,6 +813,7 @@ struct bogo_measure_ctx {
    bool started;
    bool pass_start;
    u32 ticks;
+   u64 start_cycles;
 };
 
 static enum irq_action measure_bogomips_irq_handler(void *arg)
@@ -369,6 +835,7 @@ static enum irq_action measure_bogomips_irq_handler(void *arg)
        * from now, when the timer IRQ just arrived.
        */
       __bogo_loops = 0;
+      ctx->start_cycles = RDTSC();
       ctx->pass_start = true;
       return IRQ_NOT_HANDLED;
    }
@@ -385,6 +852,11 @@ static enum irq_action measure_bogomips_irq_handler(void *arg)
          loops_per_ms = loops_per_tick / (1000 / TIMER_HZ);
          loops_per_us = loops_per_ms / 1000;
          __bogo_loops = -1;
+
+         /* Use the same measurement for calibrating the TSC as well */
+         hw_tsc_clocksource_init(
+            (RDTSC() - ctx->start_cycles) / MEASURE_BOGOMIPS_TICKS
+         );
       }
       enable_interrupts_forced();
    }
@@ -405,6 +877,7 @@ static void do_bogomips_loop(void *arg)
    }
    enable_preemption();
    printk("Tilck bogoMips: %u.%03u\n", loops_per_us, loops_per_ms % 1000);
+   printk("Clocksource: %s\n", get_curr_clocksource()->name);
 }
 
 void delay_us(u32 us)
@@ -426,8 +899,12 @@ void init_timer(void)
    static struct bogo_measure_ctx ctx;
    measure_bogomips.context = &ctx;
 
+   init_timer_wheel();
    __tick_duration = hw_timer_setup(TS_SCALE / TIMER_HZ);
 
+   if (KRN_HIGH_RES_TIMERS)
+      hr_timers_enabled = hw_hrtimer_setup();
+
    printk("*** Init the kernel timer\n");
 
    if (!wth_enqueue_anywhere(WTH_PRIO_HIGHEST, &do_bogomips_loop, &ctx))
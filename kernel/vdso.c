@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/vdso.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/hal.h>
+
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, seq) == VDSO_DATA_SEQ_OFF);
+STATIC_ASSERT(
+   OFFSET_OF(struct vdso_data, clock_mode) == VDSO_DATA_CLOCK_MODE_OFF
+);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, sec) == VDSO_DATA_SEC_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, nsec) == VDSO_DATA_NSEC_OFF);
+STATIC_ASSERT(
+   OFFSET_OF(struct vdso_data, tsc_max_delta) == VDSO_DATA_TSC_MAX_DELTA_OFF
+);
+STATIC_ASSERT(
+   OFFSET_OF(struct vdso_data, tsc_last_tick) == VDSO_DATA_TSC_LAST_OFF
+);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, tsc_mult) == VDSO_DATA_TSC_MULT_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, max_ns) == VDSO_DATA_MAX_NS_OFF);
+
+extern u32 __tick_duration;
+extern int __tick_adj_val;
+extern int __tick_adj_ticks_rem;
+
+/*
+ * A whole page, because it's mapped in usermode: nothing else can be there.
+ */
+char vdso_data_page[PAGE_SIZE] ALIGNED_AT(PAGE_SIZE);
+
+/*
+ * Publish the current time in the vDSO data page. Called on every tick and
+ * every time the clocksource changes.
+ *
+ * NOTE: interrupts must be disabled.
+ */
+void vdso_update_time(void)
+{
+   volatile struct vdso_data *vd = (void *)vdso_data_page;
+   const struct clocksource *cs = get_curr_clocksource();
+   struct k_timespec64 tp;
+
+   ASSERT(!are_interrupts_enabled());
+   real_time_get_coarse_timespec(&tp);
+
+   vd->seq++;
+   {
+      vd->sec = (u64)tp.tv_sec;
+      vd->nsec = (u32)tp.tv_nsec;
+      vd->max_ns = __tick_duration;
+
+      if (__tick_adj_ticks_rem > 0)
+         vd->max_ns = (u32)((int)vd->max_ns + __tick_adj_val);
+
+      vd->clock_mode = VDSO_CLOCK_NONE;
+
+      if (cs->vdso_update)
+         cs->vdso_update((struct vdso_data *)vd);
+   }
+   vd->seq++;
+}
@@ -195,9 +195,13 @@ struct task *wth_get_runnable_thread(void)
 
       struct worker_thread *t = worker_threads[i];
 
+      /* NOTE: the priority of a worker thread might be boosted (kmutex.c) */
       if (t->task->state == TASK_STATE_RUNNABLE)
-         if (!selected || t->priority < selected->priority)
+         if (!selected ||
+             sched_get_prio(t->task) > sched_get_prio(selected->task))
+         {
             selected = t;
+         }
    }
 
    return selected ? selected->task : NULL;
@@ -1,10 +1,13 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <tilck_gen_headers/config_kmalloc.h>
+
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
 
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/kmalloc_debug.h>
+#include <tilck/kernel/page_alloc.h>
 
 #include "termutil.h"
 #include "dp_int.h"
@@ -42,6 +45,47 @@ static void dp_heaps_on_enter(void)
    debug_kmalloc_get_stats(&stats);
 }
 
+static void dp_show_kmem_caches(int row)
+{
+   struct debug_kmem_cache_info ci;
+
+   dp_writeln(
+      " %-20s "
+      TERM_VLINE " size "
+      TERM_VLINE " in use "
+      TERM_VLINE "  free  "
+      TERM_VLINE "  allocs  "
+      TERM_VLINE " refills ",
+      "object cache"
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqqqqqqqqqqqqqqqqqnqqqqqqnqqqqqqqqnqqqqqqqqnqqqqqqqqqqnqqqqqqqqq"
+      GFX_OFF
+   );
+
+   for (int i = 0; debug_kmem_cache_get_info(i, &ci); i++) {
+
+      dp_writeln(
+         " %-20s "
+         TERM_VLINE " %4u "
+         TERM_VLINE " %6u "
+         TERM_VLINE " %6u "
+         TERM_VLINE " %8u "
+         TERM_VLINE " %7u ",
+         ci.name,
+         (u32)ci.obj_size,
+         ci.in_use,
+         ci.free_count,
+         ci.allocs,
+         ci.refills
+      );
+   }
+
+   dp_writeln("");
+}
+
 static void dp_show_kmalloc_heaps(void)
 {
    int row = dp_screen_start_row;
@@ -55,6 +99,28 @@ static void dp_show_kmalloc_heaps(void)
                stats.small_heaps.not_full_count,
                stats.small_heaps.peak_not_full_count);
 
+   if (KMALLOC_MAGAZINES) {
+
+      const u32 mag_allocs = stats.mags.alloc_hits + stats.mags.alloc_misses;
+
+      dp_writeln2("mag hits: %3u%% [drains: %u]",
+                  mag_allocs ? stats.mags.alloc_hits * 100 / mag_allocs : 0,
+                  stats.mags.drains);
+   }
+
+   for (int i = 0; i < PAGE_ZONES_COUNT; i++) {
+
+      struct page_zone_info zi;
+
+      if (!debug_page_alloc_get_zone_info(i, &zi))
+         break;
+
+      dp_writeln2("%-8s  %6u KB free [tot: %6u KB]",
+                  zi.name,
+                  zi.free_pages * (PAGE_SIZE / KB),
+                  zi.tot_pages * (PAGE_SIZE / KB));
+   }
+
    row = dp_screen_start_row;
 
    dp_writeln("Usable:  %6u KB", tot_usable_mem_kb);
@@ -121,6 +187,7 @@ static void dp_show_kmalloc_heaps(void)
    }
 
    dp_writeln("");
+   dp_show_kmem_caches(row);
 }
 
 static void dp_heaps_on_exit(void)
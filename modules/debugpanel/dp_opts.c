@@ -94,17 +94,22 @@ static void dp_show_opts(void)
    DUMP_BOOL_OPT(KERNEL_UBSAN);
    DUMP_BOOL_OPT(TERM_BIG_SCROLL_BUF);
    DUMP_BOOL_OPT(KRN_RESCHED_ENABLE_PREEMPT);
+   DUMP_BOOL_OPT(KRN_TICKLESS_IDLE);
+   DUMP_BOOL_OPT(KRN_HIGH_RES_TIMERS);
    DUMP_BOOL_OPT(KERNEL_BIG_IO_BUF);
    DUMP_BOOL_OPT(PS2_DO_SELFTEST);
    DUMP_BOOL_OPT(PS2_VERBOSE_DEBUG_LOG);
    DUMP_BOOL_OPT(KERNEL_GCOV);
    DUMP_BOOL_OPT(FORK_NO_COW);
    DUMP_BOOL_OPT(MMAP_NO_COW);
+   DUMP_BOOL_OPT(BRK_NO_COW);
+   DUMP_BOOL_OPT(MMAP_NO_HUGE_PAGES);
    DUMP_BOOL_OPT(PANIC_SHOW_REGS);
    DUMP_BOOL_OPT(KMALLOC_HEAVY_STATS);
    DUMP_BOOL_OPT(KMALLOC_FREE_MEM_POISONING);
    DUMP_BOOL_OPT(KMALLOC_SUPPORT_DEBUG_LOG);
    DUMP_BOOL_OPT(KMALLOC_SUPPORT_LEAK_DETECTOR);
+   DUMP_BOOL_OPT(KMALLOC_MAGAZINES);
    DUMP_BOOL_OPT(BOOTLOADER_POISON_MEMORY);
    DUMP_BOOL_OPT(FB_CONSOLE_FAILSAFE_OPT);
 
@@ -573,12 +573,51 @@ void dp_dump_task_list(bool kernel_tasks, bool plain_text)
       dp_writeln("");
 }
 
+static void dp_show_sched_lat(const char *name, struct sched_lat *l)
+{
+   dp_writeln("%-10s count: %7u " TERM_VLINE
+              " avg: %7llu us " TERM_VLINE " max: %7u us",
+              name,
+              l->count,
+              l->count ? l->total_ns / l->count / 1000 : 0,
+              l->max_us);
+}
+
+static void dp_show_sel_task_sched_stats(void)
+{
+   struct sched_task_stats s;
+   struct task *ti;
+
+   disable_preemption();
+   {
+      ti = get_task(sel_tid);
+
+      if (ti)
+         sched_get_task_stats(ti, &s);
+   }
+   enable_preemption();
+
+   if (!ti)
+      return;
+
+   dp_writeln("Scheduler stats of tid %d:", sel_tid);
+   dp_writeln("");
+   dp_show_sched_lat("run delay", &s.run_delay);
+   dp_show_sched_lat("timeslice", &s.timeslice);
+   dp_writeln("%-10s vol:   %7u " TERM_VLINE " invol: %7u",
+              "switches", s.vol_switches, s.invol_switches);
+   dp_writeln("");
+}
+
 static void dp_show_tasks(void)
 {
    row = dp_screen_start_row;
 
    show_actions_menu();
    dp_dump_task_list(true, false);
+
+   if (mode == dp_tasks_mode_sel && sel_tid > 0)
+      dp_show_sel_task_sched_stats();
 }
 
 static void dp_tasks_enter(void)
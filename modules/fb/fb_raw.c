@@ -213,6 +213,8 @@ int fb_user_mmap(pdir_t *pdir, void *vaddr, size_t mmap_len)
    if (!map_framebuffer(pdir, fb_paddr, (ulong)vaddr, mmap_len, true))
       return -ENOMEM;
 
+   /* Save TLB entries, where the framebuffer's alignment allows that */
+   collapse_to_big_pages(pdir, vaddr, mmap_len >> PAGE_SHIFT);
    return 0;
 }
 
@@ -53,6 +53,46 @@ static ssize_t fb_write(fs_handle h, char *user_buf, size_t size, offt *pos)
    return actual_size;
 }
 
+static ssize_t
+fb_readv(fs_handle h, const struct iovec *iov, int iovcnt, offt *pos)
+{
+   ssize_t tot = 0;
+   ssize_t rc;
+
+   for (int i = 0; i < iovcnt; i++) {
+
+      if ((rc = fb_read(h, iov[i].iov_base, iov[i].iov_len, pos)) < 0)
+         return tot ? tot : rc;
+
+      tot += rc;
+
+      if ((size_t)rc < iov[i].iov_len)
+         break; /* reached the end of the framebuffer */
+   }
+
+   return tot;
+}
+
+static ssize_t
+fb_writev(fs_handle h, const struct iovec *iov, int iovcnt, offt *pos)
+{
+   ssize_t tot = 0;
+   ssize_t rc;
+
+   for (int i = 0; i < iovcnt; i++) {
+
+      if ((rc = fb_write(h, iov[i].iov_base, iov[i].iov_len, pos)) < 0)
+         return tot ? tot : rc;
+
+      tot += rc;
+
+      if ((size_t)rc < iov[i].iov_len)
+         break; /* reached the end of the framebuffer */
+   }
+
+   return tot;
+}
+
 static offt fb_seek(fs_handle h, offt off, int whence)
 {
    struct devfs_handle *dh = h;
@@ -122,7 +162,7 @@ fbdev_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (um->off != 0)
       return -EINVAL; /* not supported, at least for the moment */
 
-   if (flags & VFS_MM_DONT_MMAP)
+   if (flags & (VFS_MM_DONT_MMAP | VFS_MM_PREFAULT))
       goto register_mapping;
 
    if ((rc = fb_user_mmap(pdir, um->vaddrp, um->len)) < 0)
@@ -187,6 +227,8 @@ create_fb_device(int minor,
    static const struct file_ops static_ops_fb = {
       .read = fb_read,
       .write = fb_write,
+      .readv = fb_readv,
+      .writev = fb_writev,
       .seek = fb_seek,
       .ioctl = fb_ioctl,
       .mmap = fbdev_mmap,
@@ -42,10 +42,14 @@ DEF_STATIC_CONF_RO(BOOL,  stack_isolation,         KERNEL_STACK_ISOLATION);
 DEF_STATIC_CONF_RO(BOOL,  symbols,                 KERNEL_SYMBOLS);
 DEF_STATIC_CONF_RO(BOOL,  printk_on_curr_tty,      KRN_PRINTK_ON_CURR_TTY);
 DEF_STATIC_CONF_RO(BOOL,  resched_enable_preempt,  KRN_RESCHED_ENABLE_PREEMPT);
+DEF_STATIC_CONF_RO(BOOL,  tickless_idle,           KRN_TICKLESS_IDLE);
+DEF_STATIC_CONF_RO(BOOL,  high_res_timers,         KRN_HIGH_RES_TIMERS);
 DEF_STATIC_CONF_RO(BOOL,  big_io_buf,              KERNEL_BIG_IO_BUF);
 DEF_STATIC_CONF_RO(BOOL,  gcov,                    KERNEL_GCOV);
 DEF_STATIC_CONF_RO(BOOL,  fork_no_cow,             FORK_NO_COW);
 DEF_STATIC_CONF_RO(BOOL,  mmap_no_cow,             MMAP_NO_COW);
+DEF_STATIC_CONF_RO(BOOL,  brk_no_cow,              BRK_NO_COW);
+DEF_STATIC_CONF_RO(BOOL,  mmap_no_huge_pages,      MMAP_NO_HUGE_PAGES);
 DEF_STATIC_CONF_RO(BOOL,  ubsan,                   KERNEL_UBSAN);
 DEF_STATIC_CONF_RO(BOOL,  kernel_64bit_offt,       KERNEL_64BIT_OFFT);
 DEF_STATIC_CONF_RO(BOOL,  clock_drift_comp,        KRN_CLOCK_DRIFT_COMP);
@@ -106,10 +110,14 @@ void sysfs_create_config_obj(void)
       SYSOBJ_CONF_PROP_PAIR(symbols),
       SYSOBJ_CONF_PROP_PAIR(printk_on_curr_tty),
       SYSOBJ_CONF_PROP_PAIR(resched_enable_preempt),
+      SYSOBJ_CONF_PROP_PAIR(tickless_idle),
+      SYSOBJ_CONF_PROP_PAIR(high_res_timers),
       SYSOBJ_CONF_PROP_PAIR(big_io_buf),
       SYSOBJ_CONF_PROP_PAIR(gcov),
       SYSOBJ_CONF_PROP_PAIR(fork_no_cow),
       SYSOBJ_CONF_PROP_PAIR(mmap_no_cow),
+      SYSOBJ_CONF_PROP_PAIR(brk_no_cow),
+      SYSOBJ_CONF_PROP_PAIR(mmap_no_huge_pages),
       SYSOBJ_CONF_PROP_PAIR(ubsan),
       SYSOBJ_CONF_PROP_PAIR(kernel_64bit_offt),
       SYSOBJ_CONF_PROP_PAIR(clock_drift_comp),
@@ -359,7 +359,7 @@ int sysfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (sh->type != VFS_FILE)
       return -EACCES;
 
-   if (flags & VFS_MM_DONT_MMAP)
+   if (flags & (VFS_MM_DONT_MMAP | VFS_MM_PREFAULT))
       return 0;
 
    if (sh->file.data_max_len >= 0)
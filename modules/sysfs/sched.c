@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/sched.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+enum sched_stats_prop {
+
+   sched_stats_run_delay,
+   sched_stats_timeslice,
+};
+
+static offt
+sched_hist_dump(struct sched_hist *h, char *buf, offt buf_sz)
+{
+   offt written = 0;
+   int len;
+
+   len = snprintk(buf, (size_t)buf_sz,
+                  "count: %u\navg_us: %llu\nmax_us: %u\n",
+                  h->lat.count,
+                  h->lat.count ? h->lat.total_ns / h->lat.count / 1000 : 0,
+                  h->lat.max_us);
+
+   if (len <= 0)
+      return 0;
+
+   written += len;
+
+   for (int i = 0; i < SCHED_HIST_BUCKETS && written < buf_sz; i++) {
+
+      const u32 lo = i ? 1u << (i - 1) : 0;
+      const u32 hi = 1u << i;
+
+      if (i < SCHED_HIST_BUCKETS - 1)
+         len = snprintk(buf + written, (size_t)(buf_sz - written),
+                        "%7u - %7u us: %u\n", lo, hi, h->buckets[i]);
+      else
+         len = snprintk(buf + written, (size_t)(buf_sz - written),
+                        "%7u -     inf us: %u\n", lo, h->buckets[i]);
+
+      if (len <= 0)
+         break;
+
+      written += len;
+   }
+
+   return written;
+}
+
+static offt
+sched_hist_load(struct sysobj *obj,
+                void *data, void *buf, offt buf_sz, offt off)
+{
+   struct sched_stats s;
+   ASSERT(off == 0);
+
+   sched_get_global_stats(&s);
+
+   if ((ulong)data == sched_stats_run_delay)
+      return sched_hist_dump(&s.run_delay, buf, buf_sz);
+
+   return sched_hist_dump(&s.timeslice, buf, buf_sz);
+}
+
+static offt
+sched_switches_load(struct sysobj *obj,
+                    void *data, void *buf, offt buf_sz, offt off)
+{
+   struct sched_stats s;
+   ASSERT(off == 0);
+
+   sched_get_global_stats(&s);
+   return snprintk(buf, (size_t)buf_sz,
+                   "voluntary: %u\ninvoluntary: %u\n",
+                   s.vol_switches, s.invol_switches);
+}
+
+static const struct sysobj_prop_type sched_ptype_ro_hist = {
+   .load = &sched_hist_load
+};
+
+static const struct sysobj_prop_type sched_ptype_ro_switches = {
+   .load = &sched_switches_load
+};
+
+DEF_STATIC_SYSOBJ_PROP(run_delay, &sched_ptype_ro_hist);
+DEF_STATIC_SYSOBJ_PROP(timeslice, &sched_ptype_ro_hist);
+DEF_STATIC_SYSOBJ_PROP(switches, &sched_ptype_ro_switches);
+
+/* sysfs path: /sched */
+void sysfs_create_sched_obj(void)
+{
+   struct sysobj *sched;
+
+   sched = sysfs_create_custom_obj(
+      "sched",
+      NULL,       /* hooks */
+      &prop_run_delay, TO_PTR(sched_stats_run_delay),
+      &prop_timeslice, TO_PTR(sched_stats_timeslice),
+      &prop_switches, NULL,
+      NULL
+   );
+
+   if (!sched)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "sched", sched))
+      goto fail;
+
+   /* Success */
+   return;
+
+fail:
+   panic("Unable to create the sysfs sched obj");
+}
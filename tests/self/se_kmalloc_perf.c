@@ -49,6 +49,64 @@ static void kmalloc_perf_per_size(u32 size)
           size, duration / (u64) iters);
 }
 
+/*
+ * Compare kmalloc() + kfree() with the object caches, for a working set of
+ * KMEM_PERF_OBJS objects, like a burst of tasks, mappings or handles.
+ */
+#define KMEM_PERF_OBJS             32
+#define KMEM_PERF_ITERS          1000
+
+static u64 kmem_cache_perf_kmalloc(u32 size)
+{
+   u64 start = RDTSC();
+
+   for (int i = 0; i < KMEM_PERF_ITERS; i++) {
+
+      for (int j = 0; j < KMEM_PERF_OBJS; j++) {
+         if (!(allocations[j] = kmalloc(size)))
+            panic("We were unable to allocate %u bytes\n", size);
+      }
+
+      for (int j = 0; j < KMEM_PERF_OBJS; j++)
+         kfree2(allocations[j], size);
+   }
+
+   return (RDTSC() - start) / (KMEM_PERF_ITERS * KMEM_PERF_OBJS);
+}
+
+static u64 kmem_cache_perf_cache(struct kmem_cache *c)
+{
+   u64 start = RDTSC();
+
+   for (int i = 0; i < KMEM_PERF_ITERS; i++) {
+
+      for (int j = 0; j < KMEM_PERF_OBJS; j++) {
+         if (!(allocations[j] = kmem_cache_alloc(c)))
+            panic("We were unable to allocate a '%s' object\n", c->name);
+      }
+
+      for (int j = 0; j < KMEM_PERF_OBJS; j++)
+         kmem_cache_free(c, allocations[j]);
+   }
+
+   return (RDTSC() - start) / (KMEM_PERF_ITERS * KMEM_PERF_OBJS);
+}
+
+static void kmem_cache_perf_per_size(u32 size)
+{
+   struct kmem_cache c = KMEM_CACHE_INIT("perf", size, NULL);
+   u64 kmalloc_cycles, cache_cycles;
+
+   kmalloc_cycles = kmem_cache_perf_kmalloc(size);
+   cache_cycles = kmem_cache_perf_cache(&c);
+   kmem_cache_destroy(&c);
+
+   kmalloc_perf_print_iters(KMEM_PERF_ITERS * KMEM_PERF_OBJS);
+   printk(NO_PREFIX "Cycles per alloc + free(%4u): "
+          "kmalloc: %4" PRIu64 ", kmem_cache: %4" PRIu64 "\n",
+          size, kmalloc_cycles, cache_cycles);
+}
+
 void selftest_kmalloc_perf(void)
 {
    const int iters = 1000;
@@ -90,6 +148,14 @@ void selftest_kmalloc_perf(void)
       kmalloc_perf_per_size(s);
    }
 
+   for (u32 s = 32; s <= 1024; s *= 2) {
+
+      if (se_is_stop_requested())
+         break;
+
+      kmem_cache_perf_per_size(s);
+   }
+
    kfree_array_obj(allocations, void *, 10000);
 
    if (se_is_stop_requested())
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/sys_types.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/self_tests.h>
+
+/*
+ * Priority inversion test
+ * -------------------------
+ *
+ * The classic scenario: a low priority task (L) holds a kmutex wanted by a
+ * high priority task (H), while a medium priority task (M) is hogging the CPU.
+ * Without priority inheritance, L cannot run until M is done and H waits for
+ * the whole M's run (unbounded inversion). With priority inheritance instead,
+ * L runs at the priority of H until it releases the mutex, so H waits at most
+ * for L's critical section.
+ */
+
+#define PI_L_HOLD_MS                  100
+#define PI_M_HOG_MS                   500
+#define PI_H_MAX_WAIT_MS              300
+
+static struct kmutex pi_mutex;
+static volatile bool pi_l_has_lock;
+static volatile u64 pi_h_wait_ns;
+
+static void pi_busy_wait_ms(u64 ms)
+{
+   const u64 end = get_hr_time_ns() + ms * (u64)MILLION;
+
+   while (get_hr_time_ns() < end) { }
+}
+
+static void pi_low_thread(void *unused)
+{
+   kmutex_lock(&pi_mutex);
+   {
+      pi_l_has_lock = true;
+      pi_busy_wait_ms(PI_L_HOLD_MS);
+   }
+   kmutex_unlock(&pi_mutex);
+}
+
+static void pi_med_thread(void *unused)
+{
+   pi_busy_wait_ms(PI_M_HOG_MS);
+}
+
+static void pi_high_thread(void *unused)
+{
+   const u64 start = get_hr_time_ns();
+
+   kmutex_lock(&pi_mutex);
+   {
+      pi_h_wait_ns = get_hr_time_ns() - start;
+   }
+   kmutex_unlock(&pi_mutex);
+}
+
+static int pi_create_rt_thread(void (*func)(void *), int rt_prio)
+{
+   int tid = kthread_create(func, 0, NULL);
+   VERIFY(tid > 0);
+
+   /* NOTE: preemption is disabled: the thread cannot run yet */
+   sched_set_task_policy(get_task(tid), SCHED_FIFO, rt_prio);
+   return tid;
+}
+
+void selftest_kmutex_pi(void)
+{
+   int tids[3];
+
+   kmutex_init(&pi_mutex, 0);
+   pi_l_has_lock = false;
+   pi_h_wait_ns = 0;
+
+   tids[0] = kthread_create(&pi_low_thread, 0, NULL);
+   VERIFY(tids[0] > 0);
+
+   while (!pi_l_has_lock)
+      kernel_yield();
+
+   disable_preemption();
+   {
+      tids[1] = pi_create_rt_thread(&pi_med_thread, 10);
+      tids[2] = pi_create_rt_thread(&pi_high_thread, 20);
+   }
+   enable_preemption();
+
+   kthread_join_all(tids, ARRAY_SIZE(tids), true);
+   kmutex_destroy(&pi_mutex);
+
+   printk("[se_kmutex_pi] H waited: %llu ms (L's hold time: %d ms)\n",
+          pi_h_wait_ns / MILLION, PI_L_HOLD_MS);
+
+   VERIFY(pi_h_wait_ns < PI_H_MAX_WAIT_MS * (u64)MILLION);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(kmutex_pi, se_med, &selftest_kmutex_pi)
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/atomics.h>
+
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/self_tests.h>
+
+#define SE_SCHED_MAX_THREADS             1000
+
+static int tids[SE_SCHED_MAX_THREADS];
+static ATOMIC(u32) started_threads;
+static volatile bool measure_started;
+static volatile bool stop_threads;
+static ATOMIC(u32) yields_count;
+
+static void se_sched_yield_thread(void *unused)
+{
+   started_threads++;
+
+   while (!stop_threads) {
+
+      if (measure_started)
+         yields_count++;
+
+      kernel_yield();
+   }
+}
+
+static void se_sched_measure(int n)
+{
+   u64 start, elapsed;
+   u32 yields;
+   int created;
+
+   started_threads = 0;
+   measure_started = false;
+   stop_threads = false;
+   yields_count = 0;
+
+   for (created = 0; created < n; created++) {
+
+      tids[created] = kthread_create(se_sched_yield_thread, 0, NULL);
+
+      if (tids[created] < 0) {
+         printk("[se_sched] Unable to create thread %d, stop\n", created);
+         break;
+      }
+   }
+
+   while (started_threads != (u32)created)
+      kernel_yield();
+
+   disable_preemption();
+   {
+      start = RDTSC();
+      measure_started = true;
+   }
+   enable_preemption();
+
+   /* Let the threads yield to each other for a while */
+   kernel_sleep(TIMER_HZ / 2);
+
+   disable_preemption();
+   {
+      elapsed = RDTSC() - start;
+      yields = yields_count;
+      stop_threads = true;
+   }
+   enable_preemption();
+
+   kthread_join_all(tids, (size_t)created, true);
+
+   printk("[se_sched] runnable tasks: %4d, switches: %7u, "
+          "cycles/switch: %" PRIu64 "\n",
+          created, yields, yields ? elapsed / yields : 0);
+}
+
+void selftest_sched_perf(void)
+{
+   se_sched_measure(10);
+   se_sched_measure(100);
+   se_sched_measure(1000);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(sched_perf, se_med, &selftest_sched_perf)
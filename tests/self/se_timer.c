@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/atomics.h>
+
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/self_tests.h>
+
+#define SE_TIMER_TH_COUNT                  1000
+
+extern u64 timer_irq_off_cycles_tot;
+extern u32 timer_irq_off_cycles_max;
+extern u32 timer_irq_off_ticks;
+
+static int tids[SE_TIMER_TH_COUNT];
+static ATOMIC(u32) sleeping_threads;
+static ATOMIC(u32) woken_up_threads;
+
+static void se_timer_thread(void *arg)
+{
+   /*
+    * Spread the wakeups over 2 seconds, after 1 second, in order to have
+    * timers both in the level 0 of the wheel and in the upper levels.
+    */
+   const u32 ticks = TIMER_HZ + ((u32)(ulong)arg * 7) % (2 * TIMER_HZ);
+
+   sleeping_threads++;
+   kernel_sleep(ticks);
+   woken_up_threads++;
+}
+
+static void reset_timer_irq_off_counters(void)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      timer_irq_off_cycles_tot = 0;
+      timer_irq_off_cycles_max = 0;
+      timer_irq_off_ticks = 0;
+   }
+   enable_interrupts(&var);
+}
+
+static void dump_timer_irq_off_counters(const char *when)
+{
+   u64 tot;
+   u32 max, ticks;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      tot = timer_irq_off_cycles_tot;
+      max = timer_irq_off_cycles_max;
+      ticks = timer_irq_off_ticks;
+   }
+   enable_interrupts(&var);
+
+   printk("[se_timer] %s: ticks: %u, IRQ-off cycles avg: %" PRIu64
+          ", max: %u\n", when, ticks, ticks ? tot / ticks : 0, max);
+}
+
+void selftest_timer_wheel(void)
+{
+   int n;
+
+   printk("[se_timer] No sleeping tasks\n");
+   reset_timer_irq_off_counters();
+   kernel_sleep(TIMER_HZ / 2);
+   dump_timer_irq_off_counters("idle");
+
+   sleeping_threads = 0;
+   woken_up_threads = 0;
+
+   for (n = 0; n < SE_TIMER_TH_COUNT; n++) {
+
+      if ((tids[n] = kthread_create(se_timer_thread, 0, TO_PTR(n))) < 0) {
+         printk("[se_timer] Unable to create thread %d, stop\n", n);
+         break;
+      }
+   }
+
+   while (sleeping_threads != (u32)n)
+      kernel_sleep(1);
+
+   printk("[se_timer] %d sleeping tasks\n", n);
+   reset_timer_irq_off_counters();
+   kernel_sleep(TIMER_HZ / 2);
+   dump_timer_irq_off_counters("before wakeups");
+
+   reset_timer_irq_off_counters();
+   kthread_join_all(tids, (size_t)n, true);
+   dump_timer_irq_off_counters("during wakeups");
+
+   VERIFY(woken_up_threads == (u32)n);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(timer_wheel, se_med, &selftest_timer_wheel)
+
+static void se_hrtimer_measure(u64 ns)
+{
+   const int iters = 20;
+   u64 start, late, late_tot = 0, late_max = 0;
+
+   for (int i = 0; i < iters; i++) {
+
+      start = get_hr_time_ns();
+      kernel_sleep_ns(ns);
+      late = get_hr_time_ns() - start;
+
+      if (late < ns) {
+
+         /* Without hr timers, the sleep is in ticks: it can be shorter */
+         if (KRN_HIGH_RES_TIMERS)
+            panic("[se_timer] Woke up too early: %" PRIu64 " ns", late);
+
+         late = ns;
+      }
+
+      late -= ns;
+      late_tot += late;
+      late_max = MAX(late_max, late);
+   }
+
+   printk("[se_timer] sleep %7" PRIu64 " ns -> late avg: %7" PRIu64
+          " ns, max: %7" PRIu64 " ns\n", ns, late_tot / iters, late_max);
+}
+
+void selftest_hrtimer(void)
+{
+   printk("[se_timer] High-resolution timers: %s\n",
+          KRN_HIGH_RES_TIMERS ? "enabled" : "disabled");
+
+   se_hrtimer_measure(50 * 1000);
+   se_hrtimer_measure(200 * 1000);
+   se_hrtimer_measure(1000 * 1000);
+   se_hrtimer_measure(3 * 1000 * 1000);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(hrtimer, se_short, &selftest_hrtimer)
@@ -22,11 +22,19 @@ CMD_ENTRY(bad_read,     TT_SHORT,  true)
 CMD_ENTRY(bad_write,    TT_SHORT,  true)
 CMD_ENTRY(fork_perf,    TT_LONG,   true)
 CMD_ENTRY(vfork_perf,   TT_LONG,   true)
+CMD_ENTRY(fork_cow_pt,  TT_SHORT,  true)
+CMD_ENTRY(fork_big_exit, TT_MED,   true)
 CMD_ENTRY(syscall_perf, TT_MED,    true)
+CMD_ENTRY(vdso_time,    TT_SHORT,  true)
+CMD_ENTRY(sched_rt,     TT_SHORT,  true)
 CMD_ENTRY(fpu,          TT_SHORT,  true)
 CMD_ENTRY(brk,          TT_SHORT,  true)
 CMD_ENTRY(mmap,         TT_MED,    true)
 CMD_ENTRY(mmap2,        TT_SHORT,  true)
+CMD_ENTRY(mremap,       TT_SHORT,  true)
+CMD_ENTRY(madvise,      TT_SHORT,  true)
+CMD_ENTRY(mmap_huge,    TT_SHORT,  true)
+CMD_ENTRY(stack_grow,   TT_SHORT,  true)
 CMD_ENTRY(kcow,         TT_SHORT,  true)
 CMD_ENTRY(wpid1,        TT_SHORT,  true)
 CMD_ENTRY(wpid2,        TT_SHORT,  true)
@@ -50,8 +58,12 @@ CMD_ENTRY(fs4,          TT_SHORT,  true)
 CMD_ENTRY(fs5,          TT_SHORT,  true)
 CMD_ENTRY(fs6,          TT_SHORT,  true)
 CMD_ENTRY(fs7,          TT_SHORT,  true)
+CMD_ENTRY(fs8,          TT_SHORT,  true)
+CMD_ENTRY(fs9,          TT_SHORT,  true)
+CMD_ENTRY(fs10,         TT_SHORT,  true)
 CMD_ENTRY(fs_perf1,     TT_SHORT,  true)
 CMD_ENTRY(fs_perf2,     TT_SHORT,  true)
+CMD_ENTRY(fs_perf3,     TT_SHORT,  true)
 CMD_ENTRY(fmmap1,       TT_SHORT,  true)
 CMD_ENTRY(fmmap2,       TT_SHORT,  true)
 CMD_ENTRY(fmmap3,       TT_SHORT,  true)
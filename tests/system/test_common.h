@@ -3,6 +3,10 @@
 #pragma once
 #include "devshell.h"
 
+#ifndef SYS_sendfile64
+   #define SYS_sendfile64 SYS_sendfile  /* 64-bit archs have just sendfile() */
+#endif
+
 void create_test_file(const char *path, int n);
 int remove_test_file(const char *path, int n);
 void remove_test_file_expecting_success(const char *path, int n);
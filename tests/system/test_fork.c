@@ -295,3 +295,134 @@ int cmd_vfork0(int argc, char **argv)
    print_waitpid_change(pid, wstatus);
    return failed;
 }
+
+static bool check_pattern(u32 *buf, size_t words, u32 val)
+{
+   for (size_t i = 0; i < words; i += 1024)
+      if (buf[i] != val + (u32)i)
+         return false;
+
+   return true;
+}
+
+static void write_pattern(u32 *buf, size_t words, u32 val)
+{
+   for (size_t i = 0; i < words; i += 1024)
+      buf[i] = val + (u32)i;
+}
+
+/*
+ * After fork(), parent and child share the page tables until one of them
+ * writes. Check that every process still sees its own copy of the memory,
+ * even when the same tables are shared by more than two processes.
+ */
+int cmd_fork_cow_pt(int argc, char **argv)
+{
+   const size_t size = 12 * MB;        /* spans at least 3 page tables */
+   const size_t words = size / sizeof(u32);
+   int rc, pid, gchild, wstatus;
+   u32 *buf;
+
+   buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+              MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+   DEVSHELL_CMD_ASSERT(buf != (void *)-1);
+   write_pattern(buf, words, 1000);
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      gchild = fork();
+
+      if (gchild < 0)
+         exit(1);
+
+      if (!gchild) {
+
+         /* Grandchild: still sharing the tables with its parent */
+         if (!check_pattern(buf, words, 1000))
+            exit(1);
+
+         write_pattern(buf, words, 3000);
+         exit(check_pattern(buf, words, 3000) ? 0 : 1);
+      }
+
+      if (!check_pattern(buf, words, 1000))
+         exit(1);
+
+      write_pattern(buf, words, 2000);
+
+      if (waitpid(gchild, &wstatus, 0) != gchild)
+         exit(1);
+
+      if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0)
+         exit(1);
+
+      exit(check_pattern(buf, words, 2000) ? 0 : 1);
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+
+   if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+      printf(STR_PARENT "The child failed\n");
+      print_waitpid_change(pid, wstatus);
+      return 1;
+   }
+
+   if (!check_pattern(buf, words, 1000)) {
+      printf(STR_PARENT "The memory changed after the child wrote to it\n");
+      return 1;
+   }
+
+   write_pattern(buf, words, 4000);
+   DEVSHELL_CMD_ASSERT(check_pattern(buf, words, 4000));
+
+   rc = munmap(buf, size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+/*
+ * Let many children with a big address space exit in a row: their teardown
+ * is deferred (each one holds less than MM_REAPER_MAX_PENDING_MEM), but the
+ * memory must always come back in time for the next one.
+ */
+int cmd_fork_big_exit(int argc, char **argv)
+{
+   const size_t size = 28 * MB;
+   int rc, pid, wstatus;
+
+   for (int i = 0; i < 16; i++) {
+
+      pid = fork();
+      DEVSHELL_CMD_ASSERT(pid >= 0);
+
+      if (!pid) {
+
+         char *buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                          MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+         if (buf == (void *)-1)
+            exit(1);
+
+         for (size_t off = 0; off < size; off += 4096)
+            buf[off] = (char)i;
+
+         exit(0);
+      }
+
+      rc = waitpid(pid, &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == pid);
+
+      if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+         printf(STR_PARENT "child #%d failed\n", i);
+         print_waitpid_change(pid, wstatus);
+         return 1;
+      }
+   }
+
+   return 0;
+}
@@ -14,12 +14,21 @@
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <dirent.h>
 
 #include "devshell.h"
 #include "sysenter.h"
 #include "test_common.h"
 
+#ifndef SPLICE_F_NONBLOCK
+   #define SPLICE_F_NONBLOCK 2  /* defined by <fcntl.h> only with _GNU_SOURCE */
+#endif
+
+#ifndef RWF_NOWAIT
+   #define RWF_NOWAIT        8  /* defined by <sys/uio.h> only w/ _GNU_SOURCE */
+#endif
+
 void create_test_file1(void);
 void write_on_test_file1(void);
 
@@ -40,6 +49,354 @@ int cmd_fs7(int argc, char **argv)
    return 0;
 }
 
+/*
+ * Test read() and write() on files and pipes with big user buffers and with
+ * buffers partially or fully unmapped.
+ */
+int cmd_fs8(int argc, char **argv)
+{
+   const size_t buf_size = 1024 * 1024;
+   const char *path = "/tmp/fs8_test";
+   struct stat statbuf;
+   char *buf, *tail;
+   int fd, rc, pfds[2];
+
+   buf = mmap(NULL, buf_size,
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+   DEVSHELL_CMD_ASSERT(buf != MAP_FAILED);
+
+   for (size_t i = 0; i < buf_size; i++)
+      buf[i] = (char)(i % 251);
+
+   fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+
+   /* Big buffers must be transferred at once */
+   rc = write(fd, buf, buf_size);
+   DEVSHELL_CMD_ASSERT(rc == (int)buf_size);
+
+   memset(buf, 0, buf_size);
+
+   rc = pread(fd, buf, buf_size, 0);
+   DEVSHELL_CMD_ASSERT(rc == (int)buf_size);
+
+   for (size_t i = 0; i < buf_size; i++)
+      DEVSHELL_CMD_ASSERT(buf[i] == (char)(i % 251));
+
+   /* Unmap the last page of the buffer */
+   tail = buf + buf_size - 4096;
+   rc = munmap(tail, 4096);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* The transfer stops at the unmapped page */
+   rc = pread(fd, tail - 4096, 8192, 0);
+   DEVSHELL_CMD_ASSERT(rc == 4096);
+
+   rc = pwrite(fd, tail - 4096, 8192, (off_t)buf_size);
+   DEVSHELL_CMD_ASSERT(rc == 4096);
+
+   /* Nothing can be transferred with a fully unmapped buffer */
+   errno = 0;
+   rc = pread(fd, tail, 4096, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EFAULT);
+
+   errno = 0;
+   rc = pwrite(fd, tail, 4096, (off_t)buf_size + 4096);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EFAULT);
+
+   rc = fstat(fd, &statbuf);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(statbuf.st_size == (off_t)buf_size + 4096);
+
+   close(fd);
+   rc = unlink(path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Pipes: a failed read() must not consume any data */
+   rc = pipe(pfds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = write(pfds[1], buf, 100);
+   DEVSHELL_CMD_ASSERT(rc == 100);
+
+   errno = 0;
+   rc = write(pfds[1], tail, 100);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EFAULT);
+
+   errno = 0;
+   rc = read(pfds[0], tail, 100);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EFAULT);
+
+   rc = read(pfds[0], buf + 100, 100);
+   DEVSHELL_CMD_ASSERT(rc == 100);
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, buf + 100, 100));
+
+   close(pfds[0]);
+   close(pfds[1]);
+
+   rc = munmap(buf, buf_size - 4096);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+static int
+do_sendfile(int out_fd, int in_fd, long long *off, size_t count)
+{
+   return syscall(SYS_sendfile64, out_fd, in_fd, off, count);
+}
+
+static int
+do_splice(int fd_in, long long *off_in, int fd_out, long long *off_out,
+          size_t len, unsigned flags)
+{
+   return syscall(SYS_splice, fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+static void
+fs9_check_contents(int fd, long long off, const char *exp, size_t len)
+{
+   char buf[4096];
+   int rc;
+
+   while (len > 0) {
+
+      const size_t n = len < sizeof(buf) ? len : sizeof(buf);
+
+      rc = pread(fd, buf, n, (off_t)off);
+      DEVSHELL_CMD_ASSERT(rc == (int)n);
+      DEVSHELL_CMD_ASSERT(!memcmp(buf, exp, n));
+
+      off += n;
+      exp += n;
+      len -= n;
+   }
+}
+
+/* Test sendfile() and splice() */
+int cmd_fs9(int argc, char **argv)
+{
+   const size_t fsize = 16384 + 100;
+   const char *src_path = "/tmp/fs9_src";
+   const char *dst_path = "/tmp/fs9_dst";
+   long long off, off2;
+   int src, dst, rc, pfds[2];
+   char *exp, buf[128];
+
+   exp = calloc(1, fsize);
+   DEVSHELL_CMD_ASSERT(exp != NULL);
+
+   for (size_t i = 0; i < 10000; i++)
+      exp[i] = (char)(i % 251);
+
+   memset(exp + 16384, 'x', 100);
+
+   src = open(src_path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(src >= 0);
+
+   dst = open(dst_path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(dst >= 0);
+
+   /* Leave a hole in the range [10000, 16384) */
+   rc = write(src, exp, 10000);
+   DEVSHELL_CMD_ASSERT(rc == 10000);
+
+   rc = pwrite(src, exp + 16384, 100, 16384);
+   DEVSHELL_CMD_ASSERT(rc == 100);
+
+   rc = lseek(src, 0, SEEK_SET);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* sendfile() with an offset: the file position must not move */
+   off = 1000;
+   rc = do_sendfile(dst, src, &off, fsize);
+   DEVSHELL_CMD_ASSERT(rc == (int)fsize - 1000);
+   DEVSHELL_CMD_ASSERT(off == (long long)fsize);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_CUR) == 0);
+   fs9_check_contents(dst, 0, exp + 1000, fsize - 1000);
+
+   /* sendfile() without an offset: the file position moves */
+   rc = do_sendfile(dst, src, NULL, 5000);
+   DEVSHELL_CMD_ASSERT(rc == 5000);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_CUR) == 5000);
+   fs9_check_contents(dst, (long long)fsize - 1000, exp, 5000);
+
+   /* sendfile() cannot read from a pipe */
+   rc = pipe(pfds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   errno = 0;
+   rc = do_sendfile(dst, pfds[0], NULL, 100);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   /* splice() from a file to a pipe: stops when the pipe is full */
+   off = 0;
+   rc = do_splice(src, &off, pfds[1], NULL, fsize, 0);
+   DEVSHELL_CMD_ASSERT(rc > 0 && rc <= (int)fsize);
+   DEVSHELL_CMD_ASSERT(off == rc);
+
+   for (int i = 0; i < rc; i += (int)sizeof(buf)) {
+
+      const int n = rc - i < (int)sizeof(buf) ? rc - i : (int)sizeof(buf);
+
+      DEVSHELL_CMD_ASSERT(read(pfds[0], buf, n) == n);
+      DEVSHELL_CMD_ASSERT(!memcmp(buf, exp + i, n));
+   }
+
+   /* splice() from a pipe to a file, with an offset */
+   rc = write(pfds[1], "hello", 5);
+   DEVSHELL_CMD_ASSERT(rc == 5);
+
+   off = 3;
+   rc = do_splice(pfds[0], NULL, dst, &off, 1000, 0);
+   DEVSHELL_CMD_ASSERT(rc == 5);
+   DEVSHELL_CMD_ASSERT(off == 8);
+
+   rc = pread(dst, buf, 5, 3);
+   DEVSHELL_CMD_ASSERT(rc == 5);
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, "hello", 5));
+
+   /* Error cases */
+   errno = 0;
+   rc = do_splice(pfds[0], NULL, dst, NULL, 100, SPLICE_F_NONBLOCK);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+
+   errno = 0;
+   rc = do_splice(src, NULL, dst, NULL, 100, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   errno = 0;
+   off2 = 0;
+   rc = do_splice(src, NULL, pfds[1], &off2, 100, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ESPIPE);
+
+   errno = 0;
+   rc = do_splice(src, NULL, pfds[1], NULL, 100, 0x100);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   close(pfds[0]);
+   close(pfds[1]);
+   close(dst);
+   close(src);
+   free(exp);
+
+   rc = unlink(src_path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = unlink(dst_path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+static int
+do_preadv2(int fd, const struct iovec *iov, int cnt, long long off, int fl)
+{
+   return syscall(SYS_preadv2, fd, iov, cnt,
+                  (long)off, (long)((unsigned long long)off >> 32), fl);
+}
+
+static int
+do_pwritev2(int fd, const struct iovec *iov, int cnt, long long off, int fl)
+{
+   return syscall(SYS_pwritev2, fd, iov, cnt,
+                  (long)off, (long)((unsigned long long)off >> 32), fl);
+}
+
+/* Test readv(), writev() and their positional variants */
+int cmd_fs10(int argc, char **argv)
+{
+   const char *path = "/tmp/fs10_test";
+   char a[8], b[16], c[32];
+   struct iovec iov[3] = {
+      { .iov_base = a, .iov_len = sizeof(a) },
+      { .iov_base = b, .iov_len = sizeof(b) },
+      { .iov_base = c, .iov_len = sizeof(c) },
+   };
+   int fd, rc, pfds[2];
+
+   memset(a, 'a', sizeof(a));
+   memset(b, 'b', sizeof(b));
+   memset(c, 'c', sizeof(c));
+
+   fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+
+   /* pwritev() must not move the file position */
+   rc = do_pwritev2(fd, iov, 3, 100, 0);
+   DEVSHELL_CMD_ASSERT(rc == 56);
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 0);
+
+   /* pwritev2() with offset -1 uses (and moves) the file position */
+   rc = do_pwritev2(fd, iov, 1, -1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 8);
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 8);
+
+   memset(a, 0, sizeof(a));
+   memset(b, 0, sizeof(b));
+   memset(c, 0, sizeof(c));
+
+   /* preadv() stops at EOF, in the middle of the last segment */
+   rc = do_preadv2(fd, iov, 3, 104, 0);
+   DEVSHELL_CMD_ASSERT(rc == 52);
+   DEVSHELL_CMD_ASSERT(!memcmp(a, "aaaabbbb", 8));
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 8);
+
+   /* preadv2() with offset -1: at the file position there's a hole */
+   memset(a, 'a', sizeof(a));
+   rc = do_preadv2(fd, iov, 1, -1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 8);
+   DEVSHELL_CMD_ASSERT(!memcmp(a, "\0\0\0\0\0\0\0\0", 8));
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_CUR) == 16);
+
+   errno = 0;
+   rc = do_preadv2(fd, iov, 3, 0, RWF_NOWAIT);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EOPNOTSUPP);
+
+   errno = 0;
+   rc = do_preadv2(fd, iov, 3, -2, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   /* Unlike preadv2(), plain preadv() does not accept the offset -1 */
+   errno = 0;
+   rc = syscall(SYS_preadv, fd, iov, 1, -1L, -1L);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   close(fd);
+   rc = unlink(path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Pipes: writev() and readv() move the data of all the segments */
+   rc = pipe(pfds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   memset(a, 'x', sizeof(a));
+   memset(b, 'y', sizeof(b));
+   memset(c, 'z', sizeof(c));
+
+   rc = writev(pfds[1], iov, 3);
+   DEVSHELL_CMD_ASSERT(rc == 56);
+
+   memset(a, 0, sizeof(a));
+   memset(b, 0, sizeof(b));
+   memset(c, 0, sizeof(c));
+
+   iov[2].iov_len = 64; /* more than what's in the pipe */
+   rc = readv(pfds[0], iov, 3);
+   DEVSHELL_CMD_ASSERT(rc == 56);
+   DEVSHELL_CMD_ASSERT(a[7] == 'x' && b[15] == 'y' && c[31] == 'z');
+   iov[2].iov_len = sizeof(c);
+
+   /* Pipes have no offsets */
+   errno = 0;
+   rc = do_preadv2(pfds[0], iov, 3, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ESPIPE);
+
+   close(pfds[0]);
+   close(pfds[1]);
+   return 0;
+}
+
 static const char test_str[] = "this is a test string\n";
 static const char test_str2[] = "hello from the 2nd page";
 static const char test_str_exp[] = "This is a test string\n";
@@ -17,6 +17,7 @@
 
 #include "devshell.h"
 #include "sysenter.h"
+#include "test_common.h"
 
 void create_test_file(const char *path, int n)
 {
@@ -109,3 +110,91 @@ int cmd_fs_perf2(int argc, char **argv)
    DEVSHELL_CMD_ASSERT(rc == 0);
    return 0;
 }
+
+static void
+fs_perf3_copy_rw(int src, int dst, size_t fsize)
+{
+   char buf[4096];
+   int rc;
+
+   for (size_t tot = 0; tot < fsize; tot += sizeof(buf)) {
+
+      rc = read(src, buf, sizeof(buf));
+      DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+
+      rc = write(dst, buf, sizeof(buf));
+      DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+   }
+}
+
+static void
+fs_perf3_copy_sendfile(int src, int dst, size_t fsize)
+{
+   int rc;
+
+   for (size_t tot = 0; tot < fsize; tot += (size_t)rc) {
+      rc = syscall(SYS_sendfile64, dst, src, NULL, fsize - tot);
+      DEVSHELL_CMD_ASSERT(rc > 0);
+   }
+}
+
+/* Compare the cost of copying a file with read() + write() and sendfile() */
+int cmd_fs_perf3(int argc, char **argv)
+{
+   const size_t fsize = 1024 * KB;
+   char src_path[256], dst_path[256];
+   char buf[4096];
+   u64 start, elapsed_rw, elapsed_sf;
+   int src, dst, rc;
+   const char *dest_dir = argc > 0 ? argv[0] : "/tmp";
+
+   printf("Using '%s' as test dir\n", dest_dir);
+
+   sprintf(src_path, "%s/test_src", dest_dir);
+   sprintf(dst_path, "%s/test_dst", dest_dir);
+
+   src = open(src_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(src > 0);
+
+   for (size_t i = 0; i < sizeof(buf); i++)
+      buf[i] = 'a' + (char)(i % 26);
+
+   for (size_t tot = 0; tot < fsize; tot += sizeof(buf)) {
+      rc = write(src, buf, sizeof(buf));
+      DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+   }
+
+   /* read() + write() */
+   dst = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(dst > 0);
+   lseek(src, 0, SEEK_SET);
+
+   start = RDTSC();
+   fs_perf3_copy_rw(src, dst, fsize);
+   elapsed_rw = RDTSC() - start;
+   close(dst);
+
+   /* sendfile() */
+   dst = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(dst > 0);
+   lseek(src, 0, SEEK_SET);
+
+   start = RDTSC();
+   fs_perf3_copy_sendfile(src, dst, fsize);
+   elapsed_sf = RDTSC() - start;
+   close(dst);
+   close(src);
+
+   printf("Tot copied: %u KB\n", (unsigned)(fsize / KB));
+   printf("read() + write(), avg. cost per KB: %4" PRIu64 " cycles\n",
+          elapsed_rw / (fsize / KB));
+   printf("sendfile(),       avg. cost per KB: %4" PRIu64 " cycles\n",
+          elapsed_sf / (fsize / KB));
+
+   rc = unlink(src_path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = unlink(dst_path);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
@@ -14,6 +14,8 @@
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/auxv.h>
+#include <sched.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -147,6 +149,144 @@ int cmd_syscall_perf(int argc, char **argv)
    return 0;
 }
 
+static bool timespec_le(struct timespec *a, struct timespec *b)
+{
+   if (a->tv_sec != b->tv_sec)
+      return a->tv_sec < b->tv_sec;
+
+   return a->tv_nsec <= b->tv_nsec;
+}
+
+int cmd_vdso_time(int argc, char **argv)
+{
+   const int iters = 100 * 1000;
+   struct timespec ts, prev = {0};
+   struct timeval tv;
+   ull_t start, duration;
+
+   if (running_on_tilck()) {
+      printf("AT_SYSINFO_EHDR: %p\n", (void *)getauxval(AT_SYSINFO_EHDR));
+      DEVSHELL_CMD_ASSERT(getauxval(AT_SYSINFO_EHDR) != 0);
+   }
+
+   /* The time must never go backwards, especially across the ticks */
+   for (int i = 0; i < iters; i++) {
+      DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+      DEVSHELL_CMD_ASSERT(timespec_le(&prev, &ts));
+      prev = ts;
+   }
+
+   /* gettimeofday() must agree with CLOCK_REALTIME */
+   DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_REALTIME, &ts) == 0);
+   DEVSHELL_CMD_ASSERT(gettimeofday(&tv, NULL) == 0);
+   DEVSHELL_CMD_ASSERT(tv.tv_sec - ts.tv_sec <= 1);
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++)
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   duration = RDTSC() - start;
+   printf("clock_gettime(): %llu cycles\n", duration / iters);
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++)
+      gettimeofday(&tv, NULL);
+
+   duration = RDTSC() - start;
+   printf("gettimeofday(): %llu cycles\n", duration / iters);
+   return 0;
+}
+
+static ull_t get_monotonic_ms(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (ull_t)ts.tv_sec * 1000 + (ull_t)ts.tv_nsec / 1000000;
+}
+
+int cmd_sched_rt(int argc, char **argv)
+{
+   struct sched_param p = { .sched_priority = 10 };
+   int rc, wstatus, pipefd[2];
+   ull_t start;
+   pid_t child;
+   char c;
+
+   DEVSHELL_CMD_ASSERT(sched_get_priority_min(SCHED_FIFO) == 1);
+   DEVSHELL_CMD_ASSERT(sched_get_priority_max(SCHED_RR) == 99);
+   DEVSHELL_CMD_ASSERT(sched_get_priority_max(SCHED_OTHER) == 0);
+   DEVSHELL_CMD_ASSERT(sched_getscheduler(0) == SCHED_OTHER);
+
+   p.sched_priority = 100;
+   rc = sched_setscheduler(0, SCHED_FIFO, &p);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   p.sched_priority = 10;
+
+   if (sched_setscheduler(0, SCHED_FIFO, &p) < 0) {
+
+      if (!running_on_tilck() && errno == EPERM) {
+         printf("[SKIP]: not enough privileges\n");
+         return 0;
+      }
+
+      DEVSHELL_CMD_ASSERT(false);
+   }
+
+   DEVSHELL_CMD_ASSERT(sched_getscheduler(0) == SCHED_FIFO);
+   DEVSHELL_CMD_ASSERT(sched_getparam(0, &p) == 0);
+   DEVSHELL_CMD_ASSERT(p.sched_priority == 10);
+
+   rc = pipe(pipefd);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   child = fork();
+   DEVSHELL_CMD_ASSERT(child >= 0);
+
+   if (!child) {
+
+      /* The child inherits SCHED_FIFO with the same priority */
+      if (sched_getscheduler(0) != SCHED_FIFO)
+         exit(1);
+
+      write(pipefd[1], "x", 1);
+      exit(0);
+   }
+
+   /*
+    * We're a SCHED_FIFO task and we never block here: the child, having the
+    * same priority, must not run until we give up the CPU. That's true only
+    * on a single CPU, like on Tilck.
+    */
+   start = get_monotonic_ms();
+
+   while (get_monotonic_ms() - start < 200) { }
+
+   if (running_on_tilck()) {
+      rc = read(pipefd[0], &c, 1);
+      DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   }
+
+   p.sched_priority = 0;
+   rc = sched_setscheduler(0, SCHED_OTHER, &p);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = waitpid(child, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == child);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   rc = read(pipefd[0], &c, 1);
+   DEVSHELL_CMD_ASSERT(rc == 1 && c == 'x');
+
+   close(pipefd[0]);
+   close(pipefd[1]);
+   return 0;
+}
+
 int cmd_fpu(int argc, char **argv)
 {
    long double e = 1.0;
@@ -19,6 +19,14 @@
 #include "sysenter.h"
 #include "test_common.h"
 
+#ifndef MREMAP_MAYMOVE
+   #define MREMAP_MAYMOVE 1  /* defined by <sys/mman.h> only with _GNU_SOURCE */
+#endif
+
+#ifndef MADV_FREE
+   #define MADV_FREE      8
+#endif
+
 int cmd_brk(int argc, char **argv)
 {
    const size_t alloc_size = 1024 * 1024;
@@ -42,6 +50,33 @@ int cmd_brk(int argc, char **argv)
 
    //printf("tot allocated: %u KB\n", tot_allocated / 1024);
 
+   /*
+    * The pages are populated on the first write (or immediately, with
+    * BRK_NO_COW): in both cases, check that they read as zero and that each
+    * one gets its own page frame.
+    */
+   for (size_t off = 0; off < tot_allocated; off += 4096) {
+
+      char *p = (char *)orig_brk + off;
+
+      if (*p != 0) {
+         printf("brk() memory at offset %zu is not zeroed\n", off);
+         return 1;
+      }
+
+      *p = (char)(off / 4096) | 1;
+   }
+
+   for (size_t off = 0; off < tot_allocated; off += 4096) {
+
+      char *p = (char *)orig_brk + off;
+
+      if (*p != ((char)(off / 4096) | 1)) {
+         printf("brk() memory at offset %zu has been corrupted\n", off);
+         return 1;
+      }
+   }
+
    b = (void *)syscall(SYS_brk, orig_brk);
 
    if (b != orig_brk) {
@@ -49,6 +84,20 @@ int cmd_brk(int argc, char **argv)
       return 1;
    }
 
+   /* Re-grown memory must be zeroed again */
+   b = (void *)syscall(SYS_brk, orig_brk + 4096);
+
+   if (b != orig_brk + 4096) {
+      printf("Unable to re-grow the heap with brk()\n");
+      return 1;
+   }
+
+   if (*(char *)orig_brk != 0) {
+      printf("Re-grown brk() memory is not zeroed\n");
+      return 1;
+   }
+
+   syscall(SYS_brk, orig_brk);
    return 0;
 }
 
@@ -159,6 +208,93 @@ int cmd_mmap2(int argc, char **argv)
    return 0;
 }
 
+static NO_INLINE int stack_grow_rec(int depth)
+{
+   volatile char buf[4000];
+
+   buf[0] = (char)depth;
+   buf[sizeof(buf) - 1] = (char)depth;
+
+   if (depth > 0) {
+      if (stack_grow_rec(depth - 1))
+         return 1;
+   }
+
+   return buf[0] != (char)depth || buf[sizeof(buf) - 1] != (char)depth;
+}
+
+/*
+ * Make the kernel perform the first access to a stack page 2 MB below the
+ * stack pointer. User code never touches it (no call frame goes that deep
+ * before the read() below) and, if it did, that fault would be too far from
+ * `esp` to count as a stack access: therefore, read() succeeds only if the
+ * kernel-mode page fault grows the stack.
+ */
+static NO_INLINE int stack_grow_kernel_write(void)
+{
+   static const char msg[] = "stack";
+   volatile char here;
+   char *p = (char *)(((ulong)&here - 2 * MB) & ~4095ul);
+   int pfds[2], rc;
+
+   if (pipe(pfds))
+      return 1;
+
+   rc = write(pfds[1], msg, sizeof(msg));
+
+   if (rc == sizeof(msg))
+      rc = read(pfds[0], p, sizeof(msg));
+
+   close(pfds[0]);
+   close(pfds[1]);
+
+   if (rc != sizeof(msg))
+      return 1;
+
+   return memcmp(p, msg, sizeof(msg)) != 0;
+}
+
+static void stack_grow_child(void)
+{
+   if (stack_grow_kernel_write()) {
+      printf(STR_CHILD "read() on a not-yet-grown stack page failed\n");
+      exit(1);
+   }
+
+   /* Use ~1 MB of stack, much more than what's mapped by execve() */
+   if (stack_grow_rec(256)) {
+      printf(STR_CHILD "Stack memory corrupted\n");
+      exit(1);
+   }
+
+   exit(0);
+}
+
+int cmd_stack_grow(int argc, char **argv)
+{
+   int child;
+   int wstatus;
+
+   child = fork();
+
+   if (child < 0) {
+      printf("fork() failed\n");
+      return 1;
+   }
+
+   if (!child)
+      stack_grow_child();
+
+   waitpid(child, &wstatus, 0);
+
+   if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+      printf("The child failed with status: %d\n", wstatus);
+      return 1;
+   }
+
+   return 0;
+}
+
 static size_t fork_oom_alloc_size;
 
 static void fork_oom_child(void *buf)
@@ -391,3 +527,293 @@ int cmd_fork_oom(int argc, char **argv)
    free(buf);
    return rc;
 }
+
+static void *do_mremap(void *addr, size_t old_len, size_t new_len, int flags)
+{
+   return (void *)syscall(SYS_mremap, addr, old_len, new_len, flags, NULL);
+}
+
+static void fill_pages(char *buf, size_t len, char val)
+{
+   for (size_t off = 0; off < len; off += 4096)
+      buf[off] = (char)(val + off / 4096);
+}
+
+static bool check_pages(char *buf, size_t len, char val)
+{
+   for (size_t off = 0; off < len; off += 4096)
+      if (buf[off] != (char)(val + off / 4096))
+         return false;
+
+   return true;
+}
+
+static bool check_zero_pages(char *buf, size_t len)
+{
+   for (size_t off = 0; off < len; off += 4096)
+      if (buf[off] || buf[off + 4095])
+         return false;
+
+   return true;
+}
+
+int cmd_mremap(int argc, char **argv)
+{
+   const size_t sz = 1 * MB;
+   char *a, *b, *c, *res;
+   int pid, rc, wstatus;
+
+   a = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(a != (void *)-1);
+   fill_pages(a, sz, 'a');
+
+   /* Grow, moving if necessary: the data must be preserved */
+   res = do_mremap(a, sz, 3 * sz, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(res != (void *)-1);
+   DEVSHELL_CMD_ASSERT(check_pages(res, sz, 'a'));
+   DEVSHELL_CMD_ASSERT(check_zero_pages(res + sz, 2 * sz));
+   fill_pages(res + sz, 2 * sz, 'b');
+   a = res;
+
+   /* Shrink in-place */
+   res = do_mremap(a, 3 * sz, sz, 0);
+   DEVSHELL_CMD_ASSERT(res == a);
+   DEVSHELL_CMD_ASSERT(check_pages(a, sz, 'a'));
+
+   /* Grow without moving: either in-place or ENOMEM */
+   res = do_mremap(a, sz, 2 * sz, 0);
+
+   if (res != (void *)-1) {
+      DEVSHELL_CMD_ASSERT(res == a);
+      DEVSHELL_CMD_ASSERT(check_zero_pages(a + sz, sz));
+      res = do_mremap(a, 2 * sz, sz, 0);
+      DEVSHELL_CMD_ASSERT(res == a);
+   } else {
+      DEVSHELL_CMD_ASSERT(errno == ENOMEM);
+   }
+
+   /* Force a move, by putting another mapping right after `a` */
+   b = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(b != (void *)-1);
+   fill_pages(b, sz, 'c');
+
+   c = do_mremap(a, sz, 4 * sz, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(c != (void *)-1);
+   DEVSHELL_CMD_ASSERT(check_pages(c, sz, 'a'));
+   DEVSHELL_CMD_ASSERT(check_zero_pages(c + sz, 3 * sz));
+   DEVSHELL_CMD_ASSERT(check_pages(b, sz, 'c'));
+
+   /* The pages moved in a forked child must stay private to it */
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      res = do_mremap(c, 4 * sz, 8 * sz, MREMAP_MAYMOVE);
+
+      if (res == (void *)-1 || !check_pages(res, sz, 'a'))
+         exit(1);
+
+      fill_pages(res, 8 * sz, 'd');
+      exit(check_pages(res, 8 * sz, 'd') ? 0 : 1);
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   DEVSHELL_CMD_ASSERT(check_pages(c, sz, 'a'));
+   DEVSHELL_CMD_ASSERT(check_zero_pages(c + sz, 3 * sz));
+
+   /* Invalid parameters */
+   res = do_mremap(c + 1, sz, 2 * sz, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(res == (void *)-1 && errno == EINVAL);
+   res = do_mremap(c, sz, 0, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(res == (void *)-1 && errno == EINVAL);
+
+   rc = munmap(c, 4 * sz);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = munmap(b, sz);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+/*
+ * Exercise the 4-MB pages used for big anonymous mappings: COW after fork(),
+ * partial munmap(), madvise() and mremap() all require splitting them.
+ */
+int cmd_mmap_huge(int argc, char **argv)
+{
+   const size_t sz = 16 * MB;
+   int pid, rc, wstatus;
+   char *a, *res;
+
+   a = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(a != (void *)-1);
+   DEVSHELL_CMD_ASSERT(check_zero_pages(a, sz));
+
+   /* The first write in each 4-MB region should get a whole 4-MB page */
+   fill_pages(a, sz, 'a');
+   DEVSHELL_CMD_ASSERT(check_pages(a, sz, 'a'));
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      /* Write one page in each 4-MB region and then all of them */
+      for (size_t off = 0; off < sz; off += 4 * MB)
+         a[off + 4096 + 1] = 'x';
+
+      if (!check_pages(a, sz, 'a'))
+         exit(1);
+
+      fill_pages(a, sz, 'c');
+      exit(check_pages(a, sz, 'c') ? 0 : 1);
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   DEVSHELL_CMD_ASSERT(check_pages(a, sz, 'a'));
+
+   /* The parent's pages are not shared anymore: write them in-place */
+   fill_pages(a, sz, 'b');
+   DEVSHELL_CMD_ASSERT(check_pages(a, sz, 'b'));
+
+   /* Drop and un-map parts of the 4-MB pages */
+   rc = madvise(a + 4096, 4096, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(check_zero_pages(a + 4096, 4096));
+   DEVSHELL_CMD_ASSERT(check_pages(a + 2 * 4096, 4 * MB, 'b' + 2));
+
+   rc = munmap(a + 6 * MB, 4 * MB);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(check_pages(a + 2 * 4096, 6 * MB - 2 * 4096, 'b' + 2));
+   DEVSHELL_CMD_ASSERT(check_pages(a + 10 * MB, 6 * MB, 'b'));
+
+   /* Move the last part, which still has a whole 4-MB page */
+   res = do_mremap(a + 10 * MB, 6 * MB, 8 * MB, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(res != (void *)-1);
+   DEVSHELL_CMD_ASSERT(check_pages(res, 6 * MB, 'b'));
+   DEVSHELL_CMD_ASSERT(check_zero_pages(res + 6 * MB, 2 * MB));
+
+   rc = munmap(a, 6 * MB);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   rc = munmap(res, 8 * MB);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+static int madvise_anon(void)
+{
+   const size_t sz = 1 * MB;
+   int pid, rc, wstatus;
+   char *a;
+
+   a = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+   DEVSHELL_CMD_ASSERT(a != (void *)-1);
+   fill_pages(a, sz, 'a');
+
+   /* The dropped pages must read as zeros, the others must be preserved */
+   rc = madvise(a, sz / 2, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(check_zero_pages(a, sz / 2));
+   DEVSHELL_CMD_ASSERT(check_pages(a + sz / 2, sz / 2, 'a' + 128));
+
+   /* The dropped pages must be writable again, like fresh anonymous memory */
+   fill_pages(a, sz / 2, 'b');
+   DEVSHELL_CMD_ASSERT(check_pages(a, sz / 2, 'b'));
+
+   rc = madvise(a + sz / 2, sz / 2, MADV_FREE);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(check_zero_pages(a + sz / 2, sz / 2));
+
+   /* Dropping pages in a forked child must not affect the parent */
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      if (madvise(a, sz, MADV_DONTNEED) || !check_zero_pages(a, sz))
+         exit(1);
+
+      exit(0);
+   }
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   DEVSHELL_CMD_ASSERT(check_pages(a, sz / 2, 'b'));
+
+   /* Invalid parameters */
+   rc = madvise(a + 1, sz, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   rc = munmap(a, sz);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = madvise(a, sz, MADV_DONTNEED);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOMEM);
+   return 0;
+}
+
+static int madvise_ramfs_willneed(void)
+{
+   static const char test_file[] = "/tmp/madvise_test";
+   const size_t page_size = getpagesize();
+   char *vaddr;
+   int fd, rc;
+
+   /* A sparse file: only its 4th page is backed by a block */
+   fd = open(test_file, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+   rc = lseek(fd, 3 * page_size, SEEK_SET);
+   DEVSHELL_CMD_ASSERT(rc == 3 * page_size);
+   rc = write(fd, "x", 1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+
+   vaddr = mmap(NULL, 4 * page_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+   DEVSHELL_CMD_ASSERT(vaddr != (void *)-1);
+
+   /* Read a hole: it gets mapped to the zero page */
+   DEVSHELL_CMD_ASSERT(vaddr[page_size] == 0);
+
+   /* Fill the hole with write(), then make the mapping pick its block */
+   rc = lseek(fd, page_size, SEEK_SET);
+   DEVSHELL_CMD_ASSERT(rc == page_size);
+   rc = write(fd, "hello", 5);
+   DEVSHELL_CMD_ASSERT(rc == 5);
+
+   rc = madvise(vaddr, 4 * page_size, MADV_WILLNEED);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(!memcmp(vaddr + page_size, "hello", 5));
+   DEVSHELL_CMD_ASSERT(vaddr[3 * page_size] == 'x');
+   DEVSHELL_CMD_ASSERT(vaddr[0] == 0 && vaddr[2 * page_size] == 0);
+
+   /* MADV_FREE is allowed only on anonymous memory */
+   rc = madvise(vaddr, page_size, MADV_FREE);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   rc = munmap(vaddr, 4 * page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   close(fd);
+
+   rc = unlink(test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+int cmd_madvise(int argc, char **argv)
+{
+   int rc;
+
+   if ((rc = madvise_anon()))
+      return rc;
+
+   return madvise_ramfs_willneed();
+}
@@ -32,6 +32,13 @@ void gdt_install() { }
 void idt_install() { }
 void irq_install() { }
 void hw_timer_setup() { }
+u32 hw_timer_oneshot() { return 0; }
+u32 hw_timer_oneshot_stop() { NOT_REACHED(); return 0; }
+u32 hw_timer_tick_elapsed_ns() { return 0; }
+bool hw_timer_hr_irq() { return false; }
+bool hw_hrtimer_setup() { return false; }
+void hw_hrtimer_arm() { }
+void hw_tsc_clocksource_init() { }
 void irq_install_handler() { }
 void irq_uninstall_handler() { }
 void setup_sysenter_interface() { }
@@ -40,6 +47,9 @@ void switch_to_task() { }
 void pdir_clone() { }
 void pdir_deep_clone() { }
 void pdir_destroy() { }
+void pdir_get_owned_pt_count() { NOT_REACHED(); }
+void pdir_get_owned_frame_count() { NOT_REACHED(); }
+void pdir_release_user_pts() { NOT_REACHED(); }
 void set_curr_pdir() { }
 void set_current_task_in_user_mode() { }
 void arch_specific_new_task_setup() { NOT_REACHED(); }
@@ -48,7 +58,10 @@ void arch_specific_new_proc_setup() { NOT_REACHED(); }
 void arch_specific_free_proc() { NOT_REACHED(); }
 void fpu_context_begin() { }
 void fpu_context_end() { }
+void map_zero_page() { NOT_REACHED(); }
 void map_zero_pages() { NOT_REACHED(); }
+void swap_pages() { NOT_REACHED(); }
+size_t collapse_to_big_pages() { return 0; }
 void dump_var_mtrrs() { }
 void set_page_rw() { }
 void poweroff() { NOT_REACHED(); }
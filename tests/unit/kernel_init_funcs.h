@@ -6,7 +6,7 @@ extern "C" {
 
    #include <tilck/common/basic_defs.h>
 
-   void init_pageframe_allocator();
+   void init_page_alloc();
    void init_kmalloc();
    void init_worker_threads();
    void init_kmalloc_for_tests();
@@ -22,6 +22,7 @@ extern "C" {
 
    #include <tilck/kernel/kmalloc.h>
    #include <tilck/kernel/paging.h>
+   #include <tilck/kernel/page_alloc.h>
    #include <tilck/kernel/self_tests.h>
 
    #include <kernel/kmalloc/kmalloc_heap_struct.h> // kmalloc private header
@@ -33,6 +34,7 @@ extern "C" {
    void selftest_kmalloc_perf_per_size(int size);
    void kmalloc_dump_heap_stats(void);
    void *node_to_ptr(struct kmalloc_heap *h, int node, size_t size);
+   void debug_kmalloc_drain_magazines(void);
 }
 
 using namespace std;
@@ -64,6 +66,10 @@ void save_heaps_metadata(unique_ptr<u8[]> *meta_before)
 {
    for (int h = 0; h < KMALLOC_HEAPS_COUNT && heaps[h]; h++) {
 
+      /* New heaps are added on demand, taken from the page allocator */
+      if (!meta_before[h])
+         meta_before[h].reset(new u8[heaps[h]->metadata_size]);
+
       memcpy(meta_before[h].get(),
              heaps[h]->metadata_nodes,
              heaps[h]->metadata_size);
@@ -88,6 +94,9 @@ void check_heaps_metadata(unique_ptr<u8[]> *meta_before)
       u8 *meta_ptr = meta_before[h].get();
       struct kmalloc_heap *heap = heaps[h];
 
+      if (!meta_ptr)
+         FAIL() << "Heap " << h << " added after save_heaps_metadata()";
+
       for (u32 i = 0; i < heap->metadata_size; i++) {
 
          if (meta_ptr[i] == ((u8*)heap->metadata_nodes)[i])
@@ -124,6 +133,25 @@ void kmalloc_chaos_test_sub(default_random_engine &eng,
    }
 }
 
+/*
+ * Grow the heaps as much as possible, taking all the memory from the page
+ * allocator, so that no heap can be added after save_heaps_metadata().
+ */
+void kmalloc_grow_heaps_to_max()
+{
+   vector<pair<void *, size_t>> allocations;
+   void *r;
+
+   for (size_t s = 16 * MB; s >= 8 * KB; s /= 2) {
+      while ((r = kmalloc(s)))
+         allocations.push_back(make_pair(r, s));
+   }
+
+   for (const auto& e : allocations) {
+      kfree2(e.first, e.second);
+   }
+}
+
 class kmalloc_test : public Test {
 public:
 
@@ -163,11 +191,11 @@ TEST_F(kmalloc_test, chaos_test)
 
    unique_ptr<u8[]> meta_before[KMALLOC_HEAPS_COUNT];
 
-   for (int h = 0; h < KMALLOC_HEAPS_COUNT && heaps[h]; h++) {
-      u8 *buf = new u8[heaps[h]->metadata_size];
-      memset(buf, 0, heaps[h]->metadata_size);
-      meta_before[h].reset(buf);
-   }
+   /* The chunks in the magazines are allocated for the heaps */
+   debug_kmalloc_drain_magazines();
+
+   /* The heaps are added on demand: add all of them before the test */
+   kmalloc_grow_heaps_to_max();
 
    for (int i = 0; i < 150; i++) {
 
@@ -177,6 +205,8 @@ TEST_F(kmalloc_test, chaos_test)
          kmalloc_chaos_test_sub(e, dist);
       }) << "i: " << i;
 
+      debug_kmalloc_drain_magazines();
+
       ASSERT_NO_FATAL_FAILURE({
          check_heaps_metadata(meta_before);
       }) << "i: " << i;
@@ -336,6 +366,39 @@ check_metadata(struct block_node *nodes, vector<const char *> expected_vec)
    }
 }
 
+TEST_F(kmalloc_test, page_alloc_split_and_coalesce)
+{
+   struct page_zone_info before, mid, after;
+   void *p0, *p1;
+
+   ASSERT_TRUE(debug_page_alloc_get_zone_info(PAGE_ZONE_NORMAL, &before));
+   ASSERT_GT(before.free_pages, 0u);
+
+   p0 = alloc_page();
+   p1 = alloc_pages(3, 0);
+
+   ASSERT_TRUE(p0 != nullptr);
+   ASSERT_TRUE(p1 != nullptr);
+
+   EXPECT_EQ(LIN_VA_TO_PA(p0) & (PAGE_SIZE - 1), 0u);
+   EXPECT_EQ(LIN_VA_TO_PA(p1) & ((8 * PAGE_SIZE) - 1), 0u);
+   EXPECT_TRUE((char *)p0 + PAGE_SIZE <= (char *)p1 ||
+               (char *)p1 + 8 * PAGE_SIZE <= (char *)p0);
+
+   debug_page_alloc_get_zone_info(PAGE_ZONE_NORMAL, &mid);
+   EXPECT_EQ(mid.free_pages, before.free_pages - 9);
+
+   free_page(p0);
+   free_pages(p1, 3);
+
+   /* All the split blocks must have been coalesced back */
+   debug_page_alloc_get_zone_info(PAGE_ZONE_NORMAL, &after);
+   EXPECT_EQ(after.free_pages, before.free_pages);
+
+   for (int o = 0; o <= PAGE_ALLOC_MAX_ORDER; o++)
+      EXPECT_EQ(after.free_blocks[o], before.free_blocks[o]) << "order " << o;
+}
+
 TEST_F(kmalloc_test, split_block)
 {
    void *ptr;
@@ -700,6 +763,55 @@ TEST_F(kmalloc_test, multi_step_free)
 }
 
 
+TEST_F(kmalloc_test, kmalloc_at_grow_and_free)
+{
+   void *ptr, *res;
+   size_t s;
+
+   struct kmalloc_heap h;
+   kmalloc_create_heap(&h,
+                       MB,                           /* vaddr */
+                       KMALLOC_MIN_HEAP_SIZE,        /* heap size */
+                       KMALLOC_MIN_HEAP_SIZE / 16,   /* min block size */
+                       KMALLOC_MIN_HEAP_SIZE / 8,    /* alloc block size */
+                       false,                        /* linear mapping */
+                       NULL,                         /* metadata_nodes */
+                       fake_alloc_and_map_func,
+                       fake_free_and_map_func);
+
+   const size_t mbs = h.min_block_size;
+
+   s = 3 * mbs;
+   ptr = per_heap_kmalloc(&h, &s, KMALLOC_FL_MULTI_STEP | (u32)mbs);
+
+   EXPECT_EQ(s, 3 * mbs);
+   EXPECT_EQ(ptr, (void *)h.vaddr);
+
+   /* A range overlapping an allocated chunk cannot be allocated */
+   res = per_heap_kmalloc_at(&h, (char *)ptr + 2 * mbs, 2 * mbs, (u32)mbs);
+   EXPECT_EQ(res, nullptr);
+
+   /* Grow the chunk in-place, from 3 to 9 blocks */
+   res = per_heap_kmalloc_at(&h, (char *)ptr + 3 * mbs, 6 * mbs, (u32)mbs);
+   EXPECT_EQ(res, (char *)ptr + 3 * mbs);
+   EXPECT_EQ(h.mem_allocated, 9 * mbs);
+
+   dump_heap_subtree(&h, 0, 5);
+
+   /* Free the grown chunk at once, as a single multi-step chunk */
+   s = 9 * mbs;
+   per_heap_kfree(&h, ptr, &s, KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
+
+   EXPECT_EQ(s, 9 * mbs);
+   EXPECT_EQ(h.mem_allocated, 0u);
+
+   /* The whole heap must be free again */
+   s = h.size;
+   EXPECT_EQ(per_heap_kmalloc(&h, &s, 0), (void *)h.vaddr);
+
+   kmalloc_destroy_heap(&h);
+}
+
 TEST_F(kmalloc_test, partial_free)
 {
    void *ptr;
@@ -100,15 +100,24 @@ void *__wrap_general_kmalloc(size_t *size, u32 flags)
    if (mock_kmalloc)
       return malloc(*size);
 
-   return __real_general_kmalloc(size, 0);
+   return __real_general_kmalloc(size, flags);
 }
 
 void __wrap_general_kfree(void *ptr, size_t *size, u32 flags)
 {
-   if (mock_kmalloc)
+   if (mock_kmalloc) {
+
+      /*
+       * Sub-blocks of a bigger chunk (e.g. allocated by a kmalloc accelerator)
+       * cannot be returned to glibc: just leak them.
+       */
+      if (flags & KFREE_FL_ALLOW_SPLIT)
+         return;
+
       return free(ptr);
+   }
 
-   return __real_general_kfree(ptr, size, 0);
+   return __real_general_kfree(ptr, size, flags);
 }
 
 void *__wrap_kmalloc_get_first_heap(size_t *size)
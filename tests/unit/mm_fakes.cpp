@@ -19,7 +19,7 @@ extern "C" {
 #include <tilck/kernel/system_mmap.h>
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/paging.h>
-#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <kernel/kmalloc/kmalloc_heap_struct.h> // kmalloc private header
 #include <kernel/kmalloc/kmalloc_block_node.h>  // kmalloc private header
 #include <tilck/kernel/test/mem_regions.h>
@@ -63,6 +63,7 @@ void init_kmalloc_for_tests()
    initialize_test_kernel_heap();
    suppress_printk = true;
    early_init_kmalloc();
+   init_page_alloc();
    init_kmalloc();
    suppress_printk = false;
 }
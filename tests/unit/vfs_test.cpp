@@ -166,24 +166,58 @@ TEST_F(vfs_fat32, fseek)
    close(fd);
 }
 
-TEST_F(vfs_fat32, pread_not_supported)
+TEST_F(vfs_fat32, pread)
 {
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine engine(seed);
    const char *fatpart_file_path = "/bigfile";
+   const char *real_file_path = PROJ_BUILD_DIR "/test_sysroot/bigfile";
+   char buf_tilck[64];
+   char buf_linux[64];
    fs_handle h = NULL;
-   char buf[32];
-   int rc;
+   int rc, fd;
+
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   fd = open(real_file_path, O_RDONLY);
+   ASSERT_TRUE(fd >= 0);
+
+   const off_t file_size = lseek(fd, 0, SEEK_END);
+   uniform_int_distribution<off_t> dist(0, file_size + 64);
 
    rc = vfs_open(fatpart_file_path, &h, 0, O_RDONLY);
    ASSERT_TRUE(rc == 0);
    ASSERT_TRUE(h != NULL);
 
-   rc = vfs_pread(h, buf, sizeof(buf), 0 /* offset */);
-   EXPECT_EQ(rc, -EPERM);
+   /* Move the file position somewhere: pread() must not change it */
+   ASSERT_EQ(vfs_seek(h, 1000, SEEK_SET), 1000);
+
+   for (int i = 0; i < 10000; i++) {
+
+      const off_t off = dist(engine);
+
+      memset(buf_linux, 0, sizeof(buf_linux));
+      memset(buf_tilck, 0, sizeof(buf_tilck));
+
+      ssize_t linux_read = pread(fd, buf_linux, sizeof(buf_linux), off);
+      ssize_t tilck_read = vfs_pread(h, buf_tilck, sizeof(buf_tilck), off);
+
+      ASSERT_EQ(tilck_read, linux_read) << "Offset: " << off << endl;
+      ASSERT_EQ(memcmp(buf_tilck, buf_linux, sizeof(buf_linux)), 0)
+         << "Offset: " << off << endl;
+   }
 
-   rc = vfs_pread(h, buf, sizeof(buf), 10 /* offset */);
-   EXPECT_EQ(rc, -EPERM);
+   ASSERT_EQ(vfs_seek(h, 0, SEEK_CUR), 1000);
+
+   /* The file position and the current cluster are still consistent */
+   lseek(fd, 1000, SEEK_SET);
+   ASSERT_EQ(read(fd, buf_linux, sizeof(buf_linux)),
+             vfs_read(h, buf_tilck, sizeof(buf_tilck)));
+   ASSERT_EQ(memcmp(buf_tilck, buf_linux, sizeof(buf_linux)), 0);
 
    vfs_close(h);
+   close(fd);
 }
 
 class vfs_ramfs : public vfs_test_base {
@@ -242,6 +276,50 @@ TEST_F(vfs_ramfs, create_and_unlink_file)
    ASSERT_EQ(rc, -ENOENT);
 }
 
+TEST_F(vfs_ramfs, dcache_invalidation)
+{
+   struct k_stat64 st;
+   fs_handle h;
+
+   /* Populate the cache with negative entries, twice */
+   for (int i = 0; i < 2; i++) {
+      ASSERT_EQ(vfs_stat64("/d1", &st, true), -ENOENT);
+      ASSERT_EQ(vfs_stat64("/d1/f1", &st, true), -ENOENT);
+   }
+
+   ASSERT_EQ(vfs_mkdir("/d1", 0755), 0);
+   ASSERT_EQ(vfs_stat64("/d1", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/d1/f1", &st, true), -ENOENT);
+
+   ASSERT_EQ(vfs_open("/d1/f1", &h, O_CREAT | O_RDWR, 0644), 0);
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_stat64("/d1/f1", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/d1/f1", &st, true), 0);
+
+   ASSERT_EQ(vfs_rename("/d1/f1", "/d1/f2"), 0);
+   ASSERT_EQ(vfs_stat64("/d1/f1", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/d1/f2", &st, true), 0);
+
+   ASSERT_EQ(vfs_unlink("/d1/f2"), 0);
+   ASSERT_EQ(vfs_stat64("/d1/f2", &st, true), -ENOENT);
+
+   ASSERT_EQ(vfs_rmdir("/d1"), 0);
+   ASSERT_EQ(vfs_stat64("/d1", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/d1/f2", &st, true), -ENOENT);
+
+   /* A new dir must not inherit anything from the old one */
+   ASSERT_EQ(vfs_mkdir("/d1", 0755), 0);
+   ASSERT_EQ(vfs_symlink("/d1", "/l1"), 0);
+   ASSERT_EQ(vfs_stat64("/l1/f1", &st, true), -ENOENT);
+
+   ASSERT_EQ(vfs_open("/l1/f1", &h, O_CREAT | O_RDWR, 0644), 0);
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_stat64("/d1/f1", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/l1/f1", &st, true), 0);
+}
+
 void vfs_ramfs::test_pread_pwrite_seek(bool fseek)
 {
    const off_t data_size = 2 * MB;